@@ -11,15 +11,24 @@
 
 #include "btree.h"
 #include "filescan.h"
+#include "file_iterator.h"
+#include "page_iterator.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
 
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <queue>
+#include <thread>
+
 using namespace std;
 //#define DEBUG
 
@@ -34,21 +43,94 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const int buildThreads,
+		const int pageSize,
+		const LeafFormat leafFormat,
+		const NonLeafFormat nonLeafFormat)
+{
+	bufMgr = bufMgrIn; 
+
+	// Packed columns hold integer differences
+	if(leafFormat == LEAF_PACKED && attrType != INTEGER){
+		throw BadIndexInfoException("Packed leaves need an INTEGER key"); 
+	}
+
+	// Buffered messages are merged into scans as integer keys
+	if(nonLeafFormat == NONLEAF_BUFFERED && attrType != INTEGER){
+		throw BadIndexInfoException("Buffered non-leaf nodes need an INTEGER key"); 
+	}
+
+	std::vector<KeyAttr> attrs(1);
+	attrs[0].attrByteOffset = attrByteOffset;
+	attrs[0].attrType = attrType;
+	openIndex(relationName, outIndexName, attrs, buildThreads, pageSize, leafFormat, nonLeafFormat);
+}
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const std::vector<KeyAttr> &keyAttrs,
+		const int buildThreads,
+		const int pageSize)
+{
+	bufMgr = bufMgrIn; 
+
+	checkKeyAttrs(keyAttrs);
+	openIndex(relationName, outIndexName, keyAttrs, buildThreads, pageSize, LEAF_PLAIN, NONLEAF_PLAIN);
+}
+
+BTreeIndex::BTreeIndex(BufMgr *bufMgrIn)
+{
+	bufMgr = bufMgrIn; 
+}
+
+void BTreeIndex::checkKeyAttrs(const std::vector<KeyAttr> &keyAttrs)
+{
+	// Composite keys are normalized into a CompositeKey, which only has room for INTEGER attributes
+	if(keyAttrs.empty() || (int)keyAttrs.size() > MAXKEYATTRS){
+		throw BadIndexInfoException("Composite key must have between 1 and MAXKEYATTRS attributes"); 
+	}
+	for(size_t i = 0; i < keyAttrs.size(); i++){
+		if(keyAttrs[i].attrType != INTEGER){
+			throw BadIndexInfoException("Composite key attributes must be INTEGER"); 
+		}
+	}
+}
+
+void BTreeIndex::openIndex(const std::string & relationName,
+		std::string & outIndexName,
+		const std::vector<KeyAttr> &attrs,
+		const int buildThreads,
+		const int pageSize,
+		const LeafFormat newLeafFormat,
+		const NonLeafFormat newNonLeafFormat)
 {
 	// Initialize variables
 	// Assuming all inputs are integers (as specified in assignment document)
-	bufMgr = bufMgrIn; 
-	leafOccupancy = INTARRAYLEAFSIZE; 
-	nodeOccupancy = INTARRAYNONLEAFSIZE;
+	this->keyAttrs = attrs;
+	this->attrByteOffset = attrs[0].attrByteOffset;
+	attributeType = attrs[0].attrType;
 	this->scanExecuting = false; 
-
-	this->attrByteOffset = attrByteOffset;
-	attributeType = attrType;
+	this->currentPageData = NULL;
+	this->scanLimit = -1;
+	this->scanCount = 0;
+	this->nextRange = 0;
+	this->skipScan = false;
+	this->newIndex = false;
+	this->leafFormat = LEAF_PLAIN;
+	this->nonLeafFormat = NONLEAF_PLAIN;
+	this->mergePending = false;
+	this->leafBytesMoved = 0;
+	this->leafJumps = 0;
 
 	// Construct indexName and return via outIndexName (code from assignment doc)
+	// Composite indexes append the offsets of the other attributes
 	std::ostringstream idxStr;
 	idxStr << relationName << '.' << attrByteOffset;
+	for(size_t i = 1; i < attrs.size(); i++){
+		idxStr << '_' << attrs[i].attrByteOffset;
+	}
 	std::string indexName = idxStr.str(); 
 	outIndexName = indexName;
 	
@@ -66,6 +148,11 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
 
 		rootPageNum = metaInfo->rootPageNo;
+		nodeLayout = metaInfo->nodeLayout;
+		leafFormat = metaInfo->leafFormat;
+		nonLeafFormat = metaInfo->nonLeafFormat;
+		extentPages = metaInfo->extentPages;
+		setOccupancy();
 
 		// Check meta info for accurate information 
 		std::cout << "metaInfo->relationName: " << metaInfo->relationName << " RelationName: " << relationName.c_str() << std::endl; 
@@ -75,6 +162,13 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 			throw BadIndexInfoException("Attribute Byte Offsets do not match"); 
 		}else if(metaInfo->attrType != attributeType){
 			throw BadIndexInfoException("Attribute Types do not match"); 
+		}else if(metaInfo->numKeyAttrs != (int)attrs.size()){
+			throw BadIndexInfoException("Number of key attributes do not match"); 
+		}
+		for(size_t i = 0; i < attrs.size(); i++){
+			if(metaInfo->keyAttrOffsets[i] != attrs[i].attrByteOffset || metaInfo->keyAttrTypes[i] != attrs[i].attrType){
+				throw BadIndexInfoException("Key attributes do not match"); 
+			}
 		}
 
 		// UnPinPage once done 
@@ -84,7 +178,11 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		// File Does Not Exist: 
 
 		// Create a disk image of the index file 
-		file = new BlobFile(indexName, true);
+		file = new BlobFile(indexName, true, pageSize);
+		newIndex = true;
+		leafFormat = newLeafFormat;
+		nonLeafFormat = newNonLeafFormat;
+		setOccupancy();
 
 		// Create root & header pages
 		headerPageNum = 0;
@@ -96,526 +194,2234 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		bufMgr->allocPage(file, rootPageNum, rootPage);
 
 		// Create root node and add right sibling 
-		LeafNodeInt *rootNode = (LeafNodeInt *) rootPage;
-		rootNode->rightSibPageNo = 0;
+		std::vector<char> rootBuffer;
+		if(isComposite()){
+			LeafNodeComposite root = leafView<CompositeKey>(rootPage, rootBuffer, false);
+			root.rightSibPageNo = 0;
+			storeLeaf(root, rootPage);
+		}else{
+			LeafNodeInt root = leafView<int>(rootPage, rootBuffer, false);
+			root.rightSibPageNo = 0;
+			storeLeaf(root, rootPage);
+		}
 
 		// Adding Meta Information to headerPage
 		IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
 		strcpy(metaInfo->relationName, relationName.c_str());
 		metaInfo->attrByteOffset = attrByteOffset;
-		metaInfo->attrType = attrType;
+		metaInfo->attrType = attributeType;
 		metaInfo->rootPageNo = rootPageNum;
 		metaInfo->rootIsLeaf = true;
+		metaInfo->nodeLayout = LAYOUT_SORTED;
+		nodeLayout = LAYOUT_SORTED;
+		metaInfo->leafFormat = leafFormat;
+		metaInfo->nonLeafFormat = nonLeafFormat;
+		metaInfo->extentPages = EXTENTPAGES;
+		metaInfo->leafExtentNext = metaInfo->leafExtentEnd = 0;
+		metaInfo->nodeExtentNext = metaInfo->nodeExtentEnd = 0;
+		extentPages = EXTENTPAGES;
+		metaInfo->numKeyAttrs = attrs.size();
+		for(size_t i = 0; i < attrs.size(); i++){
+			metaInfo->keyAttrOffsets[i] = attrs[i].attrByteOffset;
+			metaInfo->keyAttrTypes[i] = attrs[i].attrType;
+		}
 
 		// UnPinPage once done 
 		bufMgr->unPinPage(file, headerPageNum, true);
 		bufMgr->unPinPage(file, rootPageNum, true);
 
-		// Create new FileScan object
-		FileScan fscan(relationName, bufMgr);
-		try
-		{
-			// Get all tuples in relation. 
-			RecordId scanRid;
-			while(1)
+		if(buildThreads == DEFERREDBUILD){
+			// buildIndexes fills it
+			return;
+		}else if(buildThreads > 0){
+			// Sort the whole relation and load it bottom up
+			readBuildBatches(relationName, bufMgr, std::vector<BTreeIndex*>(1, this), buildThreads);
+			finishBuild();
+		}else{
+			// Create new FileScan object
+			FileScan fscan(relationName, bufMgr);
+			try
+			{
+				// Get all tuples in relation. 
+				RecordId scanRid;
+				while(1)
+				{
+					// Find key
+					fscan.scanNext(scanRid);
+					std::string recordStr = fscan.getRecord();
+					const char *record = recordStr.c_str();
+
+					// Insert into BTree
+					if(isComposite()){
+						CompositeKey key = getCompositeKey(record);
+						insertEntry(&key, scanRid);
+					}else{
+						insertEntry(record+attrByteOffset, scanRid); 
+					}
+				}
+			}
+			catch(const EndOfFileException &e)
 			{
-				// Find key
-				fscan.scanNext(scanRid);
-				std::string recordStr = fscan.getRecord();
-				const char *record = recordStr.c_str();
-
-				// Insert into BTree
-				insertEntry(record+attrByteOffset, scanRid); 
 			}
 		}
-		catch(const EndOfFileException &e)
-		{
-			std::cout << "Print Tree: " << std::endl;
-			printTree(rootPageNum, true); 
-			bufMgr->flushFile(file);
+
+		std::cout << "Print Tree: " << std::endl;
+		if(isComposite()){
+			printTree<CompositeKey>(rootPageNum, true); 
+		}else{
+			printTree<int>(rootPageNum, true); 
 		}
+		bufMgr->flushFile(file);
 	}
 }
 
+void BTreeIndex::setOccupancy()
+{
+	// Node layouts only use the part of a frame that is stored in the index file
+	if(isComposite()){
+		leafOccupancy = NodeCapacity<CompositeKey>::leaf(file->pageSize()); 
+		nodeOccupancy = NodeCapacity<CompositeKey>::nonLeaf(file->pageSize());
+	}else{
+		leafOccupancy = NodeCapacity<int>::leaf(file->pageSize()); 
+		nodeOccupancy = NodeCapacity<int>::nonLeaf(file->pageSize());
+	}
+	if(leafFormat == LEAF_PACKED){
+		leafOccupancy = NodeCapacity<int>::packedLeaf(file->pageSize()); 
+	}else if(leafFormat == LEAF_APPEND){
+		leafOccupancy = NodeCapacity<int>::appendLeaf(file->pageSize()); 
+	}
+
+	// Buffered nodes give up key slots for the message buffer
+	bufferOccupancy = 0;
+	if(nonLeafFormat == NONLEAF_BUFFERED){
+		nodeOccupancy = NodeCapacity<int>::bufferedNonLeaf(file->pageSize());
+		bufferOccupancy = NodeCapacity<int>::nodeBuffer(file->pageSize());
+	}
+}
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
+// BTreeIndex::makeCompositeKey
 // -----------------------------------------------------------------------------
 
-BTreeIndex::~BTreeIndex()
+CompositeKey BTreeIndex::makeCompositeKey(const int *attrVals, const int numAttrs)
 {
-	// Stop scanning 
-	try{
-		endScan();
-	}catch(const ScanNotInitializedException &e){
-		// No Scan has been initialized. Catching Error and closing BTreeIndex
+	// Leading attribute keeps its sign in the high word, the second one is
+	// biased so that its unsigned value orders the same way as its signed value
+	CompositeKey key = (CompositeKey)attrVals[0] * 0x100000000LL;
+	if(numAttrs > 1){
+		key += (std::uint32_t)attrVals[1] ^ 0x80000000u;
 	}
+	return key;
+}
 
-	// Remove file 
-	bufMgr->flushFile(file);
-	delete file;
+void BTreeIndex::splitCompositeKey(const CompositeKey key, int *attrVals)
+{
+	// Subtracting the low word first makes the division exact, so negative
+	// leading values come back unchanged
+	std::uint32_t lowWord = (std::uint32_t)(key & 0xFFFFFFFFLL);
+	attrVals[0] = (int)((key - lowWord) / 0x100000000LL);
+	attrVals[1] = (int)(lowWord ^ 0x80000000u);
+}
+
+CompositeKey BTreeIndex::getCompositeKey(const char *record) const
+{
+	int attrVals[MAXKEYATTRS];
+	for(size_t i = 0; i < keyAttrs.size(); i++){
+		attrVals[i] = *(int *)(record + keyAttrs[i].attrByteOffset);
+	}
+	return makeCompositeKey(attrVals, keyAttrs.size());
 }
 
+
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
+// BTreeIndex::buildIndexes
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+void BTreeIndex::buildIndexes(const std::string & relationName, BufMgr *bufMgrIn,
+		const std::vector<std::vector<KeyAttr> > &indexKeys, std::vector<std::string> &outIndexNames,
+		const int buildThreads, const int pageSize)
 {
-	// Get headerPage 
-	Page *headerPage; 
-	headerPageNum = file->getFirstPageNo();
-	bufMgr->readPage(file, headerPageNum, headerPage);
-	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
+	for(size_t i = 0; i < indexKeys.size(); i++){
+		checkKeyAttrs(indexKeys[i]);
+	}
 
-	// Check if root is a leaf or internal node 
-	PageKeyPair<int> pageKey; 
-	if(metaInfo->rootIsLeaf){
-		
-		// Root is a leaf node 
-		pageKey = insertToLeaf(key, rid, rootPageNum); 
+	// Create the index files, leaving out the ones that exist already
+	std::vector<BTreeIndex*> indexes;
+	std::vector<BTreeIndex*> newIndexes;
+	outIndexNames.resize(indexKeys.size());
+	for(size_t i = 0; i < indexKeys.size(); i++){
+		BTreeIndex *index = new BTreeIndex(bufMgrIn);
+		index->openIndex(relationName, outIndexNames[i], indexKeys[i], DEFERREDBUILD, pageSize, LEAF_PLAIN, NONLEAF_PLAIN);
+		indexes.push_back(index);
+		if(index->newIndex){
+			newIndexes.push_back(index);
+		}
+	}
 
-		// Check if root was split and needs to change into an internal node 
-		if(pageKey.pageNo != 0){
-			
-			// Create a new internal node for the new root 
-			Page* newRootPage; 
-			PageId newRootNo; 
-			bufMgr->allocPage(file, newRootNo, newRootPage);
-			NonLeafNodeInt *newRootNode = (NonLeafNodeInt *)newRootPage;
-			
-			// Initiialize new Root 
-			newRootNode->keyArray[0] = pageKey.key;
-			newRootNode->pageNoArray[0] = rootPageNum;
-			newRootNode->pageNoArray[1] = pageKey.pageNo;
-			newRootNode->level = 1; 
+	if(!newIndexes.empty()){
+		readBuildBatches(relationName, bufMgrIn, newIndexes, buildThreads < 1 ? 1 : buildThreads);
+		for(size_t i = 0; i < newIndexes.size(); i++){
+			newIndexes[i]->finishBuild();
+		}
+	}
 
-			// Update header page 
-			metaInfo->rootPageNo = newRootNo; 
-			metaInfo->rootIsLeaf = false;
-			rootPageNum = newRootNo;
+	for(size_t i = 0; i < indexes.size(); i++){
+		delete indexes[i];
+	}
+}
 
-			bufMgr->unPinPage(file, newRootNo, true);
+void BTreeIndex::readBuildBatches(const std::string & relationName, BufMgr *bufMgrIn,
+		const std::vector<BTreeIndex*> &indexes, const int numThreads)
+{
+	// Pages are copied out of the buffer pool a batch at a time, then sorted while
+	// nothing else touches the buffer manager
+	PageFile relFile(relationName, false);
+	const size_t pageSize = relFile.pageSize();
+	std::vector<char> batch;
+	batch.reserve(BUILDBATCHBYTES / pageSize * pageSize);
+	PageId pageNo = relFile.getFirstPageNo();
+	while(pageNo != Page::INVALID_NUMBER){
+		Page *page;
+		bufMgrIn->readPage(&relFile, pageNo, page);
+		batch.insert(batch.end(), (char *)page, (char *)page + pageSize);
+		PageId nextPageNo = page->next_page_number();
+		bufMgrIn->unPinPage(&relFile, pageNo, false);
+		pageNo = nextPageNo;
+
+		if(batch.size() + pageSize > (size_t)BUILDBATCHBYTES || pageNo == Page::INVALID_NUMBER){
+			if(indexes.size() == 1){
+				indexes[0]->addBuildBatch(batch, pageSize, numThreads);
+			}else{
+				// Each index owns its runs, so the indexes can sort the same batch at once
+				std::vector<std::thread> workers;
+				for(size_t i = 0; i < indexes.size(); i++){
+					workers.push_back(std::thread(&BTreeIndex::addBuildBatch, indexes[i], std::ref(batch), pageSize, numThreads));
+				}
+				for(size_t i = 0; i < workers.size(); i++){
+					workers[i].join();
+				}
+			}
+			batch.clear();
 		}
+	}
+	bufMgrIn->flushFile(&relFile);
+}
+
+void BTreeIndex::addBuildBatch(std::vector<char> &batch, const size_t pageSize, const int numThreads)
+{
+	if(isComposite()){
+		sortRuns<CompositeKey>(batch, pageSize, numThreads, buildRunsComposite);
 	}else{
-		insertLeafHelper(key, rootPageNum, rid);
-	}	
+		sortRuns<int>(batch, pageSize, numThreads, buildRunsInt);
+	}
+}
 
-	// Unpin Header page
-	bufMgr->unPinPage(file, headerPageNum, true);
+void BTreeIndex::finishBuild()
+{
+	if(isComposite()){
+		bulkLoad<CompositeKey>(buildRunsComposite);
+		buildRunsComposite.clear();
+	}else{
+		bulkLoad<int>(buildRunsInt);
+		buildRunsInt.clear();
+	}
 }
 
-void BTreeIndex::insertLeafHelper(const void *key, PageId pageNo, const RecordId rid){
-	
-	// Create internal node 
-	Page* page; 
-	bufMgr->readPage(file, pageNo, page);
-	NonLeafNodeInt *node = (NonLeafNodeInt *)page;
+template <class T>
+void BTreeIndex::sortRuns(std::vector<char> &batch, const size_t pageSize, const int numThreads, std::vector<std::vector<RIDKeyPair<T> > > &runs) const
+{
+	size_t numPages = batch.size() / pageSize;
+	int numSlices = std::min<int>(numThreads, numPages);
+	size_t first = runs.size();
+	runs.resize(first + numSlices);
+
+	if(numSlices == 1){
+		extractRun<T>(batch, pageSize, 0, numPages, runs[first]);
+		return;
+	}
 
-	// Check every key in array for insertion position 
-	PageKeyPair<int> pageKey; 
-	for(int i = 0; i < INTARRAYNONLEAFSIZE+1; i++){
-		
-		// insert if key is less than node's key, 0 (end of partially filled array), INTARRAYNONLEAFSIZE (end of full array)
-		if(*(int *)key < node->keyArray[i] || 0 == node->pageNoArray[i+1] || i == INTARRAYNONLEAFSIZE){
-			
-			// Insert into leaf
-			if(node->level == 1){
+	// Each worker owns its slice of the batch and its run, nothing else is shared
+	std::vector<std::thread> workers;
+	for(int i = 0; i < numSlices; i++){
+		size_t begin = numPages * i / numSlices;
+		size_t end = numPages * (i+1) / numSlices;
+		workers.push_back(std::thread(&BTreeIndex::extractRun<T>, this, std::ref(batch), pageSize, begin, end, std::ref(runs[first + i])));
+	}
+	for(size_t i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+}
 
-				// Insert Page
-				pageKey = insertToLeaf(key, rid, node->pageNoArray[i]); 
-				
-				// Check if node split and needs to be updated
-				if(pageKey.pageNo != 0){
-					insertToNonLeaf(pageKey, pageNo); 
-				}
-				break;
-			}else {
-				insertLeafHelper(key, node->pageNoArray[i], rid);
-			}
-			break;
+template <class T>
+void BTreeIndex::extractRun(std::vector<char> &batch, const size_t pageSize, const size_t begin, const size_t end, std::vector<RIDKeyPair<T> > &run) const
+{
+	for(size_t p = begin; p < end; p++){
+		// only the bytes the relation stores of each page are in the batch
+		Page *page = (Page *)&batch[p * pageSize];
+		for(PageIterator iter = page->begin(); iter != page->end(); ++iter){
+			std::string recordStr = *iter;
+			T key;
+			getRecordKey(recordStr.c_str(), key);
+
+			RIDKeyPair<T> entry;
+			entry.set(iter.getCurrentRecord(), key);
+			run.push_back(entry);
 		}
 	}
-	
-	bufMgr->unPinPage(file, pageNo, false);
+	std::sort(run.begin(), run.end());
 }
 
-PageKeyPair<int> BTreeIndex::insertToLeaf(const void *key, const RecordId rid, PageId pageNo) {
-	
-	// Read Node that is being inserted to 
-	Page* page;
-	bufMgr->readPage(file, pageNo, page);
-	LeafNodeInt* node = (LeafNodeInt*)page;
+// -----------------------------------------------------------------------------
+// Packed leaves
+// -----------------------------------------------------------------------------
 
-	// Check if leaf node is full and keep track of leaf size
-	bool full = true; 
-	int size = -1; 
-	for (int i = 0; i < INTARRAYLEAFSIZE+1; i++) {
-		size = i; 
-		if (node->ridArray[i].page_number == 0 && i < INTARRAYLEAFSIZE) {
-			full = false;
-			break;
-		}
+// Bits needed to store every value from 0 to range
+static int bitsFor(unsigned long long range)
+{
+	int bits = 0;
+	while(range != 0){
+		bits++;
+		range >>= 1;
 	}
+	return bits;
+}
 
-	// Find position for insertion in keyArray
-	int pos = 0; 
-	for (int i = 0; i < size+1; i++) {
-		pos = i;
-		if (*(int*)key < node->keyArray[i]) {
-			break;
+// Bytes of a column of n values of the given width
+static size_t columnBytes(const int n, const int bits)
+{
+	return ((size_t)n * bits + 7) / 8;
+}
+
+// Ors n values of the given width into out one after another, from byte offset on.
+// Whole words are read and written, so out needs a word of room after the last value
+static void packBits(unsigned char *out, const size_t offset, const int bits, const std::vector<std::uint32_t> &values)
+{
+	for(size_t i = 0; i < values.size(); i++){
+		size_t bit = offset * 8 + i * bits;
+		std::uint64_t word;
+		memcpy(&word, out + bit / 8, sizeof(word));
+		word |= (std::uint64_t)values[i] << (bit % 8);
+		memcpy(out + bit / 8, &word, sizeof(word));
+	}
+}
+
+// Reads n values of the given width packed from byte offset on. Each value is one unaligned
+// word load, a shift and a mask with no branch, so the compiler can vectorize the loop
+static void unpackBits(const unsigned char *in, const size_t offset, const int bits, std::vector<std::uint32_t> &values)
+{
+	const std::uint64_t mask = bits == 0 ? 0 : (~0ULL >> (64 - bits));
+	for(size_t i = 0; i < values.size(); i++){
+		size_t bit = offset * 8 + i * bits;
+		std::uint64_t word;
+		memcpy(&word, in + bit / 8, sizeof(word));
+		values[i] = (std::uint32_t)((word >> (bit % 8)) & mask);
+	}
+}
+
+// Ranges of the columns of a packed leaf, grown one entry at a time
+template <class T>
+struct PackedFrame{
+	int numEntries;
+	T minKey, maxKey;
+	PageId minPage, maxPage;
+	SlotId minSlot, maxSlot;
+
+	PackedFrame() : numEntries(0), minKey(0), maxKey(0), minPage(0), maxPage(0), minSlot(0), maxSlot(0) {}
+
+	void add(const T key, const RecordId rid)
+	{
+		if(numEntries == 0){
+			minKey = maxKey = key;
+			minPage = maxPage = rid.page_number;
+			minSlot = maxSlot = rid.slot_number;
+		}else{
+			minKey = std::min(minKey, key);
+			maxKey = std::max(maxKey, key);
+			minPage = std::min(minPage, rid.page_number);
+			maxPage = std::max(maxPage, rid.page_number);
+			minSlot = std::min(minSlot, rid.slot_number);
+			maxSlot = std::max(maxSlot, rid.slot_number);
 		}
+		numEntries++;
 	}
 
-	// if node is not full
-	if (full == false) {
-		
-		// shifting keys and rids to right to make space to insert
-		for (int i = size; i > pos; i--) {
-			node->keyArray[i] = node->keyArray[i-1];
-			node->ridArray[i] = node->ridArray[i-1];
+	void getHeader(PackedLeafHeader &header) const
+	{
+		header.numEntries = numEntries;
+		header.keyBase = (int)minKey;
+		header.pageBase = minPage;
+		header.slotBase = minSlot;
+		header.keyBits = bitsFor((unsigned long long)((long long)maxKey - (long long)minKey));
+		header.pageBits = bitsFor(maxPage - minPage);
+		header.slotBits = bitsFor(maxSlot - minSlot);
+	}
+
+	// Bytes of a page holding these entries, including the room packBits() needs
+	size_t bytes() const
+	{
+		PackedLeafHeader header;
+		getHeader(header);
+		return sizeof(PackedLeafHeader) + columnBytes(numEntries, header.keyBits) + columnBytes(numEntries, header.pageBits)
+			+ columnBytes(numEntries, header.slotBits) + sizeof(std::uint64_t);
+	}
+};
+
+template <class T>
+LeafNode<T> BTreeIndex::leafView(Page *page, std::vector<char> &buffer, const bool unpack) const
+{
+	if(leafFormat == LEAF_APPEND){
+		LeafNode<T> node(page, leafOccupancy);
+		if(unpack){
+			mergeLeafTail(node);
 		}
+		return node;
+	}else if(leafFormat != LEAF_PACKED){
+		return LeafNode<T>(page, leafOccupancy);
+	}
 
-		// Add new record 
-		node->keyArray[pos] = *(int*)key;
-		node->ridArray[pos] = rid;
+	buffer.assign(leafOccupancy * (sizeof(T) + sizeof(RecordId)) + sizeof(PageId), 0);
+	LeafNode<T> node(&buffer[0], leafOccupancy);
+	if(!unpack){
+		return node;
+	}
 
-		bufMgr->unPinPage(this->file, pageNo, true);		
+	const unsigned char *in = (const unsigned char *)page;
+	PackedLeafHeader header;
+	memcpy(&header, in, sizeof(header));
+	node.rightSibPageNo = header.rightSibPageNo;
+
+	std::vector<std::uint32_t> values(header.numEntries);
+	size_t offset = sizeof(PackedLeafHeader);
+	unpackBits(in, offset, header.keyBits, values);
+	for(int i = 0; i < header.numEntries; i++){
+		node.keyArray[i] = (T)((long long)header.keyBase + values[i]);
 	}
-	else {
-		// Node is full and must be split 
-		PageKeyPair<int> pageKey = splitLeaf(pageNo);
+	offset += columnBytes(header.numEntries, header.keyBits);
+	unpackBits(in, offset, header.pageBits, values);
+	for(int i = 0; i < header.numEntries; i++){
+		node.ridArray[i].page_number = header.pageBase + values[i];
+	}
+	offset += columnBytes(header.numEntries, header.pageBits);
+	unpackBits(in, offset, header.slotBits, values);
+	for(int i = 0; i < header.numEntries; i++){
+		node.ridArray[i].slot_number = header.slotBase + values[i];
+	}
+	return node;
+}
 
-		// Check if key belongs in left or right split node
-		// No need to check return of insertToLeaf since the node was just split and
-		// therefore not full. 
-		if(pageKey.key < *(int*)key){
-			insertToLeaf(key, rid, pageKey.pageNo);
+template <class T>
+void BTreeIndex::mergeLeafTail(const LeafNode<T> &node) const
+{
+	LeafTail &tail = leafTail(node);
+	if(tail.numTail == 0){
+		return;
+	}
+
+	std::vector<RIDKeyPair<T> > appended(tail.numTail);
+	int sorted = tail.numEntries - tail.numTail;
+	for(int i = 0; i < tail.numTail; i++){
+		appended[i].set(node.ridArray[sorted+i], node.keyArray[sorted+i]);
+	}
+	std::sort(appended.begin(), appended.end());
+
+	// Fill the leaf from its last slot, taking the larger of the last sorted and the last appended entry
+	int i = sorted - 1;
+	int k = tail.numEntries - 1;
+	for(int j = tail.numTail - 1; j >= 0; k--){
+		if(i >= 0 && appended[j].key < node.keyArray[i]){
+			node.keyArray[k] = node.keyArray[i];
+			node.ridArray[k] = node.ridArray[i];
+			i--;
 		}else{
-			insertToLeaf(key, rid, pageNo); 
+			node.keyArray[k] = appended[j].key;
+			node.ridArray[k] = appended[j].rid;
+			j--;
 		}
+	}
+	leafBytesMoved += (tail.numEntries - 1 - i) * (sizeof(T) + sizeof(RecordId));
+	tail.numTail = 0;
+}
 
-		// Unpin pages and return pageKey to be added internally 
-		bufMgr->unPinPage(this->file, pageNo, true);
-		return pageKey; 
+template <class T>
+void BTreeIndex::storeLeaf(const LeafNode<T> &node, Page *page) const
+{
+	// Append leaves written through a view are sorted, only the count has to be set
+	if(leafFormat == LEAF_APPEND){
+		LeafTail &tail = leafTail(node);
+		tail.numEntries = 0;
+		while(tail.numEntries < leafOccupancy && node.ridArray[tail.numEntries].page_number != 0){
+			tail.numEntries++;
+		}
+		tail.numTail = 0;
+		return;
 	}
 
-	// Return empty pageKey if no splitting necessary 
-	PageKeyPair<int> pageKey; 
-	pageKey.pageNo = 0; 
-	return pageKey;
+	// Plain views already changed the page itself
+	if(leafFormat != LEAF_PACKED){
+		return;
+	}
+
+	PackedFrame<T> frame;
+	int n = 0;
+	while(n < leafOccupancy && node.ridArray[n].page_number != 0){
+		frame.add(node.keyArray[n], node.ridArray[n]);
+		n++;
+	}
+	PackedLeafHeader header;
+	frame.getHeader(header);
+	header.rightSibPageNo = node.rightSibPageNo;
+
+	unsigned char *out = (unsigned char *)page;
+	memset(out, 0, file->pageSize());
+	memcpy(out, &header, sizeof(header));
+
+	std::vector<std::uint32_t> values(n);
+	size_t offset = sizeof(PackedLeafHeader);
+	for(int i = 0; i < n; i++){
+		values[i] = (std::uint32_t)((long long)node.keyArray[i] - (long long)frame.minKey);
+	}
+	packBits(out, offset, header.keyBits, values);
+	offset += columnBytes(n, header.keyBits);
+	for(int i = 0; i < n; i++){
+		values[i] = node.ridArray[i].page_number - frame.minPage;
+	}
+	packBits(out, offset, header.pageBits, values);
+	offset += columnBytes(n, header.pageBits);
+	for(int i = 0; i < n; i++){
+		values[i] = node.ridArray[i].slot_number - frame.minSlot;
+	}
+	packBits(out, offset, header.slotBits, values);
 }
 
-void BTreeIndex::insertToNonLeaf(PageKeyPair<int> pageKey, PageId pageNo) {
-	
-	// Create internal node 
-	Page* page;
-	bufMgr->readPage(file, pageNo, page);
-	NonLeafNodeInt* node = (NonLeafNodeInt*)page;
+template <class T>
+bool BTreeIndex::packedLeafFits(const LeafNode<T> &node, const int n, const T key, const RecordId rid) const
+{
+	PackedFrame<T> frame;
+	for(int i = 0; i < n; i++){
+		frame.add(node.keyArray[i], node.ridArray[i]);
+	}
+	frame.add(key, rid);
+	return frame.bytes() <= file->pageSize();
+}
 
-	// Check if leaf node is full and keep track of leaf size
-	bool full = true; 
-	int size = -1; 
-	for (int i = 0; i < INTARRAYNONLEAFSIZE; i++) {
-		size = i; 
-		if(node->pageNoArray[i+1] == 0){
-			full = false;
-			// size = i+1;
-			break;
+template <class T>
+void BTreeIndex::bulkLoad(std::vector<std::vector<RIDKeyPair<T> > > &runs)
+{
+	size_t total = 0;
+	for(size_t i = 0; i < runs.size(); i++){
+		total += runs[i].size();
+	}
+	if(total == 0){
+		return;
+	}
+
+	// Min-heap of the runs ordered on their next entry
+	std::vector<size_t> heads(runs.size(), 0);
+	auto laterRun = [&runs, &heads](size_t a, size_t b){ return runs[b][heads[b]] < runs[a][heads[a]]; };
+	std::priority_queue<size_t, std::vector<size_t>, decltype(laterRun)> merge(laterRun);
+	for(size_t i = 0; i < runs.size(); i++){
+		if(!runs[i].empty()){
+			merge.push(i);
 		}
 	}
 
-	// Find position for insertion in keyArray
-	int pos = -1; 
-	for (int i = 0; i < size+1; i++) {
-		pos = i;
-		if (pageKey.key < node->keyArray[i]) {
-			break;
+	// Spread the entries evenly over as few leaves as fit them; the empty root is the first leaf.
+	// Packed leaves take entries until the next one no longer fits
+	size_t numLeaves = (total + leafOccupancy - 1) / leafOccupancy;
+	std::vector<PageKeyPair<T> > children;
+	std::vector<char> leafBuffer;
+	void *leafData = NULL;
+	Page *leafPage = NULL;
+	PageId leafNo = 0;
+	size_t done = 0;
+	for(size_t l = 0; done < total; l++){
+		Page *page;
+		PageId pageNo;
+		if(l == 0){
+			pageNo = rootPageNum;
+			bufMgr->readPage(file, pageNo, page);
+		}else{
+			allocNodePage(true, pageNo, page);
+			LeafNode<T> prevLeaf(leafData, leafOccupancy);
+			prevLeaf.rightSibPageNo = pageNo;
+			storeLeaf(prevLeaf, leafPage);
+			bufMgr->unPinPage(file, leafNo, true);
+		}
+		LeafNode<T> leaf = leafView<T>(page, leafBuffer, false);
+		leafData = leaf.keyArray;
+		leafPage = page;
+		leafNo = pageNo;
+
+		size_t count = (leafFormat == LEAF_PACKED) ? std::min<size_t>(total - done, leafOccupancy) : total * (l+1) / numLeaves - done;
+		PackedFrame<T> frame;
+		for(size_t i = 0; i < count; i++){
+			size_t r = merge.top();
+			if(leafFormat == LEAF_PACKED){
+				PackedFrame<T> grown = frame;
+				grown.add(runs[r][heads[r]].key, runs[r][heads[r]].rid);
+				if(grown.bytes() > file->pageSize()){
+					count = i;
+					break;
+				}
+				frame = grown;
+			}
+			merge.pop();
+			leaf.keyArray[i] = runs[r][heads[r]].key;
+			leaf.ridArray[i] = runs[r][heads[r]].rid;
+			heads[r]++;
+			if(heads[r] < runs[r].size()){
+				merge.push(r);
+			}else{
+				std::vector<RIDKeyPair<T> >().swap(runs[r]);
+			}
+		}
+		done += count;
+
+		PageKeyPair<T> pageKey;
+		pageKey.set(pageNo, leaf.keyArray[0]);
+		children.push_back(pageKey);
+	}
+	storeLeaf(LeafNode<T>(leafData, leafOccupancy), leafPage);
+	bufMgr->unPinPage(file, leafNo, true);
+
+	std::vector<PageId> freePages;
+	buildNonLeafLevels(children, freePages);
+}
+
+template <class T>
+void BTreeIndex::buildNonLeafLevels(std::vector<PageKeyPair<T> > &children, std::vector<PageId> &freePages)
+{
+	// Build each level from the first keys of the level below until one node is left
+	int level = 1;
+	while(children.size() > 1){
+		size_t fanout = nodeOccupancy + 1;
+		size_t numNodes = (children.size() + fanout - 1) / fanout;
+		std::vector<PageKeyPair<T> > parents;
+		size_t next = 0;
+		for(size_t n = 0; n < numNodes; n++){
+			Page *page;
+			PageId pageNo;
+			if(!freePages.empty()){
+				pageNo = freePages.back();
+				freePages.pop_back();
+				bufMgr->readPage(file, pageNo, page);
+				memset((void *)page, 0, file->pageSize());
+			}else{
+				allocNodePage(false, pageNo, page);
+			}
+			NonLeafNode<T> node(page, nodeOccupancy);
+			node.level = level;
+
+			size_t end = children.size() * (n+1) / numNodes;
+			node.pageNoArray[0] = children[next].pageNo;
+			for(size_t i = next + 1; i < end; i++){
+				node.keyArray[i-next-1] = children[i].key;
+				node.pageNoArray[i-next] = children[i].pageNo;
+			}
+
+			PageKeyPair<T> pageKey;
+			pageKey.set(pageNo, children[next].key);
+			parents.push_back(pageKey);
+			next = end;
+
+			bufMgr->unPinPage(file, pageNo, true);
+		}
+		children.swap(parents);
+		level++;
+	}
+
+	// Point the meta page at the new root
+	Page *headerPage;
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
+	rootPageNum = children[0].pageNo;
+	metaInfo->rootPageNo = rootPageNum;
+	metaInfo->rootIsLeaf = (level == 1);
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::mergeSortedEntries
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::mergeSortedEntries(const void* keys, const RecordId* rids, const int count)
+{
+	// Merges rewrite the leaves directly, so nothing may still wait above them; both leave the
+	// non-leaf nodes sorted, and they go back to the layout of the index afterwards
+	const NodeLayout layout = nodeLayout;
+	flushBuffers();
+
+	if(isComposite()){
+		std::vector<RIDKeyPair<CompositeKey> > batch(count > 0 ? count : 0);
+		for(int i = 0; i < count; i++){
+			batch[i].set(rids[i], ((const CompositeKey *)keys)[i]);
+		}
+		if(!std::is_sorted(batch.begin(), batch.end())){
+			std::sort(batch.begin(), batch.end());
+		}
+		mergeSorted(batch);
+	}else{
+		std::vector<RIDKeyPair<int> > batch(count > 0 ? count : 0);
+		for(int i = 0; i < count; i++){
+			batch[i].set(rids[i], ((const int *)keys)[i]);
+		}
+		if(!std::is_sorted(batch.begin(), batch.end())){
+			std::sort(batch.begin(), batch.end());
+		}
+		mergeSorted(batch);
+	}
+	setNodeLayout(layout);
+}
+
+template <class T>
+void BTreeIndex::mergeSorted(const std::vector<RIDKeyPair<T> > &batch)
+{
+	if(batch.empty()){
+		return;
+	}
+
+	Page *headerPage;
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	bool rootIsLeaf = ((IndexMetaInfo *) headerPage)->rootIsLeaf;
+	bufMgr->unPinPage(file, headerPageNum, false);
+
+	// Leaves in key order from the non-leaf nodes, without reading the leaves
+	std::vector<PageKeyPair<T> > leaves;
+	std::vector<PageId> nodePages;
+	if(rootIsLeaf){
+		PageKeyPair<T> leaf;
+		leaf.set(rootPageNum, std::numeric_limits<T>::min());
+		leaves.push_back(leaf);
+	}else{
+		collectLeaves<T>(rootPageNum, std::numeric_limits<T>::min(), leaves, nodePages);
+	}
+
+	// Every leaf takes the entries below the smallest key of the next one; the last takes the
+	// rest, so entries above the largest key fill it and go on into new leaves at the right edge
+	std::vector<PageKeyPair<T> > children;
+	std::vector<char> buffer;
+	size_t next = 0;
+	for(size_t l = 0; l < leaves.size(); l++){
+		size_t end = batch.size();
+		if(l + 1 < leaves.size()){
+			end = next;
+			while(end < batch.size() && batch[end].key < leaves[l+1].key){
+				end++;
+			}
+		}
+		if(end == next){
+			children.push_back(leaves[l]);
+			continue;
+		}
+
+		// Merge the entries of the leaf with its part of the batch
+		Page *page;
+		bufMgr->readPage(file, leaves[l].pageNo, page);
+		LeafNode<T> node = leafView<T>(page, buffer);
+		std::vector<RIDKeyPair<T> > merged;
+		merged.reserve(leafOccupancy + end - next);
+		int i = 0;
+		while(i < leafOccupancy && node.ridArray[i].page_number != 0){
+			while(next < end && batch[next].key < node.keyArray[i]){
+				merged.push_back(batch[next++]);
+			}
+			RIDKeyPair<T> entry;
+			entry.set(node.ridArray[i], node.keyArray[i]);
+			merged.push_back(entry);
+			i++;
+		}
+		merged.insert(merged.end(), batch.begin() + next, batch.begin() + end);
+		next = end;
+		PageId sibPageNo = node.rightSibPageNo;
+		bufMgr->unPinPage(file, leaves[l].pageNo, false);
+
+		std::vector<PageId> freePages;
+		writeLeaves(merged, leaves[l], sibPageNo, children, freePages, leafOccupancy);
+	}
+
+	// The old non-leaf pages hold the new non-leaf levels first, the rest go back to the file
+	std::reverse(nodePages.begin(), nodePages.end());
+	buildNonLeafLevels(children, nodePages);
+	for(size_t n = 0; n < nodePages.size(); n++){
+		bufMgr->disposePage(file, nodePages[n]);
+	}
+
+	// The rebuilt nodes are sorted
+	if(nodeLayout != LAYOUT_SORTED){
+		bufMgr->readPage(file, headerPageNum, headerPage);
+		((IndexMetaInfo *) headerPage)->nodeLayout = LAYOUT_SORTED;
+		nodeLayout = LAYOUT_SORTED;
+		bufMgr->unPinPage(file, headerPageNum, true);
+	}
+}
+
+template <class T>
+void BTreeIndex::collectLeaves(PageId pageNo, const T low, std::vector<PageKeyPair<T> > &leaves, std::vector<PageId> &nodePages)
+{
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy);
+	std::vector<T> keys;
+	std::vector<PageId> pageNos;
+	getNodeEntries(node, keys, pageNos);
+	int level = node.level;
+	bufMgr->unPinPage(file, pageNo, false);
+	nodePages.push_back(pageNo);
+
+	for(size_t i = 0; i < pageNos.size(); i++){
+		T childLow = (i == 0) ? low : keys[i-1];
+		if(level == 1){
+			PageKeyPair<T> leaf;
+			leaf.set(pageNos[i], childLow);
+			leaves.push_back(leaf);
+		}else{
+			collectLeaves<T>(pageNos[i], childLow, leaves, nodePages);
+		}
+	}
+}
+
+template <class T>
+void BTreeIndex::writeLeaves(const std::vector<RIDKeyPair<T> > &entries, const PageKeyPair<T> &first, const PageId sibPageNo,
+		std::vector<PageKeyPair<T> > &children, std::vector<PageId> &freePages, const int leafFill)
+{
+	// Spread the entries evenly over as few leaves as fit them, like a bulk load; packed leaves
+	// take entries until the next one no longer fits. Without entries the first leaf is left empty
+	size_t total = entries.size();
+	size_t numLeaves = std::max<size_t>((total + leafFill - 1) / leafFill, 1);
+	std::vector<char> leafBuffer;
+	void *leafData = NULL;
+	Page *leafPage = NULL;
+	PageId leafNo = 0;
+	size_t done = 0;
+	for(size_t l = 0; l == 0 || done < total; l++){
+		Page *page;
+		PageId pageNo;
+		if(l == 0 || !freePages.empty()){
+			if(l == 0){
+				pageNo = first.pageNo;
+			}else{
+				pageNo = freePages.back();
+				freePages.pop_back();
+			}
+			bufMgr->readPage(file, pageNo, page);
+			memset((void *)page, 0, file->pageSize());
+		}else{
+			allocNodePage(true, pageNo, page);
+		}
+		if(l > 0){
+			LeafNode<T> prevLeaf(leafData, leafOccupancy);
+			prevLeaf.rightSibPageNo = pageNo;
+			storeLeaf(prevLeaf, leafPage);
+			bufMgr->unPinPage(file, leafNo, true);
+		}
+		LeafNode<T> leaf = leafView<T>(page, leafBuffer, false);
+		leafData = leaf.keyArray;
+		leafPage = page;
+		leafNo = pageNo;
+
+		size_t count = (leafFormat == LEAF_PACKED) ? std::min<size_t>(total - done, leafFill) : total * (l+1) / numLeaves - done;
+		PackedFrame<T> frame;
+		for(size_t i = 0; i < count; i++){
+			const RIDKeyPair<T> &entry = entries[done + i];
+			if(leafFormat == LEAF_PACKED){
+				PackedFrame<T> grown = frame;
+				grown.add(entry.key, entry.rid);
+				if(grown.bytes() > file->pageSize()){
+					count = i;
+					break;
+				}
+				frame = grown;
+			}
+			leaf.keyArray[i] = entry.key;
+			leaf.ridArray[i] = entry.rid;
+		}
+
+		// The first leaf keeps the smallest key its parent gave it
+		PageKeyPair<T> pageKey;
+		pageKey.set(pageNo, l == 0 ? first.key : entries[done].key);
+		children.push_back(pageKey);
+		done += count;
+	}
+	LeafNode<T> lastLeaf(leafData, leafOccupancy);
+	lastLeaf.rightSibPageNo = sibPageNo;
+	storeLeaf(lastLeaf, leafPage);
+	bufMgr->unPinPage(file, leafNo, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::defragment
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::defragment(const int fillPercent)
+{
+	// The pages of a running scan and of buffered inserts are about to move; both leave the
+	// non-leaf nodes sorted, and they go back to the layout of the index afterwards
+	if(scanExecuting){
+		endScan();
+	}
+	const NodeLayout layout = nodeLayout;
+	flushBuffers();
+
+	if(isComposite()){
+		defragmentTree<CompositeKey>(fillPercent);
+	}else{
+		defragmentTree<int>(fillPercent);
+	}
+	setNodeLayout(layout);
+}
+
+template <class T>
+void BTreeIndex::defragmentTree(const int fillPercent)
+{
+	// Pages left in the reserved extents are among the pages rewritten or cut off below
+	Page *headerPage;
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
+	bool rootIsLeaf = metaInfo->rootIsLeaf;
+	metaInfo->leafExtentNext = metaInfo->leafExtentEnd = 0;
+	metaInfo->nodeExtentNext = metaInfo->nodeExtentEnd = 0;
+	bufMgr->unPinPage(file, headerPageNum, true);
+
+	std::vector<PageKeyPair<T> > leaves;
+	std::vector<PageId> nodePages;
+	if(rootIsLeaf){
+		PageKeyPair<T> leaf;
+		leaf.set(rootPageNum, std::numeric_limits<T>::min());
+		leaves.push_back(leaf);
+	}else{
+		collectLeaves<T>(rootPageNum, std::numeric_limits<T>::min(), leaves, nodePages);
+	}
+
+	// Every entry in key order, so that any page of the tree can be overwritten
+	std::vector<RIDKeyPair<T> > entries;
+	std::vector<char> buffer;
+	PageId lastPageNo = headerPageNum;
+	for(size_t l = 0; l < leaves.size(); l++){
+		Page *page;
+		bufMgr->readPage(file, leaves[l].pageNo, page);
+		LeafNode<T> node = leafView<T>(page, buffer);
+		for(int i = 0; i < leafOccupancy && node.ridArray[i].page_number != 0; i++){
+			RIDKeyPair<T> entry;
+			entry.set(node.ridArray[i], node.keyArray[i]);
+			entries.push_back(entry);
+		}
+		bufMgr->unPinPage(file, leaves[l].pageNo, false);
+		lastPageNo = std::max(lastPageNo, leaves[l].pageNo);
+	}
+	for(size_t n = 0; n < nodePages.size(); n++){
+		lastPageNo = std::max(lastPageNo, nodePages[n]);
+	}
+
+	// Pages past the tree, such as the rest of an extent, go first, so that leaves that do not fit
+	// in the pages of the tree continue right after them
+	bufMgr->flushFile(file);
+	static_cast<BlobFile *>(file)->truncate(lastPageNo + 1);
+
+	// Leaves take the pages after the meta page in key order, the non-leaf levels the next ones
+	std::vector<PageId> freePages;
+	for(PageId pageNo = lastPageNo; pageNo > headerPageNum + 1; pageNo--){
+		freePages.push_back(pageNo);
+	}
+	PageKeyPair<T> first;
+	first.set(headerPageNum + 1, std::numeric_limits<T>::min());
+	int leafFill = std::max(1, std::min(leafOccupancy, leafOccupancy * fillPercent / 100));
+	std::vector<PageKeyPair<T> > children;
+	writeLeaves(entries, first, 0, children, freePages, leafFill);
+	buildNonLeafLevels(children, freePages);
+
+	// Pages left over follow the last one in use; they leave the buffer pool and the file
+	if(!freePages.empty()){
+		bufMgr->flushFile(file);
+		static_cast<BlobFile *>(file)->truncate(freePages.back());
+	}
+
+	if(nodeLayout != LAYOUT_SORTED){
+		bufMgr->readPage(file, headerPageNum, headerPage);
+		((IndexMetaInfo *) headerPage)->nodeLayout = LAYOUT_SORTED;
+		nodeLayout = LAYOUT_SORTED;
+		bufMgr->unPinPage(file, headerPageNum, true);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::~BTreeIndex -- destructor
+// -----------------------------------------------------------------------------
+
+BTreeIndex::~BTreeIndex()
+{
+	// Stop scanning 
+	try{
+		endScan();
+	}catch(const ScanNotInitializedException &e){
+		// No Scan has been initialized. Catching Error and closing BTreeIndex
+	}
+
+	// Remove file 
+	bufMgr->flushFile(file);
+	delete file;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+{
+	// Splits and parent lookups work on sorted nodes only
+	if(nodeLayout != LAYOUT_SORTED){
+		setNodeLayout(LAYOUT_SORTED);
+	}
+
+	if(isComposite()){
+		insertKey<CompositeKey>(*(CompositeKey *)key, rid);
+	}else{
+		insertKey<int>(*(int *)key, rid);
+	}
+}
+
+template <class T>
+void BTreeIndex::insertKey(const T key, const RecordId rid) 
+{
+	// Get headerPage 
+	Page *headerPage; 
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
+
+	// Check if root is a leaf or internal node 
+	PageKeyPair<T> pageKey; 
+	if(metaInfo->rootIsLeaf){
+		
+		// Root is a leaf node 
+		pageKey = insertToLeaf(key, rid, rootPageNum); 
+
+		// Check if root was split and needs to change into an internal node 
+		if(pageKey.pageNo != 0){
+			
+			// Create a new internal node for the new root 
+			Page* newRootPage; 
+			PageId newRootNo; 
+			allocNodePage(false, newRootNo, newRootPage);
+			NonLeafNode<T> newRootNode(newRootPage, nodeOccupancy);
+			
+			// Initiialize new Root 
+			newRootNode.keyArray[0] = pageKey.key;
+			newRootNode.pageNoArray[0] = rootPageNum;
+			newRootNode.pageNoArray[1] = pageKey.pageNo;
+			newRootNode.level = 1; 
+
+			// Update header page 
+			metaInfo->rootPageNo = newRootNo; 
+			metaInfo->rootIsLeaf = false;
+			rootPageNum = newRootNo;
+
+			bufMgr->unPinPage(file, newRootNo, true);
+		}
+	}else if(nonLeafFormat == NONLEAF_BUFFERED){
+		// Inserts wait in the root buffer until a flush carries them down
+		bufferInsert(key, rid, INT_MAX);
+	}else{
+		insertLeafHelper(key, rootPageNum, rid);
+	}	
+
+	// Unpin Header page
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+template <class T>
+void BTreeIndex::insertLeafHelper(const T key, PageId pageNo, const RecordId rid){
+	
+	// Create internal node 
+	Page* page; 
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy);
+
+	// Check every key in array for insertion position 
+	PageKeyPair<T> pageKey; 
+	for(int i = 0; i < nodeOccupancy+1; i++){
+		
+		// insert if key is less than node's key, 0 (end of partially filled array), nodeOccupancy (end of full array)
+		if(i == nodeOccupancy || 0 == node.pageNoArray[i+1] || key < node.keyArray[i]){
+			
+			// Insert into leaf
+			if(node.level == 1){
+
+				// Insert Page
+				pageKey = insertToLeaf(key, rid, node.pageNoArray[i]); 
+				
+				// Check if node split and needs to be updated
+				if(pageKey.pageNo != 0){
+					insertToNonLeaf(pageKey, pageNo); 
+				}
+				break;
+			}else {
+				insertLeafHelper(key, node.pageNoArray[i], rid);
+			}
+			break;
+		}
+	}
+	
+	bufMgr->unPinPage(file, pageNo, false);
+}
+
+template <class T>
+void BTreeIndex::bufferInsert(const T key, const RecordId rid, const int level){
+
+	// Descend to the node of the level on the path of the key; the root takes any higher level
+	PageId pageNo = rootPageNum;
+	Page* page; 
+	bufMgr->readPage(file, pageNo, page);
+	while(NonLeafNode<T>(page, nodeOccupancy).level > level){
+		PageId childPageNo = findChildPage(NonLeafNode<T>(page, nodeOccupancy), key);
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = childPageNo;
+		bufMgr->readPage(file, pageNo, page);
+	}
+
+	// Append the message
+	NodeBuffer<T> buffer(page, nodeOccupancy, bufferOccupancy);
+	buffer.keyArray[buffer.numMessages] = key;
+	buffer.ridArray[buffer.numMessages] = rid;
+	buffer.numMessages++;
+	bool full = (buffer.numMessages == bufferOccupancy);
+	bufMgr->unPinPage(file, pageNo, true);
+
+	if(full){
+		flushBuffer<T>(pageNo);
+	}
+}
+
+template <class T>
+void BTreeIndex::flushBuffer(PageId pageNo){
+
+	Page* page; 
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy);
+	NodeBuffer<T> buffer(page, nodeOccupancy, bufferOccupancy);
+	int level = node.level;
+	std::vector<T> keys;
+	std::vector<PageId> pageNos;
+	getNodeEntries(node, keys, pageNos);
+
+	// Child of every message, and the child with the most of them
+	std::vector<int> childOf(buffer.numMessages);
+	std::vector<int> counts(pageNos.size(), 0);
+	int largest = 0;
+	for(int i = 0; i < buffer.numMessages; i++){
+		childOf[i] = std::upper_bound(keys.begin(), keys.end(), buffer.keyArray[i]) - keys.begin();
+		counts[childOf[i]]++;
+		if(counts[childOf[i]] > counts[largest]){
+			largest = childOf[i];
+		}
+	}
+
+	// Take its messages out of the buffer, the others keep their order
+	std::vector<RIDKeyPair<T> > batch;
+	int kept = 0;
+	for(int i = 0; i < buffer.numMessages; i++){
+		if(childOf[i] == largest){
+			RIDKeyPair<T> message;
+			message.set(buffer.ridArray[i], buffer.keyArray[i]);
+			batch.push_back(message);
+		}else{
+			buffer.keyArray[kept] = buffer.keyArray[i];
+			buffer.ridArray[kept] = buffer.ridArray[i];
+			kept++;
+		}
+	}
+	buffer.numMessages = kept;
+	bufMgr->unPinPage(file, pageNo, true);
+
+	// In key order, the inserts into one leaf follow each other while it is in the pool. Each
+	// one descends from the root again, since the batch can split the nodes on its way
+	std::sort(batch.begin(), batch.end());
+	for(size_t i = 0; i < batch.size(); i++){
+		if(level == 1){
+			insertLeafHelper(batch[i].key, rootPageNum, batch[i].rid);
+		}else{
+			bufferInsert(batch[i].key, batch[i].rid, level - 1);
+		}
+	}
+}
+
+template <class T>
+PageId BTreeIndex::findBufferedNode(PageId pageNo){
+
+	Page* page; 
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy);
+	if(NodeBuffer<T>(page, nodeOccupancy, bufferOccupancy).numMessages > 0){
+		bufMgr->unPinPage(file, pageNo, false);
+		return pageNo;
+	}
+	int level = node.level;
+	std::vector<T> keys;
+	std::vector<PageId> pageNos;
+	getNodeEntries(node, keys, pageNos);
+	bufMgr->unPinPage(file, pageNo, false);
+
+	if(level > 1){
+		for(size_t i = 0; i < pageNos.size(); i++){
+			PageId bufferedPageNo = findBufferedNode<T>(pageNos[i]);
+			if(bufferedPageNo != 0){
+				return bufferedPageNo;
+			}
+		}
+	}
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::flushBuffers
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::flushBuffers()
+{
+	if(nonLeafFormat != NONLEAF_BUFFERED){
+		return;
+	}
+
+	// Flushes insert into the leaves, which needs sorted nodes
+	if(nodeLayout != LAYOUT_SORTED){
+		setNodeLayout(LAYOUT_SORTED);
+	}
+
+	Page *headerPage; 
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	bool rootIsLeaf = ((IndexMetaInfo *) headerPage)->rootIsLeaf;
+	bufMgr->unPinPage(file, headerPageNum, false);
+	if(rootIsLeaf){
+		return;
+	}
+
+	// Messages only move down, so flushing the first buffered node in preorder until none is
+	// left ends; the root can change along the way
+	PageId pageNo;
+	while((pageNo = findBufferedNode<int>(rootPageNum)) != 0){
+		flushBuffer<int>(pageNo);
+	}
+}
+
+template <class T>
+PageKeyPair<T> BTreeIndex::insertToLeaf(const T key, const RecordId rid, PageId pageNo) {
+	
+	// Read Node that is being inserted to 
+	Page* page;
+	bufMgr->readPage(file, pageNo, page);
+
+	// Append leaves with room take the entry at the end, merging a full tail first
+	if (leafFormat == LEAF_APPEND) {
+		LeafNode<T> node(page, leafOccupancy);
+		LeafTail &tail = leafTail(node);
+		if (tail.numEntries < leafOccupancy) {
+			if (tail.numTail == LEAFTAILSIZE) {
+				mergeLeafTail(node);
+			}
+			node.keyArray[tail.numEntries] = key;
+			node.ridArray[tail.numEntries] = rid;
+			tail.numEntries++;
+			tail.numTail++;
+			bufMgr->unPinPage(this->file, pageNo, true);
+
+			PageKeyPair<T> pageKey; 
+			pageKey.pageNo = 0; 
+			return pageKey;
+		}
+	}
+
+	std::vector<char> buffer;
+	LeafNode<T> node = leafView<T>(page, buffer);
+
+	// Check if leaf node is full and keep track of leaf size
+	bool full = true; 
+	int size = -1; 
+	for (int i = 0; i < leafOccupancy+1; i++) {
+		size = i; 
+		if (i < leafOccupancy && node.ridArray[i].page_number == 0) {
+			full = false;
+			break;
+		}
+	}
+
+	// A packed leaf is also full when one more entry would not pack into the page
+	if (!full && leafFormat == LEAF_PACKED && !packedLeafFits(node, size, key, rid)) {
+		full = true;
+	}
+
+	// Find position for insertion in keyArray
+	int pos = 0; 
+	for (int i = 0; i < size+1; i++) {
+		pos = i;
+		if (key < node.keyArray[i]) {
+			break;
+		}
+	}
+
+	// if node is not full
+	if (full == false) {
+		
+		// shifting keys and rids to right to make space to insert
+		for (int i = size; i > pos; i--) {
+			node.keyArray[i] = node.keyArray[i-1];
+			node.ridArray[i] = node.ridArray[i-1];
+		}
+		leafBytesMoved += (size - pos) * (sizeof(T) + sizeof(RecordId));
+
+		// Add new record 
+		node.keyArray[pos] = key;
+		node.ridArray[pos] = rid;
+		storeLeaf(node, page);
+
+		bufMgr->unPinPage(this->file, pageNo, true);		
+	}
+	else {
+		// Node is full and must be split 
+		PageKeyPair<T> pageKey = splitLeaf<T>(pageNo);
+
+		// Check if key belongs in left or right split node
+		// No need to check return of insertToLeaf since the node was just split and
+		// therefore not full. 
+		if(pageKey.key < key){
+			insertToLeaf(key, rid, pageKey.pageNo);
+		}else{
+			insertToLeaf(key, rid, pageNo); 
+		}
+
+		// Unpin pages and return pageKey to be added internally 
+		bufMgr->unPinPage(this->file, pageNo, true);
+		return pageKey; 
+	}
+
+	// Return empty pageKey if no splitting necessary 
+	PageKeyPair<T> pageKey; 
+	pageKey.pageNo = 0; 
+	return pageKey;
+}
+
+template <class T>
+void BTreeIndex::insertToNonLeaf(PageKeyPair<T> pageKey, PageId pageNo) {
+	
+	// Create internal node 
+	Page* page;
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy);
+
+	// Check if leaf node is full and keep track of leaf size
+	bool full = true; 
+	int size = -1; 
+	for (int i = 0; i < nodeOccupancy; i++) {
+		size = i; 
+		if(node.pageNoArray[i+1] == 0){
+			full = false;
+			// size = i+1;
+			break;
+		}
+	}
+
+	// Find position for insertion in keyArray
+	int pos = -1; 
+	for (int i = 0; i < size+1; i++) {
+		pos = i;
+		if (pageKey.key < node.keyArray[i]) {
+			break;
+		}
+	}
+
+	// if node is not full
+	if (full == false) {
+		// shifting keys and rids to right to make space to insert
+		for (int i = size; i > pos; i--) {
+			node.keyArray[i] = node.keyArray[i-1];
+			node.pageNoArray[i+1] = node.pageNoArray[i];
+		}
+
+		// Add pointer
+		node.keyArray[pos] = pageKey.key;
+		node.pageNoArray[pos+1] = pageKey.pageNo;
+	}
+	else {
+		PageKeyPair<T> pushUp = splitNonLeaf(pageNo, pageKey); 
+
+		// Push up the new node to root or parent node
+		if(pageNo == rootPageNum){
+			updateRootNode(pushUp);
+		}else{
+			PageId parentId = findParentNode(pushUp, rootPageNum, node.level+1);
+			insertToNonLeaf(pushUp, parentId); 
+		}
+	}
+
+	bufMgr->unPinPage(file, pageNo, true);
+}
+
+template <class T>
+PageId BTreeIndex::findParentNode(PageKeyPair<T> pageKey, PageId pageNo, int level){
+	
+	// Create root node 
+	Page* page; 
+	bufMgr->readPage(file, pageNo, page); 
+	NonLeafNode<T> node(page, nodeOccupancy); 
+
+	// Find position to be inserted
+	int i = 0; 
+	while(i < nodeOccupancy && node.pageNoArray[i+1] != 0){
+		if(pageKey.key < node.keyArray[i]){
+			break; 
+		}
+		i++; 
+	}
+	int nodeLevel = node.level;
+	PageId childPageNo = node.pageNoArray[i];
+
+	bufMgr->unPinPage(file, pageNo, false);
+
+	if(nodeLevel == level){
+		return pageNo; 
+	}else{
+		return findParentNode(pageKey, childPageNo, level);
+	}
+}
+
+template <class T>
+void BTreeIndex::updateRootNode(PageKeyPair<T> pageKey){
+
+	// Get headerPage 
+	Page *headerPage; 
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
+
+	// Create a new internal node for the new root 
+	Page* newRootPage; 
+	PageId newRootNo; 
+	allocNodePage(false, newRootNo, newRootPage);
+	NonLeafNode<T> newRootNode(newRootPage, nodeOccupancy);
+
+	// Get Old Root Page  
+	Page *oldRootPage; 
+	bufMgr->readPage(file, rootPageNum, oldRootPage);
+
+	// Update Level 
+	NonLeafNode<T> oldRootNode(oldRootPage, nodeOccupancy); 
+	newRootNode.level = oldRootNode.level+1; 
+	
+	bufMgr->unPinPage(file, rootPageNum, false);
+	
+	// Initiialize new Root 
+	newRootNode.keyArray[0] = pageKey.key;
+	newRootNode.pageNoArray[0] = rootPageNum;
+	newRootNode.pageNoArray[1] = pageKey.pageNo;
+
+	// Update header page 
+	metaInfo->rootPageNo = newRootNo; 
+	metaInfo->rootIsLeaf = false;
+	rootPageNum = newRootNo;
+
+	bufMgr->unPinPage(file, headerPageNum, true);  
+	bufMgr->unPinPage(file, newRootNo, true);
+}
+
+template <class T>
+PageKeyPair<T> BTreeIndex::splitNonLeaf(PageId pageNo, PageKeyPair<T> newPageKey){
+	
+	// Read node to be split 
+	Page* page; 
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy); 
+
+	// Create new Node (will be inserted to the left of node)
+	Page* newPage; 
+	PageId newPageNo; 
+	allocNodePage(false, newPageNo, newPage);
+	NonLeafNode<T> newNode(newPage, nodeOccupancy); 
+	newNode.level = node.level; 
+	
+	// Lay out the keys and children of the full node with the new entry in place
+	std::vector<T> keys(node.keyArray, node.keyArray + nodeOccupancy);
+	std::vector<PageId> pageNos(node.pageNoArray, node.pageNoArray + nodeOccupancy + 1);
+	int pos = std::upper_bound(keys.begin(), keys.end(), newPageKey.key) - keys.begin();
+	keys.insert(keys.begin() + pos, newPageKey.key);
+	pageNos.insert(pageNos.begin() + pos + 1, newPageKey.pageNo);
+
+	// PageKey to be pushed to parent: the middle key, which neither node keeps
+	int mid = (nodeOccupancy + 1)/2;
+	PageKeyPair<T> pageKey; 
+	pageKey.set(newPageNo, keys[mid]);
+
+	// Keys left of the middle stay, keys right of it move to the new node
+	for(int i = 0; i < nodeOccupancy; i++){
+		node.keyArray[i] = i < mid ? keys[i] : 0;
+		node.pageNoArray[i+1] = i < mid ? pageNos[i+1] : 0;
+	}
+	for(int i = mid+1; i <= nodeOccupancy; i++){
+		newNode.keyArray[i-mid-1] = keys[i];
+	}
+	for(int i = mid+1; i <= nodeOccupancy+1; i++){
+		newNode.pageNoArray[i-mid-1] = pageNos[i];
+	}
+
+	// Buffered messages follow their children: keys from the middle key up go to the new node
+	if(nonLeafFormat == NONLEAF_BUFFERED){
+		NodeBuffer<T> buffer(page, nodeOccupancy, bufferOccupancy);
+		NodeBuffer<T> newBuffer(newPage, nodeOccupancy, bufferOccupancy);
+		newBuffer.numMessages = 0;
+		int kept = 0;
+		for(int i = 0; i < buffer.numMessages; i++){
+			if(buffer.keyArray[i] < pageKey.key){
+				buffer.keyArray[kept] = buffer.keyArray[i];
+				buffer.ridArray[kept] = buffer.ridArray[i];
+				kept++;
+			}else{
+				newBuffer.keyArray[newBuffer.numMessages] = buffer.keyArray[i];
+				newBuffer.ridArray[newBuffer.numMessages] = buffer.ridArray[i];
+				newBuffer.numMessages++;
+			}
+		}
+		buffer.numMessages = kept;
+	}
+
+	// Unpin Pages
+	bufMgr->unPinPage(file, pageNo, true);
+	bufMgr->unPinPage(file, newPageNo, true);
+
+	return pageKey; 
+}
+
+template <class T>
+PageKeyPair<T> BTreeIndex::splitLeaf(PageId pageNo){
+	
+	// Read node to be split 
+	Page* page;
+	bufMgr->readPage(file, pageNo, page);
+	std::vector<char> buffer;
+	LeafNode<T> node = leafView<T>(page, buffer);
+
+	// Create new Node (will be inserted to the left of node) 
+	Page* newPage; 
+	PageId newPageNo; 
+	allocNodePage(true, newPageNo, newPage);
+	std::vector<char> newBuffer;
+	LeafNode<T> newNode = leafView<T>(newPage, newBuffer, false);
+
+	// insert newNode into linked list 
+	newNode.rightSibPageNo = node.rightSibPageNo; 
+	node.rightSibPageNo = newPageNo;
+
+	// A packed leaf can fill its page before all its slots
+	int size = 0;
+	while(size < leafOccupancy && node.ridArray[size].page_number != 0){
+		size++;
+	}
+
+	// Populate new page with last half of old node records 
+	int idx = 0; 
+	for(int i = size/2; i < size; i++){
+		// Add key and rid to newNode
+		newNode.keyArray[idx] = node.keyArray[i]; 
+		newNode.ridArray[idx] = node.ridArray[i];
+
+		// Remove key and rid from node
+		node.keyArray[i] = 0;
+		node.ridArray[i].page_number = 0;
+		idx++; 
+	}
+	storeLeaf(node, page);
+	storeLeaf(newNode, newPage);
+
+	// unpin old and new nodes
+	bufMgr->unPinPage(file, pageNo, true);
+	bufMgr->unPinPage(file, newPageNo, true);
+
+	// return the new pageNo and key to be inserted to parent node 
+	PageKeyPair<T> pageKey; 
+	pageKey.set(newPageNo, newNode.keyArray[0]);
+
+	return pageKey;
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const int limit)
+{
+	if (lowOpParm != GT && lowOpParm != GTE) {
+		throw BadOpcodesException();
+	}
+
+	if (highOpParm != LT && highOpParm != LTE) {
+		throw BadOpcodesException();
+	}
+
+	if (this->scanExecuting) {
+		this->endScan();
+	}
+	
+	if (isComposite() ? *(CompositeKey*)lowValParm > *(CompositeKey*)highValParm : *(int*)lowValParm > *(int*)highValParm) {
+		throw BadScanrangeException();
+	}
+	
+	// Initializing private variables 
+	this->scanExecuting = true;
+	if (isComposite()) {
+		this->lowValComposite = *(CompositeKey*)lowValParm;
+		this->highValComposite = *(CompositeKey*)highValParm;
+	} else {
+		this->lowValInt = *(int*)lowValParm;
+		this->highValInt = *(int*)highValParm;
+	}
+    this->lowOp = lowOpParm;
+    this->highOp = highOpParm;
+	this->scanLimit = limit;
+	this->scanCount = 0;
+	this->scanRanges.clear();
+	this->nextRange = 0;
+	this->skipScan = false;
+
+	// Nothing to return, so there is no need to pin a leaf at all
+	if (limit == 0) {
+		this->currentPageData = NULL;
+		return;
+	}
+
+	if (isComposite()) {
+		seekScanLeaf<CompositeKey>();
+	} else {
+		startPendingMerge(lowValInt, highValInt);
+		seekScanLeaf<int>();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startPrefixScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startPrefixScan(const void* prefixVal, const int limit)
+{
+	if (!isComposite()) {
+		startScan(prefixVal, GTE, prefixVal, LTE, limit);
+		return;
+	}
+
+	// Every key starting with the prefix lies between the prefix followed by the
+	// smallest and by the largest values of the remaining attributes
+	int lowAttrs[MAXKEYATTRS];
+	int highAttrs[MAXKEYATTRS];
+	for (int i = 0; i < MAXKEYATTRS; i++) {
+		lowAttrs[i] = INT_MIN;
+		highAttrs[i] = INT_MAX;
+	}
+	lowAttrs[0] = highAttrs[0] = *(int*)prefixVal;
+	CompositeKey low = makeCompositeKey(lowAttrs, keyAttrs.size());
+	CompositeKey high = makeCompositeKey(highAttrs, keyAttrs.size());
+	startScan(&low, GTE, &high, LTE, limit);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startSkipScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startSkipScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const SkipScanMode mode)
+{
+	if (!isComposite()) {
+		throw BadScanParamException();
+	}
+
+	if (lowOpParm != GT && lowOpParm != GTE) {
+		throw BadOpcodesException();
+	}
+
+	if (highOpParm != LT && highOpParm != LTE) {
+		throw BadOpcodesException();
+	}
+
+	if (this->scanExecuting) {
+		this->endScan();
+	}
+
+	if (*(int*)lowValParm > *(int*)highValParm) {
+		throw BadScanrangeException();
+	}
+
+	// Initializing private variables 
+	this->scanExecuting = true;
+	this->scanLimit = -1;
+	this->scanCount = 0;
+	this->scanRanges.clear();
+	this->nextRange = 0;
+	this->currentPageData = NULL;
+	this->skipScan = true;
+
+	// Closed bounds on the second attribute; an empty range completes right away
+	long long low = *(int*)lowValParm;
+	long long high = *(int*)highValParm;
+	if (lowOpParm == GT) {
+		low++;
+	}
+	if (highOpParm == LT) {
+		high--;
+	}
+	if (low > high) {
+		return;
+	}
+	this->skipLowVal = (int)low;
+	this->skipHighVal = (int)high;
+
+	this->skipScanMode = (mode == SKIP_AUTO) ? chooseSkipScanMode() : mode;
+
+	// Seeks start with the smallest leading value and move on from there, walks
+	// cover every leading value in one range
+	int lowAttrs[] = {INT_MIN, skipLowVal};
+	int highAttrs[] = {INT_MIN, skipHighVal};
+	if (skipScanMode == SKIP_WALK) {
+		highAttrs[0] = INT_MAX;
+	}
+	setScanBounds(makeCompositeKey(lowAttrs, MAXKEYATTRS), makeCompositeKey(highAttrs, MAXKEYATTRS));
+
+	seekScanLeaf<CompositeKey>();
+}
+
+SkipScanMode BTreeIndex::chooseSkipScanMode()
+{
+	// Get headerPage 
+	Page *headerPage; 
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	bool rootIsLeaf = ((IndexMetaInfo *) headerPage)->rootIsLeaf;
+	bufMgr->unPinPage(file, headerPageNum, false);
+
+	// A single leaf is read either way
+	if (rootIsLeaf) {
+		return SKIP_WALK;
+	}
+
+	// Count children of the root and the leading values its separators start
+	Page *page; 
+	bufMgr->readPage(file, rootPageNum, page);
+	NonLeafNodeComposite node(page, nodeOccupancy);
+	std::vector<CompositeKey> keys;
+	std::vector<PageId> pageNos;
+	getNodeEntries(node, keys, pageNos);
+	// Child 0 holds the first leading value; a separator only adds one when it
+	// differs from the separator before it, as the first one may well continue
+	// the value of child 0
+	int children = 1;
+	int distinct = 1;
+	int attrVals[MAXKEYATTRS];
+	int prevLead = 0;
+	for (size_t i = 0; i < keys.size(); i++) {
+		splitCompositeKey(keys[i], attrVals);
+		if (i > 0 && attrVals[0] != prevLead) {
+			distinct++;
+		}
+		prevLead = attrVals[0];
+		children++;
+	}
+	bufMgr->unPinPage(file, rootPageNum, false);
+
+	return (2 * distinct >= children) ? SKIP_WALK : SKIP_SEEK;
+}
+
+bool BTreeIndex::nextSkipRange(CompositeKey key)
+{
+	if (this->skipScanMode != SKIP_SEEK) {
+		return false;
+	}
+
+	// Past the wanted values of this leading value, so move on to the next one
+	int attrVals[MAXKEYATTRS];
+	splitCompositeKey(key, attrVals);
+	if (attrVals[1] > this->skipHighVal) {
+		if (attrVals[0] == INT_MAX) {
+			return false;
+		}
+		attrVals[0]++;
+	}
+
+	int lowAttrs[] = {attrVals[0], skipLowVal};
+	int highAttrs[] = {attrVals[0], skipHighVal};
+	setScanBounds(makeCompositeKey(lowAttrs, MAXKEYATTRS), makeCompositeKey(highAttrs, MAXKEYATTRS));
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startMultiRangeScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startMultiRangeScan(const std::vector<ScanRange> &ranges, const int limit)
+{
+	for (size_t i = 0; i < ranges.size(); i++) {
+		if (ranges[i].lowOp != GT && ranges[i].lowOp != GTE) {
+			throw BadOpcodesException();
+		}
+		if (ranges[i].highOp != LT && ranges[i].highOp != LTE) {
+			throw BadOpcodesException();
+		}
+	}
+
+	if (this->scanExecuting) {
+		this->endScan();
+	}
+
+	if (isComposite()) {
+		setScanRanges<CompositeKey>(ranges);
+	} else {
+		setScanRanges<int>(ranges);
+	}
+
+	// Initializing private variables 
+	this->scanExecuting = true;
+	this->scanLimit = limit;
+	this->scanCount = 0;
+	this->currentPageData = NULL;
+	this->skipScan = false;
+
+	if (scanRanges.empty() || limit == 0) {
+		return;
+	}
+
+	setScanBounds(scanRanges[0].first, scanRanges[0].second);
+	this->nextRange = 1;
+
+	if (isComposite()) {
+		seekScanLeaf<CompositeKey>();
+	} else {
+		startPendingMerge((int)scanRanges.front().first, (int)scanRanges.back().second);
+		seekScanLeaf<int>();
+	}
+}
+
+template <class T>
+void BTreeIndex::setScanRanges(const std::vector<ScanRange> &ranges)
+{
+	for (size_t i = 0; i < ranges.size(); i++) {
+		if (*(T*)ranges[i].lowVal > *(T*)ranges[i].highVal) {
+			throw BadScanrangeException();
+		}
+	}
+
+	// Turn every range into a closed interval, dropping the ones with no possible key
+	std::vector< std::pair<long long, long long> > closed;
+	for (size_t i = 0; i < ranges.size(); i++) {
+		T low = *(T*)ranges[i].lowVal;
+		T high = *(T*)ranges[i].highVal;
+		if (ranges[i].lowOp == GT) {
+			if (low == std::numeric_limits<T>::max()) {
+				continue;
+			}
+			low++;
+		}
+		if (ranges[i].highOp == LT) {
+			if (high == std::numeric_limits<T>::min()) {
+				continue;
+			}
+			high--;
+		}
+		if (low <= high) {
+			closed.push_back(std::make_pair((long long)low, (long long)high));
+		}
+	}
+	std::sort(closed.begin(), closed.end());
+
+	// Merge overlapping and adjacent intervals so each key is visited once
+	this->scanRanges.clear();
+	this->nextRange = 0;
+	for (size_t i = 0; i < closed.size(); i++) {
+		if (!scanRanges.empty() && (scanRanges.back().second == std::numeric_limits<long long>::max()
+				|| closed[i].first <= scanRanges.back().second + 1)) {
+			if (closed[i].second > scanRanges.back().second) {
+				scanRanges.back().second = closed[i].second;
+			}
+		} else {
+			scanRanges.push_back(closed[i]);
 		}
 	}
+}
 
-	// if node is not full
-	if (full == false) {
-		// shifting keys and rids to right to make space to insert
-		for (int i = size; i > pos; i--) {
-			node->keyArray[i] = node->keyArray[i-1];
-			node->pageNoArray[i+1] = node->pageNoArray[i];
-		}
+void BTreeIndex::setScanBounds(long long low, long long high)
+{
+	this->lowOp = GTE;
+	this->highOp = LTE;
+	if (isComposite()) {
+		this->lowValComposite = low;
+		this->highValComposite = high;
+	} else {
+		this->lowValInt = (int)low;
+		this->highValInt = (int)high;
+	}
+}
 
-		// Add pointer
-		node->keyArray[pos] = pageKey.key;
-		node->pageNoArray[pos+1] = pageKey.pageNo;
+void BTreeIndex::startPendingMerge(const int low, const int high)
+{
+	this->mergePending = false;
+	this->pendingScan.clear();
+	if (nonLeafFormat != NONLEAF_BUFFERED) {
+		return;
 	}
-	else {
-		PageKeyPair<int> pushUp = splitNonLeaf(pageNo, pageKey); 
 
-		// Push up the new node to root or parent node
-		if(pageNo == rootPageNum){
-			updateRootNode(pushUp);
-		}else{
-			PageId parentId = findParentNode(pushUp, rootPageNum, node->level+1);
-			insertToNonLeaf(pushUp, parentId); 
-		}
+	Page *headerPage; 
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	bool rootIsLeaf = ((IndexMetaInfo *) headerPage)->rootIsLeaf;
+	bufMgr->unPinPage(file, headerPageNum, false);
+	if (rootIsLeaf) {
+		return;
 	}
 
-	bufMgr->unPinPage(file, pageNo, true);
+	collectPending(rootPageNum, low, high);
+	if (pendingScan.empty()) {
+		return;
+	}
+	std::sort(pendingScan.begin(), pendingScan.end());
+
+	// The limit counts messages and leaf entries together, so the leaf scan runs unbounded
+	this->mergePending = true;
+	this->nextPending = 0;
+	this->mergeLookahead = false;
+	this->mergeLimit = this->scanLimit;
+	this->mergeCount = 0;
+	this->scanLimit = -1;
 }
 
-PageId BTreeIndex::findParentNode(PageKeyPair<int> pageKey, PageId pageNo, int level){
-	
-	// Create root node 
-	Page* page; 
-	bufMgr->readPage(file, pageNo, page); 
-	NonLeafNodeInt* node = (NonLeafNodeInt*)page; 
-
-	// Find position to be inserted
-	int i = 0; 
-	while(node->pageNoArray[i+1] != 0 && i != INTARRAYNONLEAFSIZE+1){
-		if(pageKey.key < node->keyArray[i]){
-			break; 
+void BTreeIndex::collectPending(PageId pageNo, const int low, const int high)
+{
+	Page *page; 
+	bufMgr->readPage(this->file, pageNo, page);
+	NonLeafNodeInt node(page, nodeOccupancy);
+	NodeBuffer<int> buffer(page, nodeOccupancy, bufferOccupancy);
+	for (int i = 0; i < buffer.numMessages; i++) {
+		if (matchesScan(buffer.keyArray[i])) {
+			RIDKeyPair<int> message;
+			message.set(buffer.ridArray[i], buffer.keyArray[i]);
+			pendingScan.push_back(message);
 		}
-		i++; 
 	}
-
+	int level = node.level;
+	std::vector<int> keys;
+	std::vector<PageId> pageNos;
+	getNodeEntries(node, keys, pageNos);
 	bufMgr->unPinPage(file, pageNo, false);
 
-	if(node->level == level){
-		return pageNo; 
-	}else{
-		return findParentNode(pageKey, node->pageNoArray[i], level);
+	// Child i holds the keys from keys[i-1] up to keys[i]
+	if (level > 1) {
+		for (size_t i = 0; i < pageNos.size(); i++) {
+			if ((i == 0 || keys[i-1] <= high) && (i == keys.size() || keys[i] > low)) {
+				collectPending(pageNos[i], low, high);
+			}
+		}
+	}
+}
+
+bool BTreeIndex::matchesScan(const int key) const
+{
+	if (!scanRanges.empty()) {
+		for (size_t i = 0; i < scanRanges.size(); i++) {
+			if (key >= scanRanges[i].first && key <= scanRanges[i].second) {
+				return true;
+			}
+		}
+		return false;
 	}
+
+	bool aboveLow = (this->lowOp == GT) ? key > lowValInt : key >= lowValInt;
+	bool belowHigh = (this->highOp == LT) ? key < highValInt : key <= highValInt;
+	return aboveLow && belowHigh;
 }
 
-void BTreeIndex::updateRootNode(PageKeyPair<int> pageKey){
+template <class T>
+void BTreeIndex::seekScanLeaf() {
 
 	// Get headerPage 
 	Page *headerPage; 
 	headerPageNum = file->getFirstPageNo();
 	bufMgr->readPage(file, headerPageNum, headerPage);
 	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
-
-	// Create a new internal node for the new root 
-	Page* newRootPage; 
-	PageId newRootNo; 
-	bufMgr->allocPage(file, newRootNo, newRootPage);
-	NonLeafNodeInt *newRootNode = (NonLeafNodeInt *)newRootPage;
-
-	// Get Old Root Page  
-	Page *oldRootPage; 
-	bufMgr->readPage(file, rootPageNum, oldRootPage);
-
-	// Update Level 
-	NonLeafNodeInt *oldRootNode = (NonLeafNodeInt *)oldRootPage; 
-	newRootNode->level = oldRootNode->level+1; 
-	
-	bufMgr->unPinPage(file, rootPageNum, false);
+	bool rootIsLeaf = metaInfo->rootIsLeaf;
+	bufMgr->unPinPage(file, headerPageNum, false);
 	
-	// Initiialize new Root 
-	newRootNode->keyArray[0] = pageKey.key;
-	newRootNode->pageNoArray[0] = rootPageNum;
-	newRootNode->pageNoArray[1] = pageKey.pageNo;
-
-	// Update header page 
-	metaInfo->rootPageNo = newRootNo; 
-	metaInfo->rootIsLeaf = false;
-	rootPageNum = newRootNo;
-
-	bufMgr->unPinPage(file, headerPageNum, true);  
-	bufMgr->unPinPage(file, newRootNo, true);
+	if(rootIsLeaf){
+		readScanLeaf<T>(this->rootPageNum);
+		this->nextEntry = findScanEntry(scanLeaf<T>(), 0);
+		return; 
+	}
+ 
+	scanHelper<T>(rootPageNum);
 }
 
-PageKeyPair<int> BTreeIndex::splitNonLeaf(PageId pageNo, PageKeyPair<int> newPageKey){
+template <class T>
+void BTreeIndex::scanHelper(PageId pageNo) {
 	
-	// Read node to be split 
-	Page* page; 
-	bufMgr->readPage(file, pageNo, page);
-	NonLeafNodeInt* node = (NonLeafNodeInt*)page; 
+	// Creates Internal node being checked 
+	Page *page; 
+	bufMgr->readPage(this->file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy);
 
-	// Create new Node (will be inserted to the left of node)
-	Page* newPage; 
-	PageId newPageNo; 
-	bufMgr->allocPage(file, newPageNo, newPage);
-	NonLeafNodeInt *newNode = (NonLeafNodeInt*)newPage; 
-	newNode->level = node->level; 
-	
-	int mid = INTARRAYNONLEAFSIZE/2;
+	// Child left of the first key greater than the low value
+	T low, high;
+	getScanBounds(low, high);
+	PageId childPageNo = findChildPage(node, low);
+	int level = node.level;
+	bufMgr->unPinPage(file, pageNo, false); 
 
-	// PageKey to be pushed to parent 
-	PageKeyPair<int> pageKey; 
-	pageKey.pageNo = newPageNo;
-	pageKey.key = node->keyArray[mid];
+	if(level == 1){
+		// Leaf Node found. Set private variables 
+		readScanLeaf<T>(childPageNo);
+		this->nextEntry = findScanEntry(scanLeaf<T>(), 0);
+	}else{
+		scanHelper<T>(childPageNo);
+	}
+}
 
-	// Fill Arrays 	
-	for(int i = 0; i < INTARRAYNONLEAFSIZE; i++){
-		if(i < mid-1){
-			// Add 
-			newNode->keyArray[i] = node->keyArray[i+mid+1];
-			newNode->pageNoArray[i] = node->pageNoArray[i+mid+1];
+template <class T>
+void BTreeIndex::readScanLeaf(PageId pageNo) {
+	bufMgr->readPage(this->file, pageNo, this->currentPageData);
+	this->currentPageNum = pageNo;
+	if (leafFormat != LEAF_PLAIN) {
+		leafView<T>(this->currentPageData, scanLeafBuffer);
+	}
+}
 
-			// Remove 
-			node->keyArray[i+mid+1] = 0; 
-			node->pageNoArray[i+mid+1] = 0; 
-		}else if(i == mid-1){
-			// Add 
-			newNode->keyArray[i] = newPageKey.key; 
-			newNode->pageNoArray[i] = node->pageNoArray[i+mid+1];
-			newNode->pageNoArray[i+1] = newPageKey.pageNo; 
+template <class T>
+LeafNode<T> BTreeIndex::scanLeaf() {
+	if (leafFormat == LEAF_PACKED) {
+		return LeafNode<T>(&scanLeafBuffer[0], leafOccupancy);
+	}
+	return LeafNode<T>(this->currentPageData, leafOccupancy);
+}
 
-			// Remove
-			node->pageNoArray[i+mid+1] = 0;
-			node->keyArray[i+1] = 0; 	
+template <class T>
+PageId BTreeIndex::findChildPage(const NonLeafNode<T> &node, const T key) const {
+	if (nodeLayout == LAYOUT_EYTZINGER) {
+		// Descend the implicit tree, going right past every key <= key; the bits of k record
+		// the path, and stripping the trailing right turns and the last left turn leaves the
+		// first key greater than key, or 0 if there is none
+		int n = node.numKeys;
+		unsigned int k = 1;
+		while (k <= (unsigned int)n) {
+			k = 2 * k + (node.keyArray[k-1] <= key);
 		}
+		k >>= __builtin_ffs(~k);
+		return k == 0 ? node.pageNoArray[n] : node.pageNoArray[k-1];
 	}
 
-	// Unpin Pages
-	bufMgr->unPinPage(file, pageNo, true);
-	bufMgr->unPinPage(file, newPageNo, true);
-
-	return pageKey; 
+	// Number of keys in the node that are <= key
+	int pos = 0;
+	while (pos < nodeOccupancy && node.pageNoArray[pos+1] != 0 && node.keyArray[pos] <= key) {
+		pos++;
+	}
+	return node.pageNoArray[pos];
 }
 
-PageKeyPair<int> BTreeIndex::splitLeaf(PageId pageNo){
-	
-	// Read node to be split 
-	Page* page;
-	bufMgr->readPage(file, pageNo, page);
-	LeafNodeInt* node = (LeafNodeInt*)page;
-
-	// Create new Node (will be inserted to the left of node) 
-	Page* newPage; 
-	PageId newPageNo; 
-	bufMgr->allocPage(file, newPageNo, newPage);
-	LeafNodeInt *newNode = (LeafNodeInt *) newPage;
-
-	// insert newNode into linked list 
-	newNode->rightSibPageNo = node->rightSibPageNo; 
-	node->rightSibPageNo = newPageNo;
+// Positions of an implicit binary search tree of n nodes in sorted (in-order) order
+static void eytzingerOrder(const int k, const int n, std::vector<int> &order)
+{
+	if (k <= n) {
+		eytzingerOrder(2 * k, n, order);
+		order.push_back(k);
+		eytzingerOrder(2 * k + 1, n, order);
+	}
+}
 
-	// Populate new page with last half of old node records 
-	int idx = 0; 
-	for(int i = INTARRAYLEAFSIZE/2; i < INTARRAYLEAFSIZE; i++){
-		// Add key and rid to newNode
-		newNode->keyArray[idx] = node->keyArray[i]; 
-		newNode->ridArray[idx] = node->ridArray[i];
+template <class T>
+void BTreeIndex::getNodeEntries(const NonLeafNode<T> &node, std::vector<T> &keys, std::vector<PageId> &pageNos) const {
+	keys.clear();
+	pageNos.clear();
+	if (nodeLayout == LAYOUT_EYTZINGER) {
+		std::vector<int> order;
+		eytzingerOrder(1, node.numKeys, order);
+		for (size_t i = 0; i < order.size(); i++) {
+			keys.push_back(node.keyArray[order[i]-1]);
+			pageNos.push_back(node.pageNoArray[order[i]-1]);
+		}
+		pageNos.push_back(node.pageNoArray[node.numKeys]);
+		return;
+	}
 
-		// Remove key and rid from node
-		node->keyArray[i] = 0;
-		node->ridArray[i].page_number = 0;
-		idx++; 
+	pageNos.push_back(node.pageNoArray[0]);
+	for (int i = 0; i < nodeOccupancy && node.pageNoArray[i+1] != 0; i++) {
+		keys.push_back(node.keyArray[i]);
+		pageNos.push_back(node.pageNoArray[i+1]);
 	}
+}
 
-	// unpin old and new nodes
+template <class T>
+void BTreeIndex::relayoutNode(PageId pageNo, const NodeLayout layout) {
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> node(page, nodeOccupancy);
+
+	std::vector<T> keys;
+	std::vector<PageId> pageNos;
+	getNodeEntries(node, keys, pageNos);
+	int n = keys.size();
+	int level = node.level;
+
+	if (layout == LAYOUT_EYTZINGER) {
+		std::vector<int> order;
+		eytzingerOrder(1, n, order);
+		for (int i = 0; i < n; i++) {
+			node.keyArray[order[i]-1] = keys[i];
+			node.pageNoArray[order[i]-1] = pageNos[i];
+		}
+	} else {
+		for (int i = 0; i < n; i++) {
+			node.keyArray[i] = keys[i];
+			node.pageNoArray[i] = pageNos[i];
+		}
+	}
+	node.pageNoArray[n] = pageNos[n];
+	node.numKeys = n;
 	bufMgr->unPinPage(file, pageNo, true);
-	bufMgr->unPinPage(file, newPageNo, true);
-
-	// return the new pageNo and key to be inserted to parent node 
-	PageKeyPair<int> pageKey; 
-	pageKey.set(newPageNo, newNode->keyArray[0]);
 
-	return pageKey;
+	if (level > 1) {
+		for (size_t i = 0; i < pageNos.size(); i++) {
+			relayoutNode<T>(pageNos[i], layout);
+		}
+	}
 }
 
-
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScan
+// BTreeIndex::setExtentPages
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::startScan(const void* lowValParm,
-				   const Operator lowOpParm,
-				   const void* highValParm,
-				   const Operator highOpParm)
+void BTreeIndex::setExtentPages(const int pages)
 {
-	if (lowOpParm != GT && lowOpParm != GTE) {
-		throw BadOpcodesException();
-	}
+	Page *headerPage; 
+	headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
+	extentPages = std::max(pages, 1);
+	metaInfo->extentPages = extentPages;
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
 
-	if (highOpParm != LT && highOpParm != LTE) {
-		throw BadOpcodesException();
+void BTreeIndex::allocNodePage(const bool leaf, PageId &pageNo, Page *&page)
+{
+	Page *headerPage; 
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
+	PageId &next = leaf ? metaInfo->leafExtentNext : metaInfo->nodeExtentNext;
+	PageId &end = leaf ? metaInfo->leafExtentEnd : metaInfo->nodeExtentEnd;
+
+	// Without extents the file grows page by page once the pages reserved earlier are used up;
+	// non-leaf nodes take pages freed by merges first, as leaves would leave their extents
+	if((next == end && extentPages <= 1) || (!leaf && static_cast<BlobFile *>(file)->numFreePages() > 0)){
+		bufMgr->unPinPage(file, headerPageNum, false);
+		bufMgr->allocPage(file, pageNo, page);
+		return;
 	}
 
-	if (this->scanExecuting) {
-		this->endScan();
+	// The position in the extent is in the meta page, so a reopened index goes on from it
+	if(next == end){
+		next = static_cast<BlobFile *>(file)->allocateExtent(extentPages);
+		end = next + extentPages;
 	}
-	
-	if (*(int*)lowValParm > *(int*)highValParm) {
-		throw BadScanrangeException();
+	pageNo = next++;
+	bufMgr->allocPageAt(file, pageNo, page);
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setNodeLayout
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setNodeLayout(const NodeLayout layout)
+{
+	if (layout == nodeLayout) {
+		return;
 	}
-	
-	// Initializing private variables 
-	this->scanExecuting = true;
-	this->lowValInt = *(int*)lowValParm;
-    this->highValInt = *(int*)highValParm;
-    this->lowOp = lowOpParm;
-    this->highOp = highOpParm;
 
-	// Get headerPage 
 	Page *headerPage; 
 	headerPageNum = file->getFirstPageNo();
 	bufMgr->readPage(file, headerPageNum, headerPage);
 	IndexMetaInfo *metaInfo = (IndexMetaInfo *) headerPage;
-	bufMgr->unPinPage(file, headerPageNum, false);
-	
-	if(metaInfo->rootIsLeaf){
-		this->currentPageNum = this->rootPageNum;
-		bufMgr->readPage(file, currentPageNum, currentPageData); 
-     	LeafNodeInt* root = (LeafNodeInt*)currentPageData; 
 
-		for(int i = 0; i < INTARRAYLEAFSIZE; i++){
-			
-			if (this->lowOp == GT && root->keyArray[i] > this->lowValInt) {
-				nextEntry = i; 
-				break;
-			} else if (this->lowOp == GTE && root->keyArray[i] >= this->lowValInt) {
-				nextEntry = i; 
-				break;
-			} 
+	// Leaves are the same in every layout
+	if (!metaInfo->rootIsLeaf) {
+		if (isComposite()) {
+			relayoutNode<CompositeKey>(rootPageNum, layout);
+		} else {
+			relayoutNode<int>(rootPageNum, layout);
 		}
-		return; 
 	}
- 
-	scanHelper(rootPageNum);
+
+	metaInfo->nodeLayout = layout;
+	nodeLayout = layout;
+	bufMgr->unPinPage(file, headerPageNum, true);
 }
 
-void BTreeIndex::scanHelper(PageId pageNo) {
-	
-	// Creates Internal node being checked 
-	Page *page; 
-	bufMgr->readPage(this->file, pageNo, page);
-	NonLeafNodeInt* node = (NonLeafNodeInt*)page;
-	bufMgr->unPinPage(file, pageNo, false); 
+template <class T>
+int BTreeIndex::findScanEntry(const LeafNode<T> &node, int start) {
+	T low, high;
+	getScanBounds(low, high);
 
-	// Find the position 
-	int pos = 0;
-	for (int i = 0; i < INTARRAYNONLEAFSIZE+1; i++) {
-		if (node->keyArray[i] > this->lowValInt ) {
-			pos = i; 
+	int i = start;
+	while (i < leafOccupancy && node.ridArray[i].page_number != 0) {
+		if (this->lowOp == GT && node.keyArray[i] > low) {
 			break;
-		}else if( node->pageNoArray[i+1] == 0 ){
-			pos = 1;
+		} else if (this->lowOp == GTE && node.keyArray[i] >= low) {
 			break;
 		}
+		i++;
 	}
+	return i;
+}
 
-	if(node->level == 1){
-		// Leaf Node found. Set private variables 
-		bufMgr->readPage(file, node->pageNoArray[pos], this->currentPageData); 
-		this->currentPageNum = node->pageNoArray[pos]; 
-
-		LeafNodeInt *leafNode = (LeafNodeInt*)currentPageData; 
+template <class T>
+bool BTreeIndex::advanceScanRange() {
+	LeafNode<T> node = scanLeaf<T>();
 
-		// Find the the first nextEntry 
-		for(int i = 0; i < INTARRAYLEAFSIZE; i++){
-			if (this->lowOp == GT && leafNode->keyArray[i] > this->lowValInt) {
-				nextEntry = i; 
-				break;
-			} else if (this->lowOp == GTE && leafNode->keyArray[i] >= this->lowValInt) {
-				nextEntry = i; 
-				break;
-			} 
+	// Skip scans work out their next range from the key that ended the current one
+	if (this->skipScan) {
+		if (!nextSkipRange(node.keyArray[nextEntry])) {
+			return false;
 		}
-	}else{
-		scanHelper(node->pageNoArray[pos]);
+	} else {
+		if ((size_t)this->nextRange >= this->scanRanges.size()) {
+			return false;
+		}
+
+		setScanBounds(scanRanges[nextRange].first, scanRanges[nextRange].second);
+		this->nextRange++;
+	}
+
+	// Next range starts inside the current leaf
+	this->nextEntry = findScanEntry(node, this->nextEntry);
+	if (this->nextEntry < leafOccupancy && node.ridArray[nextEntry].page_number != 0) {
+		return true;
+	}
+
+	// Nothing to the right, so none of the remaining ranges can match
+	PageId sibPageNo = node.rightSibPageNo;
+	releaseScanPage();
+	if (sibPageNo == 0) {
+		return false;
+	}
+
+	// Next range starts inside the right sibling, which a walk would read anyway
+	readScanLeaf<T>(sibPageNo);
+	LeafNode<T> sibNode = scanLeaf<T>();
+	this->nextEntry = findScanEntry(sibNode, 0);
+	if (this->nextEntry < leafOccupancy && sibNode.ridArray[nextEntry].page_number != 0) {
+		return true;
 	}
+
+	// Next range starts further away, descend again from the root
+	releaseScanPage();
+	seekScanLeaf<T>();
+	return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -628,31 +2434,137 @@ void BTreeIndex::scanNext(RecordId& outRid)
 	 	throw ScanNotInitializedException();
 	}
 
-    LeafNodeInt* node = (LeafNodeInt*) this->currentPageData;
+	if (isComposite()) {
+		scanNextEntry<CompositeKey>(outRid, NULL);
+	} else if (this->mergePending) {
+		scanNextMerged(outRid, NULL);
+	} else {
+		scanNextEntry<int>(outRid, NULL);
+	}
+}
 
-	// End Scan or go to next node 
-	if(this->nextEntry >= INTARRAYLEAFSIZE || node->ridArray[nextEntry].page_number == 0){
-		
-		if (node->rightSibPageNo == 0) {
-			throw IndexScanCompletedException(); // if leaf is over
-		} else {
-			bufMgr->unPinPage(this->file, this->currentPageNum, false);
+void BTreeIndex::scanNext(RecordId& outRid, void* outKey) 
+{
+	if (this->scanExecuting == false){
+	 	throw ScanNotInitializedException();
+	}
 
-			this->nextEntry = 0; //reinitialize nextentry
-			this->currentPageNum = node->rightSibPageNo;
-			bufMgr->readPage(this->file, this->currentPageNum, this->currentPageData);
-			node = (LeafNodeInt*) this->currentPageData;
+	if (isComposite()) {
+		scanNextEntry<CompositeKey>(outRid, (CompositeKey*)outKey);
+	} else if (this->mergePending) {
+		scanNextMerged(outRid, (int*)outKey);
+	} else {
+		scanNextEntry<int>(outRid, (int*)outKey);
+	}
+}
+
+void BTreeIndex::scanNextMerged(RecordId& outRid, int* outKey)
+{
+	if (this->mergeLimit >= 0 && this->mergeCount >= this->mergeLimit) {
+		throw IndexScanCompletedException();
+	}
+
+	// Read the next leaf entry ahead while the leaves have one
+	if (!this->mergeLookahead && this->currentPageData != NULL) {
+		try {
+			scanNextEntry<int>(mergeLeafEntry.rid, &mergeLeafEntry.key);
+			this->mergeLookahead = true;
+		} catch (const IndexScanCompletedException &e) {
 		}
 	}
 
-	// Check if rid is found or if the scan has been completed
-	if (this->highOp == LT && node->keyArray[this->nextEntry] < this->highValInt) {
-		outRid = node->ridArray[nextEntry];
-	} else if (this->highOp == LTE && node->keyArray[this->nextEntry] <= this->highValInt) {
-		outRid = node->ridArray[nextEntry];
-	} else {throw IndexScanCompletedException();}
+	bool fromPending = nextPending < pendingScan.size()
+		&& (!this->mergeLookahead || pendingScan[nextPending].key < mergeLeafEntry.key);
+	if (!fromPending && !this->mergeLookahead) {
+		throw IndexScanCompletedException();
+	}
+
+	RIDKeyPair<int> entry;
+	if (fromPending) {
+		entry = pendingScan[nextPending++];
+	} else {
+		entry = mergeLeafEntry;
+		this->mergeLookahead = false;
+	}
+	outRid = entry.rid;
+	if (outKey != NULL) {
+		*outKey = entry.key;
+	}
+
+	// Release the leaf right away once the limit is reached
+	this->mergeCount += 1;
+	if (this->mergeLimit >= 0 && this->mergeCount >= this->mergeLimit) {
+		releaseScanPage();
+	}
+}
+
+template <class T>
+void BTreeIndex::scanNextEntry(RecordId& outRid, T* outKey) 
+{
+	while (1) {
+		// Leaf was already released because the scan ran out or reached its limit
+		if (this->currentPageData == NULL){
+			throw IndexScanCompletedException();
+		}
+
+		LeafNode<T> node = scanLeaf<T>();
+
+		// End Scan or go to next node 
+		if(this->nextEntry >= leafOccupancy || node.ridArray[nextEntry].page_number == 0){
+			
+			if (node.rightSibPageNo == 0) {
+				releaseScanPage();
+				throw IndexScanCompletedException(); // if leaf is over
+			} else {
+				bufMgr->unPinPage(this->file, this->currentPageNum, false);
+				if (node.rightSibPageNo != this->currentPageNum + 1) {
+					this->leafJumps++;
+				}
+
+				this->nextEntry = 0; //reinitialize nextentry
+				readScanLeaf<T>(node.rightSibPageNo);
+				continue;
+			}
+		}
+
+		// Check if rid is found or if the current range has been completed
+		T low, high;
+		getScanBounds(low, high);
+		bool found = false;
+		if (this->highOp == LT && node.keyArray[this->nextEntry] < high) {
+			found = true;
+		} else if (this->highOp == LTE && node.keyArray[this->nextEntry] <= high) {
+			found = true;
+		}
+
+		if (found) {
+			// Skip scans also have to match the second key attribute
+			if (this->skipScan) {
+				int attrVals[MAXKEYATTRS];
+				splitCompositeKey(node.keyArray[this->nextEntry], attrVals);
+				if (attrVals[1] < this->skipLowVal || attrVals[1] > this->skipHighVal) {
+					this->nextEntry += 1;
+					continue;
+				}
+			}
+			outRid = node.ridArray[nextEntry];
+			if (outKey != NULL) {
+				*outKey = node.keyArray[nextEntry];
+			}
+			break;
+		} else if (!advanceScanRange<T>()) {
+			releaseScanPage();
+			throw IndexScanCompletedException();
+		}
+	}
 
 	this->nextEntry += 1; //update to next
+
+	// Release the leaf right away once the limit is reached
+	this->scanCount += 1;
+	if (this->scanLimit >= 0 && this->scanCount >= this->scanLimit) {
+		releaseScanPage();
+	}
 	return;
 }
 
@@ -667,16 +2579,27 @@ void BTreeIndex::endScan()
 	}
 	
 	// unpin pages if pinned
-	bufMgr->unPinPage(this->file, this->currentPageNum, false);
+	releaseScanPage();
+	mergePending = false;
+	pendingScan.clear();
 	scanExecuting = false; // signifies scan complete
 	
 	return;
 }
 
+void BTreeIndex::releaseScanPage()
+{
+	if (this->currentPageData != NULL) {
+		bufMgr->unPinPage(this->file, this->currentPageNum, false);
+		this->currentPageData = NULL;
+	}
+}
+
 // -----------------------------------------------------------------------------
 // Printing Methods for debugging purposes 
 // -----------------------------------------------------------------------------
 
+template <class T>
 void BTreeIndex::printTree(PageId pageNo, bool leaf){
 	
 	Page* headerPage; 
@@ -684,42 +2607,42 @@ void BTreeIndex::printTree(PageId pageNo, bool leaf){
 	IndexMetaInfo* metaInfo = (IndexMetaInfo*)headerPage; 
 
 	if(metaInfo->rootIsLeaf){
-		printNode(pageNo);
+		printNode<T>(pageNo);
 		bufMgr->unPinPage(file, headerPageNum, false);
 	}else{
 		bufMgr->unPinPage(file, headerPageNum, false);
 
 		Page* page; 
 		bufMgr->readPage(file, pageNo, page); 
-		NonLeafNodeInt* node = (NonLeafNodeInt*)page; 
+		NonLeafNode<T> node(page, nodeOccupancy); 
 
 		int size = 0; 
-		for (int i = 0; i < INTARRAYNONLEAFSIZE+1; i++) {
+		for (int i = 0; i < nodeOccupancy+1; i++) {
 			size = i; 
-			if(node->pageNoArray[i+1] == 0){
+			if(node.pageNoArray[i+1] == 0){
 				size = i; 
 				break;
 			}
 		}
 
 		for (int i = 0; i < size+1; i++) {
-			if(node->level == 1){
-				std::cout << "." << i << "." << node->pageNoArray[i] << "." << std::endl;
+			if(node.level == 1){
+				std::cout << "." << i << "." << node.pageNoArray[i] << "." << std::endl;
 				if(i == 0){
-					printNode(node->pageNoArray[i]);
+					printNode<T>(node.pageNoArray[i]);
 				}else{
-					std::cout << "[" << i << "]: " << node->keyArray[i-1] << std::endl;
-					printNode(node->pageNoArray[i]);
+					std::cout << "[" << i << "]: " << node.keyArray[i-1] << std::endl;
+					printNode<T>(node.pageNoArray[i]);
 				}
 			}else{
-				if(node->pageNoArray[i] == 0){
+				if(node.pageNoArray[i] == 0){
 					break;
 				}else if(i == 0){
-					std::cout << pageNo << " Level: " << node->level << std::endl; 
-					printTree(node->pageNoArray[i], false); 
+					std::cout << pageNo << " Level: " << node.level << std::endl; 
+					printTree<T>(node.pageNoArray[i], false); 
 				}else{
-					std::cout << pageNo << " Level: " << node->level << " - Key: " << node->keyArray[i-1] << std::endl;
-					printTree(node->pageNoArray[i], false);
+					std::cout << pageNo << " Level: " << node.level << " - Key: " << node.keyArray[i-1] << std::endl;
+					printTree<T>(node.pageNoArray[i], false);
 				}
 				
 			}
@@ -728,25 +2651,31 @@ void BTreeIndex::printTree(PageId pageNo, bool leaf){
 	}
 }
 
+template <class T>
 void BTreeIndex::printNode(PageId pageNo){
 	Page* page;
 	bufMgr->readPage(this->file, pageNo, page);
-	LeafNodeInt* node = (LeafNodeInt*)page;
+	std::vector<char> buffer;
+	LeafNode<T> node = leafView<T>(page, buffer);
 
-	int size = -1; // if not, keep track of node's size
+	int size = leafOccupancy; // if not, keep track of node's size
 	
-	for (int i = 0; i < INTARRAYLEAFSIZE+1; i++) {
-		if(node->ridArray[i].page_number == 0){
+	for (int i = 0; i < leafOccupancy; i++) {
+		if(node.ridArray[i].page_number == 0){
 			size = i;
 			break;
 		}
 	}
 
 	std::cout << "     Printing Node " << size << std::endl; 
-	for (int i = 0; i < size+1; i++) {
-		std::cout << "     [" << i << "]: " << node->keyArray[i] << "." << node->ridArray[i].page_number << std::endl;
+	for (int i = 0; i < size; i++) {
+		std::cout << "     [" << i << "]: " << node.keyArray[i] << "." << node.ridArray[i].page_number << std::endl;
 	}
 	bufMgr->unPinPage(file, pageNo, false);
 }
 
+// Leaf and node views used by LearnedIndex
+template LeafNode<int> BTreeIndex::leafView<int>(Page *page, std::vector<char> &buffer, const bool unpack) const;
+template void BTreeIndex::getNodeEntries<int>(const NonLeafNode<int> &node, std::vector<int> &keys, std::vector<PageId> &pageNos) const;
+
 }
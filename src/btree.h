@@ -15,6 +15,8 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
+#include <utility>
 
 #include "types.h"
 #include "page.h"
@@ -45,18 +47,171 @@ enum Operator
 	GT		/* Greater Than */
 };
 
+/**
+ * @brief How a skip scan finds its entries. Passed to BTreeIndex::startSkipScan() method.
+ */
+enum SkipScanMode
+{
+	SKIP_AUTO,	/* Pick SKIP_SEEK or SKIP_WALK from the shape of the tree */
+	SKIP_SEEK,	/* Descend again for every distinct leading attribute value */
+	SKIP_WALK		/* Walk every leaf and filter on the second attribute */
+};
+
+/**
+ * @brief Order of the keys inside non-leaf nodes. Recorded in IndexMetaInfo and changed with
+ * BTreeIndex::setNodeLayout() method.
+ */
+enum NodeLayout
+{
+	LAYOUT_SORTED = 0,	/* Keys in sorted order; inserts need this layout */
+	LAYOUT_EYTZINGER		/* Keys in breadth-first order of an implicit binary search tree, for read-mostly indexes */
+};
+
+/**
+ * @brief Format of leaf pages. Recorded in IndexMetaInfo and chosen when the index file is created.
+ */
+enum LeafFormat
+{
+	LEAF_PLAIN = 0,	/* Arrays of keys and RecordIds */
+	LEAF_PACKED,		/* Frame-of-reference bit-packed columns, for INTEGER keys; see PackedLeafHeader */
+	LEAF_APPEND			/* Arrays of keys and RecordIds ending in an unsorted tail of recent inserts; see LeafTail */
+};
+
+/**
+ * @brief Largest number of unsorted entries at the end of a LEAF_APPEND leaf.
+ */
+const  int LEAFTAILSIZE = 32;
+
+/**
+ * @brief Format of non-leaf pages. Recorded in IndexMetaInfo and chosen when the index file is created.
+ */
+enum NonLeafFormat
+{
+	NONLEAF_PLAIN = 0,	/* Keys and page numbers only */
+	NONLEAF_BUFFERED		/* Fewer keys and a buffer of pending inserts, for INTEGER keys; see NodeBuffer */
+};
+
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief Number of key slots in B+Tree leaf for INTEGER key, for index files with Page::SIZE pages.
  */
 //                                                  sibling ptr             key               rid
 const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key, for index files with Page::SIZE pages.
+ */
+//                                                     level, numKeys       extra pageNo                  key       pageNo
+const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - 2 * sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+
+/**
+ * @brief Normalized key of a composite (multi-attribute) index. The INTEGER attributes of the
+ * key are packed so that comparing two normalized keys as integers orders them lexicographically
+ * by attribute. See BTreeIndex::makeCompositeKey().
+ */
+typedef long long CompositeKey;
+
+/**
+ * @brief Maximum number of attributes in a composite key.
+ */
+const  int MAXKEYATTRS = sizeof( CompositeKey ) / sizeof( int );
+
+/**
+ * @brief Number of key slots in B+Tree leaf for COMPOSITE key, for index files with Page::SIZE pages.
+ */
+//                                                       sibling ptr                 key                   rid
+const  int COMPOSITEARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( CompositeKey ) + sizeof( RecordId ) );
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for COMPOSITE key, for index files with Page::SIZE pages.
+ */
+//                                                     level, numKeys       extra pageNo                      key              pageNo
+const  int COMPOSITEARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( CompositeKey ) - sizeof( PageId ) ) / ( sizeof( CompositeKey ) + sizeof( PageId ) );
+
+/**
+ * @brief Bytes of relation pages read into memory at a time by a bulk build. Each batch is
+ * cut into one slice per build thread and every slice becomes a sorted run.
+ */
+const  int BUILDBATCHBYTES = 8 * 1024 * 1024;
+
+/**
+ * @brief Passed as the number of build threads when a new index file is created empty because
+ * BTreeIndex::buildIndexes() fills it together with other indexes.
+ */
+const  int DEFERREDBUILD = -1;
+
+/**
+ * @brief Number of pages a new index file reserves at once for leaves, and for non-leaf nodes.
+ * Leaves allocated one after the other then lie next to each other in the file instead of between
+ * non-leaf nodes; see BTreeIndex::setExtentPages().
+ */
+const  int EXTENTPAGES = 64;
+
+/**
+ * @brief Number of key slots in B+Tree nodes for each type of key stored in the tree, worked
+ * out from the page size of the index file.
+ */
+template <class T>
+struct NodeCapacity{
+  /**
+   * Bytes taken by the level and key count of a non-leaf node, padded so that the keys after them are aligned.
+   */
+	static const int NONLEAFHEADER = sizeof( T ) > 2 * sizeof( int ) ? sizeof( T ) : 2 * sizeof( int );
+
+	//                                                   sibling ptr           key          rid
+	static int leaf( const std::size_t pageSize ){ return ( pageSize - sizeof( PageId ) ) / ( sizeof( T ) + sizeof( RecordId ) ); }
+
+	//                                                      level, numKeys    extra pageNo           key         pageNo
+	static int nonLeaf( const std::size_t pageSize ){ return ( pageSize - NONLEAFHEADER - sizeof( PageId ) ) / ( sizeof( T ) + sizeof( PageId ) ); }
+
+	// Key slots of a NONLEAF_BUFFERED node: about the square root of the messages a page could hold, so
+	// that the buffer stays much larger than the fanout and a flush moves many messages to one child
+	static int bufferedNonLeaf( const std::size_t pageSize ){
+		//                             level, numKeys    extra pageNo    message count          key               rid
+		const int messages = ( pageSize - NONLEAFHEADER - sizeof( PageId ) - sizeof( int ) ) / ( sizeof( T ) + sizeof( RecordId ) );
+		int keys = 2;
+		while( ( keys + 1 ) * ( keys + 1 ) <= messages ) keys++;
+		return keys;
+	}
+
+	// Message slots of a NONLEAF_BUFFERED node, after bufferedNonLeaf() keys and their page numbers
+	static int nodeBuffer( const std::size_t pageSize ){
+		const int keys = bufferedNonLeaf( pageSize );
+		return ( pageSize - NONLEAFHEADER - keys * sizeof( T ) - ( keys + 1 ) * sizeof( PageId ) - sizeof( int ) ) / ( sizeof( T ) + sizeof( RecordId ) );
+	}
+
+	static int packedLeaf( const std::size_t pageSize );
+
+	// Key slots of a LEAF_APPEND leaf
+	//                                                         sibling ptr          LeafTail             key               rid
+	static int appendLeaf( const std::size_t pageSize ){ return ( pageSize - sizeof( PageId ) - 2 * sizeof( int ) ) / ( sizeof( T ) + sizeof( RecordId ) ); }
+};
+
+/**
+ * @brief One attribute of an index key: where it is in the record and its type.
+ */
+struct KeyAttr{
+  /**
+   * Offset of the attribute inside the record.
+   */
+	int attrByteOffset;
+
+  /**
+   * Type of the attribute.
+   */
+	Datatype attrType;
+};
+
+/**
+ * @brief One range of a multi-range scan. Passed to BTreeIndex::startMultiRangeScan() method.
+ * Values and operators have the same meaning as the arguments of BTreeIndex::startScan().
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+struct ScanRange{
+	const void* lowVal;
+	Operator lowOp;
+	const void* highVal;
+	Operator highOp;
+};
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -138,65 +293,293 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
+
+  /**
+   * Number of attributes in the key. 1 unless the index is built on a composite key.
+   */
+	int numKeyAttrs;
+
+  /**
+   * Offsets of the key attributes inside the record, in key order.
+   */
+	int keyAttrOffsets[ MAXKEYATTRS ];
+
+  /**
+   * Types of the key attributes, in key order.
+   */
+	Datatype keyAttrTypes[ MAXKEYATTRS ];
+
+  /**
+   * Order of the keys inside the non-leaf nodes of the tree.
+   */
+	NodeLayout nodeLayout;
+
+  /**
+   * Format of the leaf pages of the tree.
+   */
+	LeafFormat leafFormat;
+
+  /**
+   * Format of the non-leaf pages of the tree.
+   */
+	NonLeafFormat nonLeafFormat;
+
+  /**
+   * Number of pages reserved at once for leaves or non-leaf nodes, 1 to allocate them one by one.
+   */
+	int extentPages;
+
+  /**
+   * Next page of the extent reserved for leaves, equal to leafExtentEnd once it is used up.
+   */
+	PageId leafExtentNext;
+
+  /**
+   * Page after the extent reserved for leaves.
+   */
+	PageId leafExtentEnd;
+
+  /**
+   * Next page of the extent reserved for non-leaf nodes, equal to nodeExtentEnd once it is used up.
+   */
+	PageId nodeExtentNext;
+
+  /**
+   * Page after the extent reserved for non-leaf nodes.
+   */
+	PageId nodeExtentEnd;
 };
 
 /*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+Each node is a page. The number of slots in a node depends on the page size of the index file, so
+once we read the page in we lay one of these views over it and use it to access the parts.
 These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
 node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
 at this level are just above the leaf nodes. Otherwise set to 0.
 */
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all non-leaf nodes, templated for the key type.
+ * The level and key count come first, followed by capacity keys and capacity + 1 page numbers.
+ *
+ * In LAYOUT_SORTED the keys are sorted and pageNoArray[i] is the child left of keyArray[i].
+ * In LAYOUT_EYTZINGER keyArray[k-1] holds node k of an implicit binary search tree whose node k
+ * has children 2k and 2k+1, pageNoArray[k-1] is still the child left of that key and
+ * pageNoArray[numKeys] is the rightmost child. The first levels of the search tree share a few
+ * cache lines, so a search loads those and then one line per level with no unpredictable branch.
+ * In both layouts the slots after the last child are 0.
 */
-struct NonLeafNodeInt{
+template <class T>
+struct NonLeafNode{
+  /**
+   * @param page			Page holding the node
+   * @param capacity	Number of key slots, see NodeCapacity::nonLeaf()
+   */
+	NonLeafNode( Page *page, const int capacity )
+		: level( *(int *)page ),
+		  numKeys( *( (int *)page + 1 ) ),
+		  keyArray( (T *)( (char *)page + NodeCapacity<T>::NONLEAFHEADER ) ),
+		  pageNoArray( (PageId *)( keyArray + capacity ) ) {}
+
   /**
    * Level of the node in the tree.
    */
-	int level;
+	int &level;
+
+  /**
+   * Number of keys in the node. Only kept in LAYOUT_EYTZINGER, sorted nodes end at the first
+   * empty child slot.
+   */
+	int &numKeys;
 
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	T *keyArray;
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	PageId *pageNoArray;
 };
 
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Message buffer of a non-leaf node in NONLEAF_BUFFERED format, templated for the key type.
+ * It follows the page numbers of the node: a count, then capacity keys and capacity RecordIds of
+ * inserts that have not reached the leaves below the node yet, in arrival order. Every message
+ * belongs to one child of the node; when the buffer fills, the child with the most messages gets
+ * all of its messages in one batch, so each leaf write carries many inserts.
 */
-struct LeafNodeInt{
-  
+template <class T>
+struct NodeBuffer{
+  /**
+   * @param page					Page holding the node
+   * @param nodeCapacity	Number of key slots of the node, see NodeCapacity::bufferedNonLeaf()
+   * @param capacity			Number of message slots, see NodeCapacity::nodeBuffer()
+   */
+	NodeBuffer( Page *page, const int nodeCapacity, const int capacity )
+		: numMessages( *(int *)( NonLeafNode<T>( page, nodeCapacity ).pageNoArray + nodeCapacity + 1 ) ),
+		  keyArray( (T *)( &numMessages + 1 ) ),
+		  ridArray( (RecordId *)( keyArray + capacity ) ) {}
+
+  /**
+   * Number of messages in the buffer.
+   */
+	int &numMessages;
+
+  /**
+   * Stores keys of the messages.
+   */
+	T *keyArray;
+
+  /**
+   * Stores RecordIds of the messages.
+   */
+	RecordId *ridArray;
+};
+
+
+/**
+ * @brief Structure for all leaf nodes, templated for the key type.
+ * Capacity keys come first, followed by capacity RecordIds and the right sibling.
+*/
+template <class T>
+struct LeafNode{
+  /**
+   * @param node			Page holding the node, or memory holding an unpacked LEAF_PACKED leaf
+   * @param capacity	Number of key slots, see NodeCapacity::leaf()
+   */
+	LeafNode( void *node, const int capacity )
+		: keyArray( (T *)node ),
+		  ridArray( (RecordId *)( keyArray + capacity ) ),
+		  rightSibPageNo( *(PageId *)( ridArray + capacity ) ) {}
+
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	T *keyArray;
 
   /**
    * Stores RecordIds.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	RecordId *ridArray;
 
   /**
    * Page number of the leaf on the right side.
 	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+	PageId &rightSibPageNo;
+};
+
+/**
+ * @brief Trailer of a leaf page in LEAF_APPEND format, right after the right sibling of its LeafNode.
+ * Inserts go to the end of the entries without moving any, so the last numTail entries are in arrival
+ * order. They are sorted and merged into the others once LEAFTAILSIZE of them are there or before the
+ * leaf is read in key order; every entry moves at most once per merge instead of once per insert.
+*/
+struct LeafTail{
+  /**
+   * Number of entries in the leaf.
+   */
+	int numEntries;
+
+  /**
+   * Number of unsorted entries at the end of the leaf.
+   */
+	int numTail;
+};
+
+/**
+ * @brief Header of a leaf page in LEAF_PACKED format.
+ * Three columns follow it, each starting on a byte: the keys, the page numbers and the slot numbers
+ * of the RecordIds, in key order. Every value is stored as its difference from the smallest value of
+ * its column, in the fewest bits that hold the largest difference, so dense sequential keys and RIDs
+ * of neighbouring records take a few bits each. Packed leaves are unpacked into a LeafNode view to be
+ * read or changed and packed again when they are written.
+*/
+struct PackedLeafHeader{
+  /**
+   * Page number of the leaf on the right side.
    */
 	PageId rightSibPageNo;
+
+  /**
+   * Number of entries in the leaf.
+   */
+	int numEntries;
+
+  /**
+   * Smallest key of the leaf.
+   */
+	int keyBase;
+
+  /**
+   * Smallest page number of the RecordIds of the leaf.
+   */
+	PageId pageBase;
+
+  /**
+   * Smallest slot number of the RecordIds of the leaf.
+   */
+	SlotId slotBase;
+
+  /**
+   * Bits per value of the key, page number and slot number columns.
+   */
+	unsigned char keyBits;
+	unsigned char pageBits;
+	unsigned char slotBits;
 };
 
+/**
+ * @brief Number of entries of a packed leaf. A split leaves at most half of them in each leaf, and
+ * that many plus one always fit in a page even when no column packs at all.
+*/
+//                                                                       header              word read slack           key            page            slot
+template <class T>
+int NodeCapacity<T>::packedLeaf( const std::size_t pageSize ){ return 2 * ( ( pageSize - sizeof( PackedLeafHeader ) - 3 - sizeof( std::uint64_t ) ) / ( sizeof( int ) + sizeof( PageId ) + sizeof( SlotId ) ) - 1 ); }
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+*/
+typedef NonLeafNode<int> NonLeafNodeInt;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of INTEGER type.
+*/
+typedef LeafNode<int> LeafNodeInt;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is a COMPOSITE key.
+*/
+typedef NonLeafNode<CompositeKey> NonLeafNodeComposite;
+
+/**
+ * @brief Structure for all leaf nodes when the key is a COMPOSITE key.
+*/
+typedef LeafNode<CompositeKey> LeafNodeComposite;
+
+class LearnedIndex;
+class DeltaIndex;
 
 /**
  * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * relation, or on a composite key made of several INTEGER attributes.
+ * This index supports only one scan at a time.
 */
 class BTreeIndex {
 
+  /**
+   * Reads the leaves of an INTEGER index itself, see learnedindex.h.
+   */
+	friend class LearnedIndex;
+
+  /**
+   * Checks the key type of an index it takes inserts for, see deltaindex.h.
+   */
+	friend class DeltaIndex;
+
  private:
 
   /**
@@ -230,15 +613,40 @@ class BTreeIndex {
 	int 		attrByteOffset;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Attributes of the key, in key order. Holds more than one attribute for a composite index.
+   */
+	std::vector<KeyAttr> keyAttrs;
+
+  /**
+   * True if this object created the index file, rather than opening an existing one.
+   */
+	bool		newIndex;
+
+  /**
+   * Sorted runs of a bulk build of an INTEGER index, collected until the relation has been read.
+   */
+	std::vector<std::vector<RIDKeyPair<int> > > buildRunsInt;
+
+  /**
+   * Sorted runs of a bulk build of a COMPOSITE index, collected until the relation has been read.
+   */
+	std::vector<std::vector<RIDKeyPair<CompositeKey> > > buildRunsComposite;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key and the page size of the index file.
    */
 	int			leafOccupancy;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Number of keys in non-leaf node, depending upon the type of key and the page size of the index file.
    */
 	int			nodeOccupancy;
 
+  /**
+   * Number of messages in the buffer of a non-leaf node, 0 unless non-leaf nodes are NONLEAF_BUFFERED.
+   */
+	int			bufferOccupancy;
+
 
 	// MEMBERS SPECIFIC TO SCANNING
 
@@ -291,6 +699,16 @@ class BTreeIndex {
    * High STRING value for scan.
    */
 	std::string highValString;
+
+  /**
+   * Low COMPOSITE value for scan.
+   */
+	CompositeKey	lowValComposite;
+
+  /**
+   * High COMPOSITE value for scan.
+   */
+	CompositeKey	highValComposite;
 	
   /**
    * Low Operator. Can only be GT(>) or GTE(>=).
@@ -302,22 +720,162 @@ class BTreeIndex {
    */
 	Operator	highOp;
 
+  /**
+   * Maximum number of entries the current scan returns, or -1 if unbounded.
+   */
+	int			scanLimit;
+
+  /**
+   * Number of entries returned so far by the current scan.
+   */
+	int			scanCount;
+
+  /**
+   * Sorted, merged closed intervals of a multi-range scan, wide enough for either key type.
+   * Single range scans leave this empty.
+   */
+	std::vector< std::pair<long long, long long> > scanRanges;
+
+  /**
+   * Index in scanRanges of the range to scan once the current one is exhausted.
+   */
+	int			nextRange;
+
+  /**
+   * True if the current scan is a skip scan on the second attribute of a composite key.
+   */
+	bool		skipScan;
+
+  /**
+   * Whether the current skip scan seeks or walks. Never SKIP_AUTO while a scan runs.
+   */
+	SkipScanMode	skipScanMode;
+
+  /**
+   * Order of the keys inside non-leaf nodes, as recorded in the meta page.
+   */
+	NodeLayout	nodeLayout;
+
+  /**
+   * Format of leaf pages, as recorded in the meta page.
+   */
+	LeafFormat	leafFormat;
+
+  /**
+   * Format of non-leaf pages, as recorded in the meta page.
+   */
+	NonLeafFormat	nonLeafFormat;
+
+  /**
+   * The leaf being scanned, unpacked, when leaves are LEAF_PACKED.
+   */
+	std::vector<char> scanLeafBuffer;
+
+  /**
+   * Bytes of leaf entries moved to make room for inserts, including tail merges of LEAF_APPEND leaves.
+   */
+	mutable long long leafBytesMoved;
+
+  /**
+   * Number of times a scan went on to a right sibling that is not the next page of the file.
+   */
+	int			leafJumps;
+
+  /**
+   * Number of pages reserved at once for leaves or non-leaf nodes, as in the meta page.
+   */
+	int			extentPages;
+
+  /**
+   * True if the current scan merges buffered messages with the entries of the leaves.
+   */
+	bool		mergePending;
+
+  /**
+   * Buffered messages matching the current scan, sorted, when mergePending is set.
+   */
+	std::vector<RIDKeyPair<int> > pendingScan;
+
+  /**
+   * Index in pendingScan of the next message to return.
+   */
+	size_t	nextPending;
+
+  /**
+   * True if mergeLeafEntry holds the next leaf entry of a merging scan.
+   */
+	bool		mergeLookahead;
+
+  /**
+   * Next leaf entry of a merging scan, read ahead to be compared with the next message.
+   */
+	RIDKeyPair<int> mergeLeafEntry;
+
+  /**
+   * Limit of a merging scan, which counts messages and leaf entries together, or -1 if unbounded.
+   */
+	int			mergeLimit;
+
+  /**
+   * Number of entries returned so far by a merging scan.
+   */
+	int			mergeCount;
+
+  /**
+   * Low value, inclusive, of the second key attribute for a skip scan.
+   */
+	int			skipLowVal;
+
+  /**
+   * High value, inclusive, of the second key attribute for a skip scan.
+   */
+	int			skipHighVal;
+
 	
  public:
 
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * If not, create it and insert entries for every tuple in the base relation using FileScan class,
+	 * or, if buildThreads is positive, sort the entries of the relation on that many threads and
+	 * load them bottom up.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
+   * @param buildThreads				Number of threads of a bulk build of a new index, 0 to insert tuples one at a time
+   * @param pageSize						Page size of a new index file. An existing index keeps its own page size.
+   * @param leafFormat					Leaf format of a new index file. An existing index keeps its own format.
+   * @param nonLeafFormat				Non-leaf format of a new index file. An existing index keeps its own format.
+   * @throws  BadPageSizeException If a new index file cannot have pages of pageSize bytes
+   * @throws  BadIndexInfoException If leafFormat is LEAF_PACKED or nonLeafFormat is NONLEAF_BUFFERED and attrType is not INTEGER
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const int buildThreads = 0, const int pageSize = Page::SIZE,
+						const LeafFormat leafFormat = LEAF_PLAIN, const NonLeafFormat nonLeafFormat = NONLEAF_PLAIN);
+
+  /**
+   * BTreeIndex Constructor for an index on a composite key.
+	 * Works like the single attribute constructor; the key is made of the given attributes
+	 * compared lexicographically in the order given. The index name is the relation name
+	 * followed by the attribute offsets, e.g. "relA.0_8".
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param keyAttrs						Attributes of the key, in key order
+   * @param buildThreads				Number of threads of a bulk build of a new index, 0 to insert tuples one at a time
+   * @param pageSize						Page size of a new index file. An existing index keeps its own page size.
+   * @throws  BadIndexInfoException If there are more than MAXKEYATTRS attributes or any of them is not INTEGER
+   * @throws  BadPageSizeException If a new index file cannot have pages of pageSize bytes
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const std::vector<KeyAttr> &keyAttrs, const int buildThreads = 0,
+						const int pageSize = Page::SIZE);
 	
 
   /**
@@ -334,11 +892,90 @@ class BTreeIndex {
 	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
 	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
 	 * Make sure to unpin pages as soon as you can.
-   * @param key			Key to insert, pointer to integer/double/char string
+   * @param key			Key to insert, pointer to integer/double/char string, or to a CompositeKey for a composite index
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+	 * An index in LAYOUT_EYTZINGER is converted back to LAYOUT_SORTED first.
+	 * With NONLEAF_BUFFERED non-leaf nodes the entry is only added to the buffer of the root, and
+	 * reaches its leaf when the buffers on its path fill up; scans see it all along.
 	**/
 	void insertEntry(const void* key, const RecordId rid);
 
+  /**
+	 * Applies every insert still buffered in NONLEAF_BUFFERED non-leaf nodes to the leaves.
+	 * Does nothing for other indexes.
+	**/
+	void flushBuffers();
+
+  /**
+	 * Merges a batch of entries into the index in one pass over the leaves, instead of inserting
+	 * them one by one. Leaves whose key range gets entries are rewritten with their old and new
+	 * entries, filled as a bulk load fills them, and the others are not read. Entries above the
+	 * largest key are appended as new leaves at the right edge. The non-leaf levels are then
+	 * rebuilt over the leaves, reusing the old non-leaf pages, in the node layout the index had.
+   * @param keys		Keys of the entries, count of them of the key type of the index
+   * @param rids		Record IDs of the entries
+   * @param count		Number of entries; a batch in key order is merged without sorting it first
+	**/
+	void mergeSortedEntries(const void* keys, const RecordId* rids, const int count);
+
+  /**
+	 * Rewrites the index so that its leaves follow the meta page in key order, each holding
+	 * fillPercent of leafOccupancy entries, with the non-leaf levels rebuilt behind them in the
+	 * node layout the index had, and shrinks the file to the pages in use. Splits allocate leaves
+	 * at the end of the file, so after random inserts the right sibling of a leaf is anywhere in
+	 * it; afterwards it is the next page and scans read the file sequentially. The index stays open; a running scan is ended and
+	 * buffered inserts are flushed first. Every entry is held in memory meanwhile.
+   * @param fillPercent	Percentage of the entry slots of a leaf to fill, leaving the rest for inserts
+	**/
+	void defragment(const int fillPercent = 100);
+
+  /**
+	 * Rewrites every non-leaf node of the tree in the given key order and records it in the meta
+	 * page, where it stays when the index is opened again. LAYOUT_EYTZINGER makes descents from
+	 * the root cheaper for indexes that are loaded once and then mostly read.
+   * @param layout	New order of the keys inside non-leaf nodes
+	**/
+	void setNodeLayout(const NodeLayout layout);
+
+  /**
+	 * Returns the order of the keys inside non-leaf nodes.
+	**/
+	NodeLayout getNodeLayout() const { return nodeLayout; }
+
+  /**
+	 * Returns the format of non-leaf pages.
+	**/
+	NonLeafFormat getNonLeafFormat() const { return nonLeafFormat; }
+
+  /**
+	 * Returns the format of leaf pages.
+	**/
+	LeafFormat getLeafFormat() const { return leafFormat; }
+
+  /**
+	 * Returns the number of bytes of leaf entries moved by inserts and tail merges since the index was opened.
+	**/
+	long long getLeafBytesMoved() const { return leafBytesMoved; }
+
+  /**
+	 * Returns the number of times scans went on to a right sibling that is not the next page of
+	 * the file since the index was opened. Each of them is a seek for a scan of a cold index.
+	**/
+	int getLeafJumps() const { return leafJumps; }
+
+  /**
+	 * Sets the number of pages reserved at once for leaves, and for non-leaf nodes, from now on and
+	 * records it in the meta page. New index files start with EXTENTPAGES. Pages already reserved
+	 * are handed out first.
+   * @param pages		Pages per extent, 1 to allocate pages one by one
+	**/
+	void setExtentPages(const int pages);
+
+  /**
+	 * Returns the number of pages reserved at once for leaves, and for non-leaf nodes.
+	**/
+	int getExtentPages() const { return extentPages; }
+
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
 	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
@@ -346,15 +983,58 @@ class BTreeIndex {
 	 * If another scan is already executing, that needs to be ended here.
 	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
 	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+	 * If a limit is given the scan completes after that many entries and the pinned leaf
+	 * is released as soon as the last one is returned, without waiting for endScan.
    * @param lowVal	Low value of range, pointer to integer / double / char string
    * @param lowOp		Low operator (GT/GTE)
    * @param highVal	High value of range, pointer to integer / double / char string
    * @param highOp	High operator (LT/LTE)
+   * @param limit		Maximum number of entries to return, -1 for no limit
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
    * @throws  BadScanrangeException If lowVal > highval
 	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
 	**/
-	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const int limit = -1);
+
+  /**
+	 * Begin a scan of all entries of a composite index whose leading attribute equals the
+	 * given value, e.g. every timestamp of one tenant. On a single attribute index this is
+	 * an equality scan.
+   * @param prefixVal	Value of the leading key attribute, pointer to integer
+   * @param limit			Maximum number of entries to return, -1 for no limit
+	**/
+	void startPrefixScan(const void* prefixVal, const int limit = -1);
+
+  /**
+	 * Begin a skip scan of a composite index: a scan constraining only the second key attribute,
+	 * whatever the leading attribute. In SKIP_SEEK mode the scan descends from the root once per
+	 * distinct leading value, with the lowest key of that value in the range, and skips the leaves
+	 * in between. In SKIP_WALK mode it reads every leaf and filters on the second attribute, which
+	 * is cheaper when there are about as many distinct leading values as leaves. SKIP_AUTO chooses
+	 * from the separator keys of the root. Entries are returned through scanNext().
+   * @param lowVal	Low value of the second attribute, pointer to integer
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of the second attribute, pointer to integer
+   * @param highOp	High operator (LT/LTE)
+   * @param mode		How the scan finds its entries
+   * @throws  BadScanParamException If the index is not on a composite key
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	void startSkipScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+						const SkipScanMode mode = SKIP_AUTO);
+
+  /**
+	 * Begin a scan over several ranges of the index, e.g. for IN-lists. Ranges are sorted
+	 * and merged, then visited in key order in a single pass: the scan only descends from
+	 * the root again when the next range does not start in the current leaf or its right sibling.
+	 * Entries are returned through scanNext() and the scan is ended with endScan() as usual.
+   * @param ranges	Ranges to scan, in any order, possibly overlapping
+   * @param limit		Maximum number of entries to return, -1 for no limit
+   * @throws  BadOpcodesException If a range does not use GT/GTE and LT/LTE operators
+   * @throws  BadScanrangeException If the low value of a range is greater than its high value
+	**/
+	void startMultiRangeScan(const std::vector<ScanRange> &ranges, const int limit = -1);
 
   /**
 	 * Fetch the record id of the next index entry that matches the scan.
@@ -365,22 +1045,297 @@ class BTreeIndex {
 	**/
 	void scanNext(RecordId& outRid);  // returned record id
 
+  /**
+	 * Fetch the key and record id of the next index entry that matches the scan. The key is
+	 * copied straight from the leaf, so index-only queries (key ranges, DISTINCT keys) never
+	 * have to read the base relation.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey	Key of that entry returned in this, pointer to integer, or to a CompositeKey for a composite index
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	void scanNext(RecordId& outRid, void* outKey);
+
 
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
 	void endScan();
+
+  /**
+	 * Packs INTEGER attribute values into a normalized composite key. The leading attribute
+	 * fills the high bits and keeps its sign; later attributes are biased to unsigned so that
+	 * integer order of the result is lexicographic order of the values. Missing trailing
+	 * attributes take their smallest value, so a prefix gives the lowest key starting with it.
+   * @param attrVals	Values of the key attributes, in key order
+   * @param numAttrs	Number of values given, at most MAXKEYATTRS
+   * @return normalized key
+	**/
+	static CompositeKey makeCompositeKey(const int *attrVals, const int numAttrs);
+
+  /**
+	 * Unpacks a normalized composite key made by makeCompositeKey() into its attribute values.
+   * @param key				normalized key
+   * @param attrVals	Returns the MAXKEYATTRS attribute values, in key order
+	**/
+	static void splitCompositeKey(const CompositeKey key, int *attrVals);
+
+  /**
+	 * Builds several indexes on one relation while reading the relation only once. Every batch of
+	 * relation pages is sorted into runs for all the new indexes at the same time, then each index
+	 * is bulk loaded. Indexes whose file already exists are left as they are. Open the indexes with
+	 * the constructors afterwards.
+   * @param relationName        Name of file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param indexKeys						Key attributes of each index, in key order
+   * @param outIndexNames				Return the names of the index files, in the order of indexKeys
+   * @param buildThreads				Number of threads sorting runs for each index
+   * @param pageSize						Page size of the new index files
+   * @throws  BadIndexInfoException If a key has more than MAXKEYATTRS attributes or any of them is not INTEGER
+   * @throws  BadPageSizeException If the index files cannot have pages of pageSize bytes
+	**/
+	static void buildIndexes(const std::string & relationName, BufMgr *bufMgrIn,
+						const std::vector<std::vector<KeyAttr> > &indexKeys, std::vector<std::string> &outIndexNames,
+						const int buildThreads = 1, const int pageSize = Page::SIZE);
   
   private: 
 
+  /**
+   * Constructor used by buildIndexes(), which opens the index itself.
+   * @param bufMgrIn						Buffer Manager Instance
+   */
+	BTreeIndex(BufMgr *bufMgrIn);
+
+  /**
+   * Checks that the attributes can form a key.
+   * @param keyAttrs						Attributes of the key, in key order
+   * @throws  BadIndexInfoException If there are more than MAXKEYATTRS attributes or any of them is not INTEGER
+   */
+	static void checkKeyAttrs(const std::vector<KeyAttr> &keyAttrs);
+
+  /**
+   * Opens the index file on the given key attributes, or creates it and inserts an entry for
+   * every tuple of the relation if it does not exist yet. Shared by the constructors.
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param attrs								Attributes of the key, in key order
+   * @param buildThreads				Number of threads of a bulk build, 0 to insert tuples one at a time, DEFERREDBUILD to leave a new index empty
+   * @param pageSize						Page size of the index file if it is created
+   * @param newLeafFormat				Leaf format of the index file if it is created
+   * @param newNonLeafFormat		Non-leaf format of the index file if it is created
+   */
+  void openIndex(const std::string & relationName, std::string & outIndexName, const std::vector<KeyAttr> &attrs,
+								 const int buildThreads, const int pageSize, const LeafFormat newLeafFormat,
+								 const NonLeafFormat newNonLeafFormat);
+
+  /**
+   * Sets leafOccupancy, nodeOccupancy and bufferOccupancy from the key type, the node formats and the page size of the index file.
+   */
+  void setOccupancy();
+
+  /**
+   * True if the index is built on a composite key, so nodes hold CompositeKey keys.
+   */
+  bool isComposite() const { return keyAttrs.size() > 1; }
+
+  /**
+   * Builds the normalized composite key of a record of the base relation
+   * @param record  record data
+   */
+  CompositeKey getCompositeKey(const char *record) const;
+
+  /**
+   * Extracts the key of a record of the base relation, INTEGER version
+   */
+  void getRecordKey(const char *record, int &key) const { key = *(int *)(record + attrByteOffset); }
+
+  /**
+   * Extracts the key of a record of the base relation, COMPOSITE version
+   */
+  void getRecordKey(const char *record, CompositeKey &key) const { key = getCompositeKey(record); }
+
+  /**
+   * Reads the relation in batches of BUILDBATCHBYTES through the buffer manager and
+   * has each of the indexes sort every batch into runs. Indexes work on a batch concurrently.
+   * @param relationName	Name of the relation
+   * @param bufMgrIn			Buffer Manager Instance
+   * @param indexes				New, empty indexes on the relation
+   * @param numThreads		Number of threads sorting runs for each index
+   */
+  static void readBuildBatches(const std::string & relationName, BufMgr *bufMgrIn,
+						const std::vector<BTreeIndex*> &indexes, const int numThreads);
+
+  /**
+   * Sorts a batch of relation pages into runs of this index's key type.
+   * @param batch				Pages of the relation, back to back
+   * @param pageSize		Page size of the relation
+   * @param numThreads	Number of threads
+   */
+  void addBuildBatch(std::vector<char> &batch, const size_t pageSize, const int numThreads);
+
+  /**
+   * Bulk loads the runs collected by addBuildBatch into the new, empty index.
+   */
+  void finishBuild();
+
+  /**
+   * Cuts a batch of relation pages into numThreads slices and appends one sorted run per slice,
+   * extracting and sorting the slices in parallel.
+   * @param batch				Pages of the relation, back to back
+   * @param pageSize		Page size of the relation
+   * @param numThreads	Number of threads
+   * @param runs				Sorted runs, appended to
+   */
+  template <class T>
+  void sortRuns(std::vector<char> &batch, const size_t pageSize, const int numThreads, std::vector<std::vector<RIDKeyPair<T> > > &runs) const;
+
+  /**
+   * Extracts the entries of pages [begin, end) of a batch and sorts them. Touches nothing shared,
+   * so several of these run at once.
+   * @param batch				Pages of the relation, back to back
+   * @param pageSize		Page size of the relation
+   * @param begin				First page of the slice
+   * @param end					Page after the last page of the slice
+   * @param run					Returns the sorted entries
+   */
+  template <class T>
+  void extractRun(std::vector<char> &batch, const size_t pageSize, const size_t begin, const size_t end, std::vector<RIDKeyPair<T> > &run) const;
+
+  /**
+   * Merges sorted runs into full leaves, starting at the empty root, then builds the levels of
+   * non-leaf nodes above them and points the meta page at the new root.
+   * @param runs	Sorted runs, emptied as they are merged
+   */
+  template <class T>
+  void bulkLoad(std::vector<std::vector<RIDKeyPair<T> > > &runs);
+
+  /**
+   * Builds the levels of non-leaf nodes over a level of nodes until one node is left, and points
+   * the meta page at it.
+   * @param children	Page number and smallest key of every node of the bottom level, in key order
+   * @param freePages	Pages to use for the new nodes before allocating new ones
+   */
+  template <class T>
+  void buildNonLeafLevels(std::vector<PageKeyPair<T> > &children, std::vector<PageId> &freePages);
+
+  /**
+   * Merges a sorted batch into the leaves and rebuilds the non-leaf levels above them.
+   * @param batch		Entries in key order
+   */
+  template <class T>
+  void mergeSorted(const std::vector<RIDKeyPair<T> > &batch);
+
+  /**
+   * Appends the leaves below a non-leaf node to leaves, with the smallest key each may hold, and
+   * the node and the non-leaf nodes below it to nodePages.
+   * @param pageNo		Page number of the node
+   * @param low				Smallest key the node may hold
+   * @param leaves		Leaves found so far, in key order
+   * @param nodePages	Non-leaf pages found so far
+   */
+  template <class T>
+  void collectLeaves(PageId pageNo, const T low, std::vector<PageKeyPair<T> > &leaves, std::vector<PageId> &nodePages);
+
+  /**
+   * Writes sorted entries into as few leaves of at most leafFill entries as fit them, the first
+   * on a page that is already a leaf, the others on freePages and then on new pages, and links
+   * the last one to a sibling.
+   * @param entries		Entries in key order
+   * @param first			Page of the first leaf, with the smallest key it may hold
+   * @param sibPageNo	Right sibling of the last leaf
+   * @param children	Page number and smallest key of every leaf written appended to this
+   * @param freePages	Pages to use for the leaves after the first, taken from the back
+   * @param leafFill	Maximum number of entries of a leaf
+   */
+  template <class T>
+  void writeLeaves(const std::vector<RIDKeyPair<T> > &entries, const PageKeyPair<T> &first, const PageId sibPageNo,
+									 std::vector<PageKeyPair<T> > &children, std::vector<PageId> &freePages, const int leafFill);
+
+  /**
+   * Allocates the page of a new node from the extent reserved for its kind of node, reserving the
+   * next extent at the end of the file once it is used up. The page is pinned.
+   * @param leaf		True for a leaf, false for a non-leaf node
+   * @param pageNo	Page number of the page returned in this
+   * @param page		Page returned in this
+   */
+  void allocNodePage(const bool leaf, PageId &pageNo, Page *&page);
+
+  /**
+   * Rewrites the leaves in key order after the meta page and the non-leaf levels behind them, and
+   * shrinks the file, see defragment().
+   * @param fillPercent	Percentage of the entry slots of a leaf to fill
+   */
+  template <class T>
+  void defragmentTree(const int fillPercent);
+
+  /**
+   * Inserts a key of the tree's key type, splitting the root if needed
+   * @param key   key to insert
+   * @param rid   RecordId of a record whose entry is getting inserted into the index.
+   */
+  template <class T>
+  void insertKey(const T key, const RecordId rid);
+
     /** 
    * Recursively finds Leaf Node where the key should be inserted and calls insertToLeaf
    * @param key   key to insert, pointer to integer/double/char string 
    * @param pageNo Page number of node being checked for insertion  
    * @param rid   RecordId of a record whose entry is getting inserted into the index.
    */
-  void insertLeafHelper(const void *key, PageId pageNo, const RecordId rid);
+  template <class T>
+  void insertLeafHelper(const T key, PageId pageNo, const RecordId rid);
+
+  /**
+   * Adds an insert to the buffer of the non-leaf node of the given level on the path of the key,
+   * flushing that buffer if it fills up.
+   * @param key			Key of the entry
+   * @param rid			Record ID of the entry
+   * @param level		Level of the node, the level of the root for a new insert
+   */
+  template <class T>
+  void bufferInsert(const T key, const RecordId rid, const int level);
+
+  /**
+   * Moves the messages of the child taking the most of them out of the buffer of a non-leaf node:
+   * into the leaves in key order below level 1, into the buffer of the child above it.
+   * @param pageNo	Page number of the node
+   */
+  template <class T>
+  void flushBuffer(PageId pageNo);
+
+  /**
+   * Returns the first node in preorder below pageNo, itself included, with buffered messages, or 0.
+   * @param pageNo	Page number of a non-leaf node
+   */
+  template <class T>
+  PageId findBufferedNode(PageId pageNo);
+
+  /**
+   * Adds the buffered messages of the current scan to pendingScan, from the node at pageNo and
+   * every node below it whose keys overlap [low, high].
+   * @param pageNo	Page number of a non-leaf node
+   * @param low			Smallest key the scan can return
+   * @param high		Largest key the scan can return
+   */
+  void collectPending(PageId pageNo, const int low, const int high);
+
+  /**
+   * Sets up the merge of buffered messages into a scan just started, if there are any in [low, high].
+   * @param low			Smallest key the scan can return
+   * @param high		Largest key the scan can return
+   */
+  void startPendingMerge(const int low, const int high);
+
+  /**
+   * Returns true if a key lies in the range or ranges of the current scan.
+   */
+  bool matchesScan(const int key) const;
+
+  /**
+   * Returns the smaller of the next leaf entry and the next buffered message of a merging scan.
+   */
+  void scanNextMerged(RecordId& outRid, int* outKey);
 
   /**
    * Finds the index where the key should be inserted into leaf node and inserts it 
@@ -389,7 +1344,8 @@ class BTreeIndex {
    * @param pageNo Page number of leaf node where key will be inserted 
    * @return PageKeyPair of new node if the leaf was full and was split 
    **/
-  PageKeyPair<int> insertToLeaf(const void *key, const RecordId rid, PageId pageNo);
+  template <class T>
+  PageKeyPair<T> insertToLeaf(const T key, const RecordId rid, PageId pageNo);
   
   /** 
    * Inserts a node into an internal leaf 
@@ -397,7 +1353,8 @@ class BTreeIndex {
    * @param pageNo    pageNumber of node to be inserted 
    * @param level     level of the node to be inserted 
    */
-  void insertToNonLeaf(PageKeyPair<int> pageKey, PageId pageNo);
+  template <class T>
+  void insertToNonLeaf(PageKeyPair<T> pageKey, PageId pageNo);
   
   /**
    * Finds the parent node of pageKey's pageNo at a specified level 
@@ -405,20 +1362,23 @@ class BTreeIndex {
    * @param pageNo the number of the page being checked 
    * @param level the level of the parent node being located 
    */
-  PageId findParentNode(PageKeyPair<int> pageKey, PageId pageNo, int level); 
+  template <class T>
+  PageId findParentNode(PageKeyPair<T> pageKey, PageId pageNo, int level); 
   
   /**
    * Creates a new root node with the previous root and a new root as children 
    * @param pageKey the new node and key 
    */
-  void updateRootNode(PageKeyPair<int> pageKey); 
+  template <class T>
+  void updateRootNode(PageKeyPair<T> pageKey); 
 
   /**
    * Splits an internal node and inserts child node that 
    * @param pageNo Page number of node bing split 
    * @param newPageKey child node that failed to be inserted into full array 
    */
-  PageKeyPair<int> splitNonLeaf(PageId pageNo, PageKeyPair<int> newPageKey); 
+  template <class T>
+  PageKeyPair<T> splitNonLeaf(PageId pageNo, PageKeyPair<T> newPageKey); 
 
    /**
    * Splits the node into two separate nodes and returns the page number and 
@@ -426,26 +1386,187 @@ class BTreeIndex {
    * @param pageNo page number of node to be split 
    * @return PageKeyPair containing page number and key of the new node 
    */  
-  PageKeyPair<int> splitLeaf(PageId pageNo);
+  template <class T>
+  PageKeyPair<T> splitLeaf(PageId pageNo);
 
   /**
    * recursively calls itself to find the leaf node containing the first record being 
    * scanned for
    * @param pageNo node being checked 
    */
+  template <class T>
   void scanHelper(PageId pageNo);
 
+  /**
+   * Returns a view of a leaf. LEAF_PLAIN leaves are used in place; LEAF_PACKED leaves are
+   * unpacked into buffer and have to be written back with storeLeaf() after a change.
+   * LEAF_APPEND leaves are used in place, with their tail merged in first.
+   * @param page		Page holding the leaf
+   * @param buffer	Memory for an unpacked leaf
+   * @param unpack	False for a new page, whose view starts empty
+   */
+  template <class T>
+  LeafNode<T> leafView(Page *page, std::vector<char> &buffer, const bool unpack = true) const;
+
+  /**
+   * Writes a leaf changed through a view from leafView() back to its page.
+   * @param node	view of the leaf
+   * @param page	Page holding the leaf
+   */
+  template <class T>
+  void storeLeaf(const LeafNode<T> &node, Page *page) const;
+
+  /**
+   * Returns the trailer of a LEAF_APPEND leaf.
+   * @param node	View of the leaf on its page
+   */
+  template <class T>
+  static LeafTail &leafTail(const LeafNode<T> &node) { return *(LeafTail *)( &node.rightSibPageNo + 1 ); }
+
+  /**
+   * Sorts the tail of a LEAF_APPEND leaf and merges it into the sorted entries, from the back.
+   * The entries stay the same, so the page does not have to be written back for this.
+   * @param node	View of the leaf on its page
+   */
+  template <class T>
+  void mergeLeafTail(const LeafNode<T> &node) const;
+
+  /**
+   * True if the first n entries of a leaf and one more entry fit in a LEAF_PACKED page.
+   */
+  template <class T>
+  bool packedLeafFits(const LeafNode<T> &node, const int n, const T key, const RecordId rid) const;
+
+  /**
+   * Pins a leaf as the current page of the scan, unpacking it if leaves are LEAF_PACKED and merging
+   * its tail if they are LEAF_APPEND.
+   * @param pageNo	leaf to scan
+   */
+  template <class T>
+  void readScanLeaf(PageId pageNo);
+
+  /**
+   * Returns a view of the leaf pinned by readScanLeaf().
+   */
+  template <class T>
+  LeafNode<T> scanLeaf();
+
+  /**
+   * Finds the child of a non-leaf node that holds the keys equal to key, in either layout
+   * @param node	non-leaf node
+   * @param key		key searched for
+   * @return page number of the child
+   */
+  template <class T>
+  PageId findChildPage(const NonLeafNode<T> &node, const T key) const;
+
+  /**
+   * Reads the keys and children of a non-leaf node in sorted order, whatever its layout
+   * @param node			non-leaf node
+   * @param keys			Returns the keys of the node
+   * @param pageNos		Returns the children of the node, one more than keys
+   */
+  template <class T>
+  void getNodeEntries(const NonLeafNode<T> &node, std::vector<T> &keys, std::vector<PageId> &pageNos) const;
+
+  /**
+   * Rewrites a non-leaf node and the non-leaf nodes under it from nodeLayout into the given layout
+   * @param pageNo	node to rewrite
+   * @param layout	new layout
+   */
+  template <class T>
+  void relayoutNode(PageId pageNo, const NodeLayout layout);
+
+  /**
+   * Pins the leaf containing the first entry that satisfies the current low value
+   * and sets nextEntry to it.
+   */
+  template <class T>
+  void seekScanLeaf();
+
+  /**
+   * Finds the first entry of a leaf at or after start that satisfies the current low value
+   * @param node  leaf being scanned
+   * @param start index to start searching from
+   * @return index of the entry, or the index of the first empty slot if there is none
+   */
+  template <class T>
+  int findScanEntry(const LeafNode<T> &node, int start);
+
+  /**
+   * Moves a multi-range scan on to its next range, staying in the current leaf or its
+   * right sibling when possible and descending from the root otherwise
+   * @return false if there are no more ranges that can match
+   */
+  template <class T>
+  bool advanceScanRange();
+
+  /**
+   * Fetches the next entry of the current scan from leaves of the tree's key type
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey	Key of that entry returned in this, unless NULL
+   */
+  template <class T>
+  void scanNextEntry(RecordId& outRid, T* outKey);
+
+  /**
+   * Sorts and merges the ranges of a multi-range scan into scanRanges
+   * @param ranges	Ranges given to startMultiRangeScan
+   * @throws  BadScanrangeException If the low value of a range is greater than its high value
+   */
+  template <class T>
+  void setScanRanges(const std::vector<ScanRange> &ranges);
+
+  /**
+   * Picks SKIP_SEEK or SKIP_WALK for a skip scan. Reads the root: if the leading attribute
+   * changes between at least half of its children, there are about as many distinct leading
+   * values as subtrees and seeking would skip next to nothing.
+   */
+  SkipScanMode chooseSkipScanMode();
+
+  /**
+   * Sets the current range of a skip scan to the next leading attribute value that can hold
+   * matches, given the first key past the current range.
+   * @param key	first key after the current range
+   * @return false if no leading value is left
+   */
+  bool nextSkipRange(CompositeKey key);
+
+  /**
+   * Sets the low and high values of the current scan range for the tree's key type.
+   * The operators are GTE and LTE.
+   */
+  void setScanBounds(long long low, long long high);
+
+  /**
+   * Returns the low and high values of the current scan range, INTEGER version
+   */
+  void getScanBounds(int &low, int &high) const { low = lowValInt; high = highValInt; }
+
+  /**
+   * Returns the low and high values of the current scan range, COMPOSITE version
+   */
+  void getScanBounds(CompositeKey &low, CompositeKey &high) const { low = lowValComposite; high = highValComposite; }
+
+  /**
+   * Unpins the leaf currently held by the scan, if any. Called once the scan is
+   * exhausted or has reached its limit so the page does not stay pinned until endScan.
+   */
+  void releaseScanPage();
+
   /**
    * Prints the entire BTree starting from the specified page 
    * @param pageNo page number of node to start printing 
    * @param leaf true if the starting page is a leaf node 
    **/
+  template <class T>
   void printTree(PageId pageNo, bool leaf); 
 
   /**
    * Prints the keys of a leaf Node 
    * @param pageNo Page Number of Leaf Node 
    * */
+  template <class T>
   void printNode(PageId pageNo); 
 	
 };
@@ -7,12 +7,17 @@
 
 #include <memory>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <cstring>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 
 namespace badgerdb { 
 
@@ -21,21 +26,34 @@ namespace badgerdb {
 //----------------------------------------
 
 BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+	: numBufs(0), numReads(0) {
+  // every pool gets the bytes of bufs frames of the default page size
+  const std::size_t capacity = (std::size_t)bufs * Page::SIZE;
+  const std::uint32_t minFrames = std::min(bufs, MINPOOLFRAMES);
+  for (std::size_t frameSize = Page::MIN_SIZE; frameSize <= Page::MAX_SIZE; frameSize *= 2)
+  {
+    FramePool pool;
+    pool.frameSize = frameSize;
+    pool.firstFrame = numBufs;
+    pool.numFrames = std::max((std::uint32_t)(capacity / frameSize), minFrames);
+    pool.clockHand = pool.firstFrame + pool.numFrames - 1;
+    pool.memory = NULL;
+    pools.push_back(pool);
+    numBufs += pool.numFrames;
+  }
+
+	bufDescTable = new BufDesc[numBufs];
 
-  for (FrameId i = 0; i < bufs; i++) 
+  for (FrameId i = 0; i < numBufs; i++) 
   {
   	bufDescTable[i].frameNo = i;
   	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  bufPool.assign(numBufs, NULL);
 
   int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
   hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
-
-  clockHand = bufs - 1;
 }
 
 
@@ -46,16 +64,40 @@ BufMgr::~BufMgr() {
   	BufDesc* tmpbuf = &(bufDescTable[i]);
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			tmpbuf->file->writePage(tmpbuf->pageNo, *bufPool[i]);
   	}
   }
 
 	delete hashTable;
   delete [] bufDescTable;
-  delete [] bufPool;
+  for (std::size_t i = 0; i < pools.size(); i++)
+  {
+    delete [] pools[i].memory;
+  }
+}
+
+FramePool & BufMgr::poolFor(const File* file)
+{
+  // smallest frames that hold a page of the file
+  std::size_t p = 0;
+  while (pools[p].frameSize < file->pageSize())
+  {
+    p++;
+  }
+
+  FramePool & pool = pools[p];
+  if (pool.memory == NULL)
+  {
+    pool.memory = new char[pool.numFrames * pool.frameSize];
+    for (std::uint32_t i = 0; i < pool.numFrames; i++)
+    {
+      bufPool[pool.firstFrame + i] = reinterpret_cast<Page*>(pool.memory + i * pool.frameSize);
+    }
+  }
+  return pool;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::allocBuf(FramePool & pool, FrameId & frame) 
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
@@ -63,27 +105,27 @@ void BufMgr::allocBuf(FrameId & frame)
   std::uint32_t numScanned = 0;
   bool found = 0;
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  while (numScanned < 2*pool.numFrames)	//Need to scn twice
   {
     // advance the clock
-    advanceClock();
+    advanceClock(pool);
     numScanned++;
 
     // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    if (! bufDescTable[pool.clockHand].valid)
     {
       break;
     }
 
     // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    if (! bufDescTable[pool.clockHand].refbit)
     {
       // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      if (bufDescTable[pool.clockHand].pinCnt == 0)
       {
         // hasn't been referenced and is not pinned, use it
         // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
+        hashTable->remove(bufDescTable[pool.clockHand].file, bufDescTable[pool.clockHand].pageNo);
         found = true;
         break;
       }
@@ -92,29 +134,29 @@ void BufMgr::allocBuf(FrameId & frame)
     {
       // has been referenced, clear the bit
       bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      bufDescTable[pool.clockHand].refbit = false;
     }
   }
   
   // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  if (!found && numScanned >= 2*pool.numFrames)
   {
     throw BufferExceededException();
   }
   
   // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+  if (bufDescTable[pool.clockHand].dirty)
   {
     bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    //status = bufDescTable[pool.clockHand].file->writePage(bufDescTable[pool.clockHand].pageNo,
+    bufDescTable[pool.clockHand].file->writePage(bufDescTable[pool.clockHand].pageNo, *bufPool[pool.clockHand]);
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  bufDescTable[pool.clockHand].Clear();
 
   // return new frame number
-  frame = clockHand;
+  frame = pool.clockHand;
 } // end allocBuf
 
 	
@@ -122,6 +164,7 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
+  const std::uint64_t readNo = numReads++;
   FrameId frameNo = 0;
 	try
 	{
@@ -130,21 +173,31 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
     // set the referenced bit
     bufDescTable[frameNo].refbit = true;
     bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+    page = bufPool[frameNo];
   }
   catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
   {
     // alloc a new frame
-    allocBuf(frameNo);
+    allocBuf(poolFor(file), frameNo);
 
     // read the page into the new frame
     bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    std::map<std::pair<const File*, PageId>, std::uint64_t>::iterator advice =
+      prefetchedPages.find(std::make_pair((const File*)file, pageNo));
+    if (advice != prefetchedPages.end())
+    {
+      // advice given right before the read saved it nothing
+      if (advice->second < readNo)
+      {
+        bufStats.prefetchhits++;
+      }
+      prefetchedPages.erase(advice);
+    }
+    file->readPageInto(pageNo, bufPool[frameNo]);
 
     // set up the entry properly
     bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+    page = bufPool[frameNo];
 
     // insert in the hash table
     hashTable->insert(file, pageNo, frameNo);
@@ -152,6 +205,30 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 }
 
 
+void BufMgr::prefetchPage(File* file, const PageId pageNo)
+{
+  FrameId frameNo = 0;
+	try
+	{
+  	hashTable->lookup(file, pageNo, frameNo);
+
+    // already present, just keep it from being the next victim
+    bufDescTable[frameNo].refbit = true;
+    return;
+  }
+  catch(const HashNotFoundException &e)
+  {
+  }
+
+  // the read happens in the background; readPage waits for what is left of it
+  if (prefetchedPages.insert(std::make_pair(std::make_pair((const File*)file, pageNo), numReads)).second)
+  {
+    bufStats.prefetches++;
+    file->adviseWillNeed(pageNo);
+  }
+}
+
+
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
   // lookup in hashtable
@@ -173,12 +250,83 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
   FrameId frameNo;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  allocBuf(poolFor(file), frameNo);
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  // allocate a new page in the file; the frame only holds the bytes the file stores
+  const Page newPage = file->allocatePage(pageNo);
+  memcpy(bufPool[frameNo], &newPage, file->pageSize());
+  page = bufPool[frameNo];
+
+  // set up the entry properly
+  bufDescTable[frameNo].Set(file, pageNo);
+
+  // insert in the hash table
+  hashTable->insert(file, pageNo, frameNo);
+}
+
+RecordId BufMgr::insertRecord(PageFile* file, const std::string& record)
+{
+  const std::size_t dataBytes = file->pageSize() - sizeof(PageHeader);
+  const std::size_t recordBytes = record.length() + sizeof(PageSlot);
+  if (recordBytes > dataBytes)
+  {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, record.length(), dataBytes);
+  }
+
+  Page* page;
+  PageId pageNo = file->findPageWithSpace(recordBytes);
+  while (pageNo != Page::INVALID_NUMBER)
+  {
+    readPage(file, pageNo, page);
+    if (page->hasSpaceForRecord(record))
+    {
+      break;
+    }
+    // The page was filled in the pool without going through the map; note its
+    // real free space so the search below moves on to another page
+    file->updateFreeSpace(pageNo, *page);
+    unPinPage(file, pageNo, false);
+    pageNo = file->findPageWithSpace(recordBytes);
+  }
+  if (pageNo == Page::INVALID_NUMBER)
+  {
+    allocPage(file, pageNo, page);
+  }
+
+  const RecordId rid = page->insertRecord(record);
+  file->updateFreeSpace(pageNo, *page);
+  unPinPage(file, pageNo, true);
+  return rid;
+}
+
+void BufMgr::deleteRecord(PageFile* file, const RecordId& rid)
+{
+  Page* page;
+  readPage(file, rid.page_number, page);
+  try
+  {
+    page->deleteRecord(rid);
+  }
+  catch (const BadgerDbException& e)
+  {
+    unPinPage(file, rid.page_number, false);
+    throw;
+  }
+  file->updateFreeSpace(rid.page_number, *page);
+  unPinPage(file, rid.page_number, true);
+}
+
+void BufMgr::allocPageAt(File* file, const PageId pageNo, Page*& page)
+{
+  FrameId frameNo;
+
+  // alloc a new frame
+  allocBuf(poolFor(file), frameNo);
+
+  // the page is empty on disk, so it is not read
+  const Page emptyPage;
+  memcpy(bufPool[frameNo], &emptyPage, file->pageSize());
+  page = bufPool[frameNo];
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
@@ -200,7 +348,7 @@ void BufMgr::flushFile(const File* file)
 	    if (tmpbuf->dirty == true)
 			{
 				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+				tmpbuf->file->writePage(tmpbuf->pageNo, *bufPool[i]);
 				tmpbuf->dirty = false;
     	}
 
@@ -210,6 +358,14 @@ void BufMgr::flushFile(const File* file)
 		else if (tmpbuf->valid == false && tmpbuf->file == file)
   		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
   }
+
+  // pages asked for and never read
+  std::map<std::pair<const File*, PageId>, std::uint64_t>::iterator first =
+    prefetchedPages.lower_bound(std::make_pair(file, (PageId)0));
+  std::map<std::pair<const File*, PageId>, std::uint64_t>::iterator last =
+    prefetchedPages.upper_bound(std::make_pair(file, std::numeric_limits<PageId>::max()));
+  bufStats.prefetchwasted += std::distance(first, last);
+  prefetchedPages.erase(first, last);
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo)
@@ -217,12 +373,25 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  try
+  {
+    hashTable->lookup(file, pageNo, frameNo);
+    if (bufDescTable[frameNo].pinCnt > 0)
+    {
+      throw PagePinnedException(file->filename(), pageNo, frameNo);
+    }
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+    // clear the page
+    bufDescTable[frameNo].Clear();
+
+    hashTable->remove(file, pageNo);
+  }
+  catch(const HashNotFoundException &e)
+  {
+    // not in the buffer pool, nothing to drop
+  }
 
-	hashTable->remove(file, pageNo);
+  prefetchedPages.erase(std::make_pair((const File*)file, pageNo));
 
   // deallocate it in the file	
   file->deletePage(pageNo);
@@ -10,6 +10,9 @@
 #include "file.h"
 #include "bufHashTbl.h"
 #include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
 
 namespace badgerdb {
 
@@ -18,6 +21,12 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* @brief Smallest number of frames a frame pool has, however large its frames, unless the whole buffer pool
+* is given fewer frames of Page::SIZE bytes.
+*/
+const std::uint32_t MINPOOLFRAMES = 8;
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
@@ -137,12 +146,29 @@ struct BufStats
 	 */
   int diskwrites;
 
+	/**
+   * Number of pages prefetchPage asked the operating system to read ahead
+	 */
+  int prefetches;
+
+	/**
+   * Number of pages readPage read from disk after prefetchPage asked for them, with at least one other
+   * readPage in between so that the read had time to go on in the background
+	 */
+  int prefetchhits;
+
+	/**
+   * Number of pages prefetchPage asked for that nobody read before their file was flushed
+	 */
+  int prefetchwasted;
+
 	/**
    * Clear all values 
 	 */
   void clear()
   {
 		accesses = diskreads = diskwrites = 0;
+		prefetches = prefetchhits = prefetchwasted = 0;
   }
       
 	/**
@@ -155,21 +181,57 @@ struct BufStats
 };
 
 
+/**
+* @brief Frames of one size in the buffer pool, used for the pages of the files whose page size rounds up to it
+*/
+struct FramePool
+{
+	/**
+   * Size in bytes of every frame of the pool, a power of two
+	 */
+  std::size_t frameSize;
+
+	/**
+   * Frame number of the first frame of the pool; the others follow it
+	 */
+  FrameId firstFrame;
+
+	/**
+   * Number of frames in the pool
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Current position of the clockhand among the frames of the pool
+	 */
+  FrameId clockHand;
+
+	/**
+   * Memory of the frames, NULL until a page of this size is first used
+	 */
+  char* memory;
+};
+
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* The buffer pool has one pool of frames per power of two from Page::MIN_SIZE to Page::MAX_SIZE, and a page
+* goes into a frame of the pool for the page size of its file, so that small pages do not take a frame of the
+* largest page size. Every pool is given the same capacity in bytes, and its memory is only allocated when a
+* file of its page size is first used. Each pool replaces its frames with its own clock.
 */
 class BufMgr 
 {
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Number of frames in the buffer pool, over all frame pools
 	 */
-  FrameId clockHand;
+  std::uint32_t numBufs;
 
 	/**
-   * Number of frames in the buffer pool
+   * Frame pools, from frames of Page::MIN_SIZE bytes up to frames of Page::MAX_SIZE bytes
 	 */
-  std::uint32_t numBufs;
+  std::vector<FramePool> pools;
 	
 	/**
    * Hash table mapping (File, page) to frame
@@ -187,29 +249,50 @@ class BufMgr
   BufStats bufStats;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Number of readPage calls so far, which orders them against prefetches
+	 */
+  std::uint64_t numReads;
+
+	/**
+   * Pages prefetchPage asked for that have not been read into the buffer pool since, each with the
+   * value of numReads when it was asked for
 	 */
-  void advanceClock()
+  std::map<std::pair<const File*, PageId>, std::uint64_t> prefetchedPages;
+
+	/**
+   * Advance clock of the pool to its next frame
+	 */
+  void advanceClock(FramePool & pool)
   {
-		clockHand = (clockHand + 1) % numBufs;
+		pool.clockHand = pool.firstFrame + (pool.clockHand - pool.firstFrame + 1) % pool.numFrames;
   }
 
 	/**
-	 * Allocate a free frame.  
+	 * Returns the frame pool for the pages of the file, allocating its memory if it has none yet.
 	 *
+	 * @param file   	File object
+	 */
+  FramePool & poolFor(const File* file);
+
+	/**
+	 * Allocate a free frame of the pool.  
+	 *
+	 * @param pool   	Frame pool to take the frame from
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FramePool & pool, FrameId & frame);
 
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Actual buffer pool: the address of every frame, NULL while the memory of its pool is not allocated
 	 */
-  Page* bufPool;
+  std::vector<Page*> bufPool;
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs   	Capacity of every frame pool, as a number of frames of Page::SIZE bytes
 	 */
   BufMgr(std::uint32_t bufs);
 	
@@ -229,6 +312,16 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Asks the operating system to start reading the given page of the file and returns without waiting
+	 * for it, so that a later readPage finds it in the page cache. No frame is taken until that readPage.
+	 * This is only a hint: nothing is done if the page is already in the buffer pool or was asked for.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 */
+  void prefetchPage(File* file, const PageId PageNo);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -249,6 +342,37 @@ class BufMgr
 	 */
   void allocPage(File* file, PageId &PageNo, Page*& page); 
 
+	/**
+	 * Assigns a frame to a page the file has allocated but that was never written, such as a page
+	 * of an extent from BlobFile::allocateExtent(), and returns it empty without reading it.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Number of the allocated page
+	 * @param page  	Reference to page pointer. The empty in-memory Page object is returned via this reference.
+	 */
+  void allocPageAt(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * Inserts a record on a page of the file with room for it, found through the file's free space map,
+	 * or on a new page if no page has room. The page is changed in the buffer pool and unpinned dirty,
+	 * so a copy of it already in the pool is never overwritten by a stale one.
+	 *
+	 * @param file   	PageFile object
+	 * @param record  Bytes of the record
+	 * @return  ID of the new record
+   * @throws  InsufficientSpaceException If the record does not fit on an empty page of the file
+	 */
+  RecordId insertRecord(PageFile* file, const std::string& record);
+
+	/**
+	 * Deletes a record from its page in the buffer pool, which makes its space available to later inserts.
+	 *
+	 * @param file   	PageFile object
+	 * @param rid  		ID of the record to delete
+   * @throws  InvalidRecordException If the record is not on its page
+	 */
+  void deleteRecord(PageFile* file, const RecordId& rid);
+
 	/**
 	 * Writes out all dirty pages of the file to disk.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
@@ -266,6 +390,7 @@ class BufMgr
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
+   * @throws  PagePinnedException If the page is pinned in the buffer pool
 	 */
   void disposePage(File* file, const PageId PageNo);
 
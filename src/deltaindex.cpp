@@ -0,0 +1,195 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "deltaindex.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/scan_not_initialized_exception.h"
+
+namespace badgerdb {
+
+// orders a memtable entry against a key, for the bounds of a scan
+static bool entryBelowKey(const RIDKeyPair<int> &entry, const int key)
+{
+	return entry.key < key;
+}
+
+static bool keyBelowEntry(const int key, const RIDKeyPair<int> &entry)
+{
+	return key < entry.key;
+}
+
+DeltaIndex::DeltaIndex(BTreeIndex *btreeIndex, const int threshold)
+{
+	if (btreeIndex->isComposite() || btreeIndex->attributeType != INTEGER)
+	{
+		throw BadIndexInfoException("Delta indexes need a single INTEGER key attribute");
+	}
+
+	index = btreeIndex;
+	flushThreshold = threshold < 1 ? 1 : threshold;
+	sorted = true;
+	numFlushes = 0;
+	scanExecuting = false;
+	memtable.reserve(flushThreshold);
+}
+
+DeltaIndex::~DeltaIndex()
+{
+	flush();
+}
+
+void DeltaIndex::insertEntry(const void *key, const RecordId rid)
+{
+	RIDKeyPair<int> entry;
+	entry.set(rid, *(int *)key);
+	if (sorted && !memtable.empty() && entry < memtable.back())
+	{
+		sorted = false;
+	}
+	memtable.push_back(entry);
+
+	// A running scan holds positions in the memtable and a leaf of the index
+	if ((int)memtable.size() >= flushThreshold && !scanExecuting)
+	{
+		flush();
+	}
+}
+
+void DeltaIndex::flush()
+{
+	if (scanExecuting)
+	{
+		endScan();
+	}
+	if (memtable.empty())
+	{
+		return;
+	}
+
+	// In key order the merge sweeps the leaves from left to right once
+	sortMemtable();
+	std::vector<int> keys(memtable.size());
+	std::vector<RecordId> rids(memtable.size());
+	for (size_t i = 0; i < memtable.size(); i++)
+	{
+		keys[i] = memtable[i].key;
+		rids[i] = memtable[i].rid;
+	}
+	index->mergeSortedEntries(&keys[0], &rids[0], memtable.size());
+	memtable.clear();
+	numFlushes++;
+}
+
+void DeltaIndex::sortMemtable()
+{
+	if (!sorted)
+	{
+		std::sort(memtable.begin(), memtable.end());
+		sorted = true;
+	}
+}
+
+void DeltaIndex::startScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm,
+													 const Operator highOpParm, const int limit)
+{
+	if (scanExecuting)
+	{
+		endScan();
+	}
+
+	// The index checks the operators and the range
+	index->startScan(lowValParm, lowOpParm, highValParm, highOpParm);
+	scanExecuting = true;
+	treeLookahead = false;
+	treeDone = false;
+	scanLimit = limit;
+	scanCount = 0;
+
+	sortMemtable();
+	int low = *(int *)lowValParm;
+	int high = *(int *)highValParm;
+	std::vector<RIDKeyPair<int> >::iterator first = (lowOpParm == GT)
+		? std::upper_bound(memtable.begin(), memtable.end(), low, keyBelowEntry)
+		: std::lower_bound(memtable.begin(), memtable.end(), low, entryBelowKey);
+	std::vector<RIDKeyPair<int> >::iterator last = (highOpParm == LT)
+		? std::lower_bound(memtable.begin(), memtable.end(), high, entryBelowKey)
+		: std::upper_bound(memtable.begin(), memtable.end(), high, keyBelowEntry);
+	nextDelta = first - memtable.begin();
+	endDelta = std::max(first, last) - memtable.begin();
+}
+
+void DeltaIndex::scanNext(RecordId& outRid)
+{
+	int key;
+	scanNext(outRid, &key);
+}
+
+void DeltaIndex::scanNext(RecordId& outRid, void* outKey)
+{
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+	if (scanLimit >= 0 && scanCount >= scanLimit)
+	{
+		throw IndexScanCompletedException();
+	}
+
+	// Read the next entry of the index ahead while it has one
+	if (!treeLookahead && !treeDone)
+	{
+		try
+		{
+			index->scanNext(treeEntry.rid, &treeEntry.key);
+			treeLookahead = true;
+		}
+		catch (const IndexScanCompletedException &e)
+		{
+			treeDone = true;
+		}
+	}
+
+	bool fromDelta = nextDelta < endDelta && (!treeLookahead || memtable[nextDelta].key < treeEntry.key);
+	if (!fromDelta && !treeLookahead)
+	{
+		throw IndexScanCompletedException();
+	}
+
+	RIDKeyPair<int> entry;
+	if (fromDelta)
+	{
+		entry = memtable[nextDelta++];
+	}
+	else
+	{
+		entry = treeEntry;
+		treeLookahead = false;
+	}
+	outRid = entry.rid;
+	*(int *)outKey = entry.key;
+	scanCount++;
+}
+
+void DeltaIndex::endScan()
+{
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+	index->endScan();
+	scanExecuting = false;
+
+	// Flush held back by the scan
+	if ((int)memtable.size() >= flushThreshold)
+	{
+		flush();
+	}
+}
+
+}
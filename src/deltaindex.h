@@ -0,0 +1,187 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Default number of entries a DeltaIndex holds in memory before it moves them into its
+ * BTreeIndex.
+ */
+const  int DELTAFLUSHTHRESHOLD = 65536;
+
+/**
+ * @brief This class takes inserts for an INTEGER BTreeIndex into an in-memory delta tier first.
+ *
+ * Inserts are appended to a memtable and cost no page access. Once the memtable holds
+ * flushThreshold entries it is sorted and merged into the tree with
+ * BTreeIndex::mergeSortedEntries, so every leaf that gets entries is read and written once per
+ * flush and the others are not read, where inserts in arrival order read and write a random leaf
+ * each.
+ * Scans merge the entries of the memtable in their range with those of the tree.
+ *
+ * The memtable is not logged: entries not yet flushed when the process dies are lost. They are
+ * flushed when the DeltaIndex is destroyed.
+ */
+class DeltaIndex
+{
+ public:
+
+  /**
+   * @param index						INTEGER index the entries end up in. It has to outlive this object.
+   * @param flushThreshold	Number of entries in the memtable that triggers a flush
+   * @throws  BadIndexInfoException If the index is not on a single INTEGER attribute
+   */
+  DeltaIndex(BTreeIndex *index, const int flushThreshold = DELTAFLUSHTHRESHOLD);
+
+  /**
+   * Ends a running scan and flushes the memtable into the index.
+   */
+  ~DeltaIndex();
+
+  /**
+	 * Add the pair <value,rid> to the memtable, flushing it once it reaches the threshold.
+	 * While a scan is running the flush waits for endScan.
+   * @param key			Key to insert, pointer to integer
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+	**/
+  void insertEntry(const void* key, const RecordId rid);
+
+  /**
+	 * Merge every entry of the memtable into the index in key order and empty the memtable.
+	 * Ends a running scan first.
+	**/
+  void flush();
+
+  /**
+	 * Begin a filtered scan of the memtable and the index, like BTreeIndex::startScan.
+	 * The scan does not see entries inserted after it starts.
+   * @param lowVal	Low value of range, pointer to integer
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer
+   * @param highOp	High operator (LT/LTE)
+   * @param limit		Maximum number of entries to return, or -1 for no limit
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+  void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+								 const int limit = -1);
+
+  /**
+	 * Fetch the record id of the next entry of the scan, in key order.
+	 * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+  void scanNext(RecordId& outRid);
+
+  /**
+	 * Fetch the record id and the key of the next entry of the scan, in key order.
+	 * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @param outKey	Key of that entry returned in this, pointer to integer
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+  void scanNext(RecordId& outRid, void* outKey);
+
+  /**
+	 * Terminate the current scan, and flush the memtable if it reached the threshold meanwhile.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+  void endScan();
+
+  /**
+	 * Number of entries in the memtable.
+	**/
+  int getNumBuffered() const { return memtable.size(); }
+
+  /**
+	 * Number of flushes of a non-empty memtable so far.
+	**/
+  int getNumFlushes() const { return numFlushes; }
+
+ private:
+
+  /**
+   * Sorts the memtable if entries were appended out of key order.
+   */
+  void sortMemtable();
+
+  /**
+   * Index the entries end up in.
+   */
+  BTreeIndex    *index;
+
+  /**
+   * Number of entries in the memtable that triggers a flush.
+   */
+  int           flushThreshold;
+
+  /**
+   * Entries not inserted into the index yet.
+   */
+  std::vector<RIDKeyPair<int> > memtable;
+
+  /**
+   * True if the memtable is in key order.
+   */
+  bool          sorted;
+
+  /**
+   * Number of flushes of a non-empty memtable so far.
+   */
+  int           numFlushes;
+
+  /**
+   * True if a scan is running.
+   */
+  bool          scanExecuting;
+
+  /**
+   * Position in the memtable of the next entry of the scan.
+   */
+  size_t        nextDelta;
+
+  /**
+   * Position in the memtable past the last entry of the scan.
+   */
+  size_t        endDelta;
+
+  /**
+   * True if treeEntry holds the next entry of the index scan.
+   */
+  bool          treeLookahead;
+
+  /**
+   * True once the index scan has no entries left.
+   */
+  bool          treeDone;
+
+  /**
+   * Next entry of the index scan, read ahead to be compared with the next memtable entry.
+   */
+  RIDKeyPair<int> treeEntry;
+
+  /**
+   * Maximum number of entries the scan returns, or -1 for no limit.
+   */
+  int           scanLimit;
+
+  /**
+   * Number of entries the scan has returned.
+   */
+  int           scanCount;
+};
+
+}
@@ -0,0 +1,29 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_page_size_exception.h"
+#include "page.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadPageSizeException::BadPageSizeException(
+    const std::size_t size, const std::string& file)
+    : BadgerDbException(""),
+      page_size_(size),
+      filename_(file) {
+  std::stringstream ss;
+  ss << "Bad page size " << page_size_
+     << " for file '" << filename_ << "'."
+     << " Page sizes must be between " << Page::MIN_SIZE
+     << " and the buffer frame size " << Page::SIZE;
+  message_.assign(ss.str());
+}
+
+}
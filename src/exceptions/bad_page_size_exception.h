@@ -0,0 +1,58 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file is created with a page size
+ *        that does not fit in a buffer frame or cannot hold a page header.
+ */
+class BadPageSizeException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad page size exception for the given page size and filename.
+   *
+   * @param size  Requested page size.
+   * @param file  Name of file that was being created.
+   */
+  BadPageSizeException(const std::size_t size, const std::string& file);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~BadPageSizeException() throw() {}
+
+  /**
+   * Returns the requested page size that caused this exception.
+   */
+  virtual std::size_t page_size() const { return page_size_; }
+
+  /**
+   * Returns name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Requested page size which caused this exception.
+   */
+  const std::size_t page_size_;
+
+  /**
+   * Name of file which caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
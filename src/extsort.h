@@ -0,0 +1,519 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Fewest buffer pool pages an ExternalSort can work with: two runs being merged and the output.
+ */
+const int MINSORTPAGES = 3;
+
+/**
+ * @brief Layout of a page of a sorted run. Entries are copied in and out as raw bytes, so T has
+ * to be a plain struct with an operator<, such as RIDKeyPair.
+ */
+template <class T>
+struct RunPage{
+  /**
+   * Number of entries used on the page.
+   */
+	int numEntries;
+
+  /**
+   * Entries, in sorted order.
+   */
+	T entries[ ( Page::SIZE - sizeof( int ) ) / sizeof( T ) ];
+};
+
+/**
+ * @brief This class sorts more entries than fit in memory.
+ *
+ * Entries are collected until they fill the memory budget, then sorted and written out as a run
+ * to a temporary BlobFile through the buffer manager. Once all entries are in, runs are merged
+ * with a loser tree, memoryPages - 1 at a time, until one last merge can stream the result out
+ * through scanNext. If everything fits in the budget nothing is written at all.
+ */
+template <class T>
+class ExternalSort
+{
+ public:
+
+  /**
+   * @param name					Prefix of the names of the temporary run files
+   * @param bufMgr				Buffer Manager instance
+   * @param memoryPages		Memory budget in pages, for the entries being collected and for the pages
+   *										pinned during a merge. At least MINSORTPAGES are used.
+   */
+  ExternalSort(const std::string &name, BufMgr *bufMgr, const int memoryPages);
+
+  /**
+   * Removes the run files that are left.
+   */
+  ~ExternalSort();
+
+  /**
+   * Add an entry to sort. All entries have to be added before the first call to scanNext.
+   * @param entry	Entry to add
+   */
+  void add(const T &entry);
+
+  /**
+   * Return the next entry in sorted order.
+   * @param out	Next entry returned in this
+	 * @throws EndOfFileException If all entries have been returned.
+   */
+  void scanNext(T &out);
+
+  /**
+   * Number of runs written to disk so far, including runs of intermediate merges.
+   */
+  int getNumRuns() const { return numRuns; }
+
+  /**
+   * Number of merge passes over the runs, including the final one that feeds scanNext.
+   */
+  int getNumPasses() const { return numPasses; }
+
+ private:
+  /**
+   * @brief A sorted run stored in its own BlobFile, on consecutive pages.
+   */
+  struct Run{
+		std::string	fileName;
+		BlobFile		*file;
+		PageId			firstPageNo;
+		int					numPages;
+	};
+
+  /**
+   * @brief Read position in a run being merged. The current page stays pinned.
+   */
+  struct RunCursor{
+		Run					run;
+		int					pageIdx;
+		int					entryIdx;
+		Page				*page;
+		bool				done;
+	};
+
+  /**
+   * Sorts the entries collected in memory and writes them out as a new run.
+   */
+  void spillBuffer();
+
+  /**
+   * Creates an empty run file.
+   */
+  Run createRun();
+
+  /**
+   * Appends an entry to the run being written; outPage is its last page, pinned.
+   */
+  void appendToRun(Run &run, RunPage<T> *&outPage, const T &entry);
+
+  /**
+   * Deletes the file of a run.
+   */
+  void removeRun(Run &run);
+
+  /**
+   * Sets up the loser tree over the given runs.
+   */
+  void startMerge(const std::vector<Run> &runs);
+
+  /**
+   * Removes and returns the smallest entry of the merge. False if the merge is exhausted.
+   */
+  bool mergeNext(T &out);
+
+  /**
+   * Unpins the pages of the merge and deletes its runs.
+   */
+  void endMerge();
+
+  /**
+   * Moves a cursor to its next entry, reading the next page of the run if needed.
+   */
+  void advanceCursor(RunCursor &cursor);
+
+  /**
+   * True if input a comes before input b in the merge. Input number numInputs stands for an
+   * entry smaller than any, used to fill the tree before the first matches are played.
+   */
+  bool inputBefore(int a, int b) const;
+
+  /**
+   * Replays the matches on the path from an input to the root after its entry changed.
+   */
+  void replay(int input);
+
+  /**
+   * Prefix of run file names.
+   */
+  std::string   name;
+
+  /**
+   * Buffer Manager instance used to read/write pages into/from buffer pool.
+   */
+	BufMgr				*bufMgr;
+
+  /**
+   * Memory budget in pages.
+   */
+  int           memoryPages;
+
+  /**
+   * Entries collected in memory, sorted in place before a spill.
+   */
+  std::vector<T> buffer;
+
+  /**
+   * Runs written to disk and not merged yet.
+   */
+  std::vector<Run> runs;
+
+  /**
+   * Cursors of the runs being merged, one per input of the loser tree.
+   */
+  std::vector<RunCursor> cursors;
+
+  /**
+   * Loser tree. loserTree[0] holds the input with the smallest entry, the other nodes the loser
+   * of the match played there.
+   */
+  std::vector<int> loserTree;
+
+  /**
+   * Number of inputs of the current merge.
+   */
+  int           numInputs;
+
+  /**
+   * True once input is complete and scanNext has set up the last merge or the buffer.
+   */
+  bool          sorted;
+
+  /**
+   * Position in buffer when everything fit in memory.
+   */
+  std::size_t   nextEntry;
+
+  /**
+   * Counter used to name run files.
+   */
+  int           numRuns;
+
+  /**
+   * Number of merge passes started.
+   */
+  int           numPasses;
+};
+
+template <class T>
+ExternalSort<T>::ExternalSort(const std::string &sortName, BufMgr *bufferMgr, const int budget)
+{
+	name = sortName;
+	bufMgr = bufferMgr;
+	memoryPages = budget < MINSORTPAGES ? MINSORTPAGES : budget;
+	numInputs = 0;
+	sorted = false;
+	nextEntry = 0;
+	numRuns = 0;
+	numPasses = 0;
+}
+
+template <class T>
+ExternalSort<T>::~ExternalSort()
+{
+	endMerge();
+	for (std::size_t i = 0; i < runs.size(); i++)
+	{
+		removeRun(runs[i]);
+	}
+}
+
+template <class T>
+void ExternalSort<T>::add(const T &entry)
+{
+	buffer.push_back(entry);
+
+	// the collected entries take as many pages as their runs will
+	int perPage = sizeof(((RunPage<T> *)0)->entries) / sizeof(T);
+	if ((int)buffer.size() >= memoryPages * perPage)
+	{
+		spillBuffer();
+	}
+}
+
+template <class T>
+void ExternalSort<T>::scanNext(T &out)
+{
+	if (!sorted)
+	{
+		sorted = true;
+		if (runs.empty())
+		{
+			// everything fit in memory
+			std::sort(buffer.begin(), buffer.end());
+		}
+		else
+		{
+			if (!buffer.empty())
+			{
+				spillBuffer();
+			}
+
+			// merge groups of runs into longer runs until one merge can take them all
+			int fanIn = memoryPages - 1;
+			while ((int)runs.size() > fanIn)
+			{
+				std::vector<Run> next;
+				for (std::size_t first = 0; first < runs.size(); first += fanIn)
+				{
+					std::size_t last = std::min(runs.size(), first + fanIn);
+					std::vector<Run> group(runs.begin() + first, runs.begin() + last);
+					if (group.size() == 1)
+					{
+						next.push_back(group[0]);
+						continue;
+					}
+
+					startMerge(group);
+					Run merged = createRun();
+					RunPage<T> *outPage = NULL;
+					T entry;
+					while (mergeNext(entry))
+					{
+						appendToRun(merged, outPage, entry);
+					}
+					bufMgr->unPinPage(merged.file, merged.firstPageNo + merged.numPages - 1, true);
+					bufMgr->flushFile(merged.file);
+					endMerge();
+					next.push_back(merged);
+				}
+				runs.swap(next);
+			}
+
+			startMerge(runs);
+			runs.clear();
+		}
+	}
+
+	if (cursors.empty())
+	{
+		if (nextEntry >= buffer.size())
+		{
+			throw EndOfFileException();
+		}
+		out = buffer[nextEntry++];
+		return;
+	}
+
+	if (!mergeNext(out))
+	{
+		endMerge();
+		throw EndOfFileException();
+	}
+}
+
+template <class T>
+void ExternalSort<T>::spillBuffer()
+{
+	std::sort(buffer.begin(), buffer.end());
+
+	Run run = createRun();
+	RunPage<T> *outPage = NULL;
+	for (std::size_t i = 0; i < buffer.size(); i++)
+	{
+		appendToRun(run, outPage, buffer[i]);
+	}
+	bufMgr->unPinPage(run.file, run.firstPageNo + run.numPages - 1, true);
+	bufMgr->flushFile(run.file);
+	runs.push_back(run);
+
+	std::vector<T>().swap(buffer);
+}
+
+template <class T>
+typename ExternalSort<T>::Run ExternalSort<T>::createRun()
+{
+	std::ostringstream runName;
+	runName << name << ".run" << numRuns++;
+
+	Run run;
+	run.fileName = runName.str();
+	try
+	{
+		File::remove(run.fileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	run.file = new BlobFile(run.fileName, true);
+	run.firstPageNo = 0;
+	run.numPages = 0;
+	return run;
+}
+
+template <class T>
+void ExternalSort<T>::appendToRun(Run &run, RunPage<T> *&outPage, const T &entry)
+{
+	int perPage = sizeof(outPage->entries) / sizeof(T);
+	if (outPage == NULL || outPage->numEntries == perPage)
+	{
+		if (outPage != NULL)
+		{
+			bufMgr->unPinPage(run.file, run.firstPageNo + run.numPages - 1, true);
+		}
+
+		// BlobFile pages are numbered in allocation order, so a run is one range of pages
+		Page *page;
+		PageId pageNo;
+		bufMgr->allocPage(run.file, pageNo, page);
+		if (run.numPages == 0)
+		{
+			run.firstPageNo = pageNo;
+		}
+		run.numPages++;
+		outPage = (RunPage<T> *)page;
+		outPage->numEntries = 0;
+	}
+	outPage->entries[outPage->numEntries++] = entry;
+}
+
+template <class T>
+void ExternalSort<T>::removeRun(Run &run)
+{
+	bufMgr->flushFile(run.file);
+	delete run.file;
+	File::remove(run.fileName);
+}
+
+template <class T>
+void ExternalSort<T>::startMerge(const std::vector<Run> &mergeRuns)
+{
+	numPasses++;
+	numInputs = mergeRuns.size();
+	cursors.resize(numInputs);
+	for (int i = 0; i < numInputs; i++)
+	{
+		RunCursor &cursor = cursors[i];
+		cursor.run = mergeRuns[i];
+		cursor.pageIdx = 0;
+		cursor.entryIdx = 0;
+		cursor.done = false;
+		bufMgr->readPage(cursor.run.file, cursor.run.firstPageNo, cursor.page);
+		if (((RunPage<T> *)cursor.page)->numEntries == 0)
+		{
+			advanceCursor(cursor);
+		}
+	}
+
+	// every node starts out holding the smallest possible entry, then each input plays its way up
+	loserTree.assign(numInputs, numInputs);
+	for (int i = numInputs - 1; i >= 0; i--)
+	{
+		replay(i);
+	}
+}
+
+template <class T>
+bool ExternalSort<T>::mergeNext(T &out)
+{
+	int winner = loserTree[0];
+	if (cursors[winner].done)
+	{
+		return false;
+	}
+
+	RunCursor &cursor = cursors[winner];
+	out = ((RunPage<T> *)cursor.page)->entries[cursor.entryIdx];
+	cursor.entryIdx++;
+	if (cursor.entryIdx == ((RunPage<T> *)cursor.page)->numEntries)
+	{
+		advanceCursor(cursor);
+	}
+	replay(winner);
+	return true;
+}
+
+template <class T>
+void ExternalSort<T>::endMerge()
+{
+	for (std::size_t i = 0; i < cursors.size(); i++)
+	{
+		if (!cursors[i].done)
+		{
+			bufMgr->unPinPage(cursors[i].run.file, cursors[i].run.firstPageNo + cursors[i].pageIdx, false);
+		}
+		removeRun(cursors[i].run);
+	}
+	cursors.clear();
+	numInputs = 0;
+}
+
+template <class T>
+void ExternalSort<T>::advanceCursor(RunCursor &cursor)
+{
+	bufMgr->unPinPage(cursor.run.file, cursor.run.firstPageNo + cursor.pageIdx, false);
+	cursor.pageIdx++;
+	cursor.entryIdx = 0;
+	if (cursor.pageIdx == cursor.run.numPages)
+	{
+		cursor.done = true;
+		cursor.page = NULL;
+		return;
+	}
+	bufMgr->readPage(cursor.run.file, cursor.run.firstPageNo + cursor.pageIdx, cursor.page);
+}
+
+template <class T>
+bool ExternalSort<T>::inputBefore(int a, int b) const
+{
+	if (a == numInputs || b == numInputs)
+	{
+		return a == numInputs;
+	}
+	if (cursors[a].done || cursors[b].done)
+	{
+		return !cursors[a].done;
+	}
+	const RunCursor &ca = cursors[a];
+	const RunCursor &cb = cursors[b];
+	return ((RunPage<T> *)ca.page)->entries[ca.entryIdx] < ((RunPage<T> *)cb.page)->entries[cb.entryIdx];
+}
+
+template <class T>
+void ExternalSort<T>::replay(int input)
+{
+	// input i sits below node (i + numInputs) / 2; the winner of each match moves up
+	int winner = input;
+	for (int node = (input + numInputs) / 2; node > 0; node /= 2)
+	{
+		if (inputBefore(loserTree[node], winner))
+		{
+			std::swap(winner, loserTree[node]);
+		}
+	}
+	loserTree[0] = winner;
+}
+
+}
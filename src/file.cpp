@@ -7,30 +7,40 @@
 
 #include "file.h"
 
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/bad_page_size_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+File::DescriptorMap File::open_fds_;
 File::CountMap File::open_counts_;
+std::mutex File::open_mutex_;
+PageFile::SpaceMapMap PageFile::open_space_maps_;
 
 void File::remove(const std::string& filename) {
+  std::lock_guard<std::mutex> lock(open_mutex_);
   if (!exists(filename)) {
     throw FileNotFoundException(filename);
   }
-  if (isOpen(filename)) {
+  if (open_counts_.find(filename) != open_counts_.end()) {
     throw FileOpenException(filename);
   }
   std::remove(filename.c_str());
@@ -40,18 +50,12 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> lock(open_mutex_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
-
-	return false;
+	return access(filename.c_str(), F_OK) == 0;
 }
 
 File::~File() {
@@ -64,24 +68,36 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+File::File(const std::string& name, const bool create_new,
+           const std::size_t page_size)
+    : filename_(name), fd_(-1), page_size_(page_size), num_reads_(0),
+      num_writes_(0) {
+  if (create_new && (page_size < Page::MIN_SIZE || page_size > Page::MAX_SIZE)) {
+    throw BadPageSizeException(page_size, name);
+  }
+
   openIfNeeded(create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* last_used_page */,
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         static_cast<std::uint32_t>(page_size),
+                         0 /* first_map_page */};
     writeHeader(header);
+  } else {
+    page_size_ = readHeader().page_size;
   }
 }
 
 void File::openIfNeeded(const bool create_new) {
+  std::lock_guard<std::mutex> lock(open_mutex_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    fd_ = open_fds_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = O_RDWR;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
@@ -89,67 +105,158 @@ void File::openIfNeeded(const bool create_new) {
         throw FileExistsException(filename_);
       }
       // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags |= O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    fd_ = ::open(filename_.c_str(), flags, 0666);
+    if (fd_ < 0) {
+      throw FileIOException(filename_, "open", errno);
+    }
+    open_fds_[filename_] = fd_;
     open_counts_[filename_] = 1;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> lock(open_mutex_);
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    open_fds_.erase(filename_);
     open_counts_.erase(filename_);
   }
+  fd_ = -1;
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+  readBytes(0 /* pos */, &header, sizeof(FileHeader));
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
-}
-
+  writeBytes(0 /* pos */, &header, sizeof(FileHeader));
+}
+
+void File::adviseWillNeed(const PageId page_number) const {
+  posix_fadvise(fd_, pagePosition(page_number), page_size_,
+                POSIX_FADV_WILLNEED);
+}
+
+void File::readBytes(const off_t position, void* bytes,
+                     const std::size_t count, void* more,
+                     const std::size_t more_count) const {
+  ++num_reads_;
+  struct iovec buffers[2] = {{bytes, count}, {more, more_count}};
+  struct iovec* next = buffers;
+  int num_buffers = more == NULL ? 1 : 2;
+  off_t offset = position;
+  std::size_t done = 0;
+  while (true) {
+    // Skip what the last call read, which may end inside a buffer
+    for (; num_buffers > 0 && done >= next->iov_len; ++next, --num_buffers) {
+      done -= next->iov_len;
+    }
+    if (num_buffers == 0) {
+      break;
+    }
+    next->iov_base = static_cast<char*>(next->iov_base) + done;
+    next->iov_len -= done;
 
+    const ssize_t bytes_read = preadv(fd_, next, num_buffers, offset);
+    if (bytes_read < 0 && errno == EINTR) {
+      done = 0;
+      continue;
+    }
+    if (bytes_read < 0) {
+      throw FileIOException(filename_, "read", errno);
+    }
+    if (bytes_read == 0) {
+      // End of the file: the bytes never written are zeroes
+      for (; num_buffers > 0; ++next, --num_buffers) {
+        memset(next->iov_base, 0, next->iov_len);
+      }
+      break;
+    }
+    offset += bytes_read;
+    done = bytes_read;
+  }
+}
 
+void File::writeBytes(const off_t position, const void* bytes,
+                      const std::size_t count, const void* more,
+                      const std::size_t more_count) {
+  ++num_writes_;
+  struct iovec buffers[2] = {{const_cast<void*>(bytes), count},
+                             {const_cast<void*>(more), more_count}};
+  struct iovec* next = buffers;
+  int num_buffers = more == NULL ? 1 : 2;
+  off_t offset = position;
+  std::size_t done = 0;
+  while (true) {
+    // Skip what the last call wrote, which may end inside a buffer
+    for (; num_buffers > 0 && done >= next->iov_len; ++next, --num_buffers) {
+      done -= next->iov_len;
+    }
+    if (num_buffers == 0) {
+      break;
+    }
+    next->iov_base = static_cast<char*>(next->iov_base) + done;
+    next->iov_len -= done;
 
+    const ssize_t written = pwritev(fd_, next, num_buffers, offset);
+    if (written < 0 && errno == EINTR) {
+      done = 0;
+      continue;
+    }
+    if (written < 0) {
+      throw FileIOException(filename_, "write", errno);
+    }
+    if (written == 0) {
+      // Nothing written for bytes left to write: the device is full
+      throw FileIOException(filename_, "write", ENOSPC);
+    }
+    offset += written;
+    done = written;
+  }
+}
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+PageFile PageFile::create(const std::string& filename,
+                       const std::size_t page_size) {
+  return PageFile(filename, true /* create_new */, page_size);
 }
 
 PageFile PageFile::open(const std::string& filename) {
   return PageFile(filename, false /* create_new */);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const std::size_t page_size)
+: File(name, create_new, page_size)
 {
+  openSpaceMap(create_new);
 }
 
 PageFile::~PageFile() {
+  std::lock_guard<std::mutex> lock(open_mutex_);
+  if (space_map_.use_count() == 1) {
+    open_space_maps_.erase(filename_);
+  }
 }
 
 PageFile::PageFile(const PageFile& other)
-: File(other.filename_, false /* create_new */)
+: File(other.filename_, false /* create_new */),
+  space_map_(other.space_map_)
 {
 }
 
@@ -159,97 +266,75 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
   openIfNeeded(false /* create_new */);
+  page_size_ = rhs.page_size_;
+  space_map_ = rhs.space_map_;
   return *this;
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
   FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
+    new_page_number = header.first_free_page;
+    header.first_free_page = readPageHeader(new_page_number).next_page_number;
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   }
 	else
 	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
-
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
+    new_page_number = header.num_pages;
     ++header.num_pages;
+    extendSpaceMap(header);
   }
-  writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+  new_page.set_page_number(new_page_number);
+
+  // The new page goes after the last used page, whose header is the only
+  // other one that changes
+  new_page.header_.prev_page_number = header.last_used_page;
+  if (header.last_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = new_page_number;
+  } else {
+    PageHeader last_header = readPageHeader(header.last_used_page);
+    last_header.next_page_number = new_page_number;
+    writePageHeader(header.last_used_page, last_header);
   }
+  header.last_used_page = new_page_number;
+
+  // records may only use the part of the frame that is stored in this file
+  new_page.header_.free_space_upper_bound = page_size_ - sizeof(PageHeader);
+  writePage(new_page_number, new_page.header_, new_page);
   writeHeader(header);
+  setFreeSpace(new_page_number, new_page.getFreeSpace());
 
   return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPageInto(page_number, &page);
+  return page;
+}
+
+void PageFile::readPageInto(const PageId page_number, Page* page) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+  readBytes(pagePosition(page_number), &page->header_, sizeof(PageHeader),
+            &page->data_[0], page_size_ - sizeof(PageHeader));
+  if (!page->isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
+  readBytes(pagePosition(page_number), &page.header_, sizeof(PageHeader),
+            &page.data_[0], page_size_ - sizeof(PageHeader));
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
@@ -264,44 +349,71 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 		// Page has been deleted since it was read.
 		throw InvalidPageException(new_page_number, filename_);
 	}
-	// Page on disk may have had its next page pointer updated since it was read;
-	// we don't modify that, but we do keep all the other modifications to the
-	// page header.
+	// Page on disk may have had its next and previous page pointers updated
+	// since it was read; we don't modify those, but we do keep all the other
+	// modifications to the page header.
 	const PageId next_page_number = header.next_page_number;
+	const PageId prev_page_number = header.prev_page_number;
 	header = new_page.header_;
 	header.next_page_number = next_page_number;
+	header.prev_page_number = prev_page_number;
 	writePage(new_page_number, header, new_page);
+	setFreeSpace(new_page_number, new_page.getFreeSpace());
 }
 
 void PageFile::deletePage(const PageId page_number) {
   FileHeader header = readHeader();
+  if (page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  PageHeader page_header = readPageHeader(page_number);
+  if (page_header.current_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, filename_);
+  }
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  // Link the pages before and after this one to each other, or the file
+  // header where this page was the first or the last one
+  if (page_header.prev_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = page_header.next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    PageHeader prev_header = readPageHeader(page_header.prev_page_number);
+    prev_header.next_page_number = page_header.next_page_number;
+    writePageHeader(page_header.prev_page_number, prev_header);
+  }
+  if (page_header.next_page_number == Page::INVALID_NUMBER) {
+    header.last_used_page = page_header.prev_page_number;
+  } else {
+    PageHeader next_header = readPageHeader(page_header.next_page_number);
+    next_header.prev_page_number = page_header.prev_page_number;
+    writePageHeader(page_header.next_page_number, next_header);
   }
+
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
+  Page free_page;
+  free_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
-  }
-  writePage(page_number, existing_page.header_, existing_page);
+  writePage(page_number, free_page.header_, free_page);
   writeHeader(header);
+  setFreeSpace(page_number, 0);
+}
+
+PageId PageFile::findPageWithSpace(const std::size_t bytes) {
+  // Every page of a bucket from the smallest one that guarantees the bytes
+  // has room; bucket 0 guarantees nothing
+  std::size_t bucket = (bytes + space_map_->bucket_bytes - 1) /
+                       space_map_->bucket_bytes;
+  for (bucket = std::max(bucket, (std::size_t)1);
+       bucket < FreeSpaceMap::NUM_BUCKETS; ++bucket) {
+    if (space_map_->first_in_bucket[bucket] != Page::INVALID_NUMBER) {
+      return space_map_->first_in_bucket[bucket];
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+void PageFile::updateFreeSpace(const PageId page_number, const Page& page) {
+  setFreeSpace(page_number, page.getFreeSpace());
 }
 
 FileIterator PageFile::begin() {
@@ -315,32 +427,147 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(&new_page.data_[0], Page::DATA_SIZE);
-  stream_->flush();
+  writeBytes(pagePosition(page_number), &header, sizeof(PageHeader),
+             &new_page.data_[0], page_size_ - sizeof(PageHeader));
+}
+
+void PageFile::writePageHeader(const PageId page_number,
+                               const PageHeader& header) {
+  writeBytes(pagePosition(page_number), &header, sizeof(PageHeader));
+}
+
+void PageFile::openSpaceMap(const bool create_new) {
+  // Held while the map is read, so that another object of the file waits for it
+  std::lock_guard<std::mutex> lock(open_mutex_);
+  std::weak_ptr<FreeSpaceMap>& open_map = open_space_maps_[filename_];
+  space_map_ = open_map.lock();
+  if (space_map_ && !create_new) {
+    return;
+  }
+
+  space_map_.reset(new FreeSpaceMap());
+  open_map = space_map_;
+  const std::size_t data_bytes = page_size_ - sizeof(PageHeader);
+  space_map_->bucket_bytes = (data_bytes + FreeSpaceMap::NUM_BUCKETS - 2) /
+                             (FreeSpaceMap::NUM_BUCKETS - 1);
+  space_map_->first_in_bucket.resize(FreeSpaceMap::NUM_BUCKETS,
+                                     PageId(Page::INVALID_NUMBER));
+  if (create_new) {
+    return;
+  }
+
+  // Each map page holds the buckets of the next data_bytes page numbers
+  std::vector<char> bytes(data_bytes);
+  for (PageId map_page = readHeader().first_map_page;
+       map_page != Page::INVALID_NUMBER;
+       map_page = readPageHeader(map_page).next_page_number) {
+    space_map_->map_pages.push_back(map_page);
+    readBytes(pagePosition(map_page) + sizeof(PageHeader), &bytes[0],
+              data_bytes);
+    space_map_->buckets.insert(space_map_->buckets.end(), bytes.begin(),
+                               bytes.end());
+  }
+  space_map_->resize(space_map_->buckets.size());
+  for (PageId page_number = 0; page_number < space_map_->buckets.size();
+       ++page_number) {
+    if (space_map_->buckets[page_number] > 0) {
+      space_map_->link(page_number);
+    }
+  }
+}
+
+void PageFile::extendSpaceMap(FileHeader& header) {
+  const std::size_t data_bytes = page_size_ - sizeof(PageHeader);
+  while (space_map_->buckets.size() < header.num_pages) {
+    // A map page is neither used nor free, and its buckets start out at 0
+    const PageId map_page = header.num_pages;
+    ++header.num_pages;
+    Page new_page;
+    writePage(map_page, new_page.header_, new_page);
+    if (space_map_->map_pages.empty()) {
+      header.first_map_page = map_page;
+    } else {
+      PageHeader last_header = readPageHeader(space_map_->map_pages.back());
+      last_header.next_page_number = map_page;
+      writePageHeader(space_map_->map_pages.back(), last_header);
+    }
+    space_map_->map_pages.push_back(map_page);
+    space_map_->resize(space_map_->buckets.size() + data_bytes);
+  }
+}
+
+void PageFile::setFreeSpace(const PageId page_number,
+                            const std::size_t free_bytes) {
+  const std::uint8_t bucket = std::min(
+      free_bytes / space_map_->bucket_bytes,
+      (std::size_t)FreeSpaceMap::NUM_BUCKETS - 1);
+  if (space_map_->buckets[page_number] == bucket) {
+    return;
+  }
+  if (space_map_->buckets[page_number] > 0) {
+    space_map_->unlink(page_number);
+  }
+  space_map_->buckets[page_number] = bucket;
+  if (bucket > 0) {
+    space_map_->link(page_number);
+  }
+
+  const std::size_t data_bytes = page_size_ - sizeof(PageHeader);
+  writeBytes(pagePosition(space_map_->map_pages[page_number / data_bytes]) +
+                 sizeof(PageHeader) + page_number % data_bytes,
+             &bucket, sizeof(bucket));
+}
+
+void FreeSpaceMap::link(const PageId page_number) {
+  PageId& first = first_in_bucket[buckets[page_number]];
+  prev_in_bucket[page_number] = Page::INVALID_NUMBER;
+  next_in_bucket[page_number] = first;
+  if (first != Page::INVALID_NUMBER) {
+    prev_in_bucket[first] = page_number;
+  }
+  first = page_number;
+}
+
+void FreeSpaceMap::unlink(const PageId page_number) {
+  const PageId next = next_in_bucket[page_number];
+  const PageId prev = prev_in_bucket[page_number];
+  if (prev == Page::INVALID_NUMBER) {
+    first_in_bucket[buckets[page_number]] = next;
+  } else {
+    next_in_bucket[prev] = next;
+  }
+  if (next != Page::INVALID_NUMBER) {
+    prev_in_bucket[next] = prev;
+  }
+}
+
+void FreeSpaceMap::resize(const std::size_t count) {
+  buckets.resize(count, 0);
+  next_in_bucket.resize(count, PageId(Page::INVALID_NUMBER));
+  prev_in_bucket.resize(count, PageId(Page::INVALID_NUMBER));
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readBytes(pagePosition(page_number), &header, sizeof(PageHeader));
   return header;
 }
 
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+BlobFile BlobFile::create(const std::string& filename,
+                       const std::size_t page_size) {
+  return BlobFile(filename, true /* create_new */, page_size);
 }
 
 BlobFile BlobFile::open(const std::string& filename) {
   return BlobFile(filename, false /* create_new */);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const std::size_t page_size)
+: File(name, create_new, page_size) {
 }
 
 BlobFile::~BlobFile() {
@@ -357,6 +584,7 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
   openIfNeeded(false /* create_new */);
+  page_size_ = rhs.page_size_;
   return *this;
 }
 
@@ -364,6 +592,17 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
   FileHeader header = readHeader();
 	Page new_page;
 
+  if (header.num_free_pages > 0) {
+    // The header drops the page before it is overwritten, so a crash in
+    // between loses the page rather than leaving it in use and in the list
+    new_page_number = header.first_free_page;
+    header.first_free_page = readPage(new_page_number).next_page_number();
+    --header.num_free_pages;
+    writeHeader(header);
+    writePage(new_page_number, new_page);
+    return new_page;
+  }
+
 	new_page_number = header.num_pages;
 
 	if (header.first_used_page == Page::INVALID_NUMBER) {
@@ -380,20 +619,87 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPageInto(page_number, &page);
 	return page;
 }
 
+void BlobFile::readPageInto(const PageId page_number, Page* page) const {
+	readBytes(pagePosition(page_number), page, page_size_);
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	writeBytes(pagePosition(new_page_number), &new_page, page_size_);
 }
 
-//delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
-	throw InvalidPageException(page_number, filename_);
+  FileHeader header = readHeader();
+  if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  if (isFreePage(page_number, header)) {
+    // Linking it again would hand it out twice
+    throw InvalidPageException(page_number, filename_);
+  }
+
+  // The page links to the old head of the list before the header points at
+  // it, so a crash in between loses the page rather than the rest of the list
+  Page free_page;
+  free_page.set_page_number(FREE_PAGE_MARK);
+  free_page.set_next_page_number(header.first_free_page);
+  free_page.header_.prev_page_number = page_number;
+  writePage(page_number, free_page);
+  header.first_free_page = page_number;
+  ++header.num_free_pages;
+  writeHeader(header);
+}
+
+bool BlobFile::isFreePage(const PageId page_number,
+                          const FileHeader& header) const {
+  PageHeader page_header;
+  readBytes(pagePosition(page_number), &page_header, sizeof(PageHeader));
+  if (page_header.current_page_number != FREE_PAGE_MARK ||
+      page_header.prev_page_number != page_number) {
+    return false;
+  }
+
+  PageId free_page_number = header.first_free_page;
+  for (PageId i = 0; i < header.num_free_pages; ++i) {
+    if (free_page_number == page_number) {
+      return true;
+    }
+    readBytes(pagePosition(free_page_number), &page_header, sizeof(PageHeader));
+    free_page_number = page_header.next_page_number;
+  }
+  return false;
+}
+
+PageId BlobFile::allocateExtent(const PageId count) {
+  FileHeader header = readHeader();
+  PageId first_page_number = header.num_pages;
+  if (header.first_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = first_page_number;
+  }
+  header.num_pages += count;
+
+  // Writing the last page extends the file over the pages before it
+  writePage(header.num_pages - 1, Page());
+  writeHeader(header);
+  return first_page_number;
+}
+
+void BlobFile::truncate(const PageId end_page_number) {
+  FileHeader header = readHeader();
+  header.num_free_pages = 0;
+  header.first_free_page = Page::INVALID_NUMBER;
+  if (end_page_number >= header.num_pages) {
+    writeHeader(header);
+    return;
+  }
+  header.num_pages = end_page_number;
+  writeHeader(header);
+  if (ftruncate(fd_, pagePosition(end_page_number)) != 0) {
+    throw FileIOException(filename_, "truncate", errno);
+  }
 }
 
 }
@@ -7,10 +7,14 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
 
 #include "page.h"
 
@@ -32,6 +36,11 @@ struct FileHeader {
    */
   PageId first_used_page;
 
+  /**
+   * Page number of the last used page in the file, where new pages are added.
+   */
+  PageId last_used_page;
+
   /**
    * Number of free pages (allocated but unused) in the file.
    */
@@ -42,6 +51,17 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Size in bytes of every page in the file, chosen when the file is created.
+   */
+  std::uint32_t page_size;
+
+  /**
+   * Page number of the first free space map page of a PageFile, 0 if it has
+   * none.
+   */
+  PageId first_map_page;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +72,10 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        last_used_page == rhs.last_used_page &&
+        first_free_page == rhs.first_free_page &&
+        page_size == rhs.page_size &&
+        first_map_page == rhs.first_map_page;
   }
 };
 
@@ -60,15 +83,23 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
+ * The File class wraps a descriptor of an underlying file on disk.  Files
+ * contain fixed-sized pages, whose size is chosen when the file is created and
+ * kept in its header, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_fds_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again.
+ *
+ * Every read and write of the file is a single positional pread or pwrite (or
+ * preadv or pwritev for a page header and its data), so it neither seeks nor
+ * depends on a position shared with the other objects of the file.
+ *
+ * Opening, closing and removing files may go on on several threads at once.
  *
- * @warning This class is not threadsafe.
+ * @warning Allocating and deleting pages is not threadsafe: they update the
+ *          file header without locking.
  */
 
 
@@ -80,12 +111,18 @@ class File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param page_size   Page size of a new file; an existing file keeps the page
+   *                    size it was created with.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  BadPageSizeException    If page_size is not between Page::MIN_SIZE
+   *                                  and Page::MAX_SIZE.
+   * @throws  FileIOException         If the file cannot be opened.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const std::size_t page_size = Page::SIZE);
 
   /**
    * Deletes an existing file.
@@ -134,6 +171,18 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file into the first pageSize() bytes of
+   * the given page, such as a buffer frame of that size.  The bytes after them
+   * are not touched.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read it into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPageInto(const PageId page_number, Page* page) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -150,6 +199,15 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Tells the operating system that the page will be read soon, so that it
+   * starts reading it into the page cache and returns without waiting.  This
+   * is only a hint: nothing is reported if the system ignores it.
+   *
+   * @param page_number   Number of page.
+   */
+  void adviseWillNeed(const PageId page_number) const;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -157,6 +215,30 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the size in bytes of the pages of this file.  Only this many bytes
+   * of a Page are stored on disk.
+   *
+   * @return Page size of file.
+   */
+  std::size_t pageSize() const { return page_size_; }
+
+  /**
+   * Returns the number of reads of the file made through this object, each a
+   * page, a page header or the file header, since it was constructed.
+   *
+   * @return Number of reads.
+   */
+  std::uint64_t numReads() const { return num_reads_; }
+
+  /**
+   * Returns the number of writes to the file made through this object, each a
+   * page, a page header or the file header, since it was constructed.
+   *
+   * @return Number of writes.
+   */
+  std::uint64_t numWrites() const { return num_writes_; }
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -172,25 +254,57 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  off_t pagePosition(const PageId page_number) const {
+    return sizeof(FileHeader) + ((off_t)(page_number - 1) * page_size_);
   }
 
+  /**
+   * Reads bytes of the file at the given position, followed by more bytes into
+   * a second buffer if there is one.  Bytes past the end of the file read as
+   * zeroes.
+   *
+   * @param position    Offset in the file of the first byte.
+   * @param bytes       Buffer for the first bytes.
+   * @param count       Number of bytes to read into bytes.
+   * @param more        Buffer for the bytes after them, or NULL.
+   * @param more_count  Number of bytes to read into more.
+   * @throws  FileIOException  If the read fails.
+   */
+  void readBytes(const off_t position, void* bytes, const std::size_t count,
+                 void* more = NULL, const std::size_t more_count = 0) const;
+
+  /**
+   * Writes bytes to the file at the given position, followed by the bytes of a
+   * second buffer if there is one.
+   *
+   * @param position    Offset in the file of the first byte.
+   * @param bytes       First bytes to write.
+   * @param count       Number of bytes in bytes.
+   * @param more        Bytes to write after them, or NULL.
+   * @param more_count  Number of bytes in more.
+   * @throws  FileIOException  If the write fails, e.g. on a full disk.
+   */
+  void writeBytes(const off_t position, const void* bytes,
+                  const std::size_t count, const void* more = NULL,
+                  const std::size_t more_count = 0);
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileIOException         If the file cannot be opened; no
+   *                                  descriptor is registered then.
    */
   void openIfNeeded(const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <fd_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
@@ -210,49 +324,155 @@ class File {
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  typedef std::map<std::string, int> DescriptorMap;
   typedef std::map<std::string, int> CountMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors of opened files.
    */
-  static StreamMap open_streams_;
+  static DescriptorMap open_fds_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Guards open_fds_, open_counts_ and the free space maps of opened PageFiles.
+   */
+  static std::mutex open_mutex_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of underlying filesystem object, -1 once closed.
+   */
+  int fd_;
+
+  /**
+   * Size in bytes of the pages of this file, as recorded in its header.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::size_t page_size_;
+
+  /**
+   * Reads and writes made through this object; readBytes() and writeBytes()
+   * count them.
+   */
+  mutable std::atomic<std::uint64_t> num_reads_;
+  std::atomic<std::uint64_t> num_writes_;
 
   friend class FileIterator;
 };
 
+/**
+ * @brief Free space of every page of a PageFile, as a bucket of one byte per
+ *        page.
+ *
+ * Bucket b means at least b * bucket_bytes free bytes.  The buckets are kept
+ * on dedicated map pages of the file and, while the file is open, in memory,
+ * shared by every PageFile object of the file like its descriptor.
+ */
+struct FreeSpaceMap {
+  /**
+   * Number of distinct buckets.
+   */
+  static const int NUM_BUCKETS = 256;
+
+  /**
+   * Free bytes each bucket step stands for.
+   */
+  std::size_t bucket_bytes;
+
+  /**
+   * Number of the map pages of the file, in the order they are chained.  Map
+   * page i holds the buckets of the pages numbered from i times the buckets a
+   * map page holds.
+   */
+  std::vector<PageId> map_pages;
+
+  /**
+   * Bucket of every page number of the file; 0 for the header, map pages and
+   * free pages.
+   */
+  std::vector<std::uint8_t> buckets;
+
+  /**
+   * For every bucket above 0, the first page of the doubly linked list of the
+   * pages in it, 0 if there is none.  Each page is in the list of its bucket
+   * only, so the lists hold at most one entry per page however often pages
+   * move between buckets.
+   */
+  std::vector<PageId> first_in_bucket;
+
+  /**
+   * Next page in the list of the bucket of every page number, 0 for the last.
+   */
+  std::vector<PageId> next_in_bucket;
+
+  /**
+   * Previous page in the list of the bucket of every page number, 0 for the
+   * first.
+   */
+  std::vector<PageId> prev_in_bucket;
+
+  /**
+   * Adds a page to the front of the list of its bucket, which must be above 0.
+   *
+   * @param page_number   Number of page.
+   */
+  void link(const PageId page_number);
+
+  /**
+   * Removes a page from the list of its bucket, which must be above 0.
+   *
+   * @param page_number   Number of page.
+   */
+  void unlink(const PageId page_number);
+
+  /**
+   * Makes room for the pages numbered below count, with bucket 0.
+   *
+   * @param count   Number of page numbers covered.
+   */
+  void resize(const std::size_t count);
+};
+
+/**
+ * @brief File of slotted pages holding records.
+ *
+ * The used pages form a doubly linked list through their page headers, with
+ * its head and tail in the file header, and deleted pages a free list.  New
+ * pages, including reused ones, go to the tail, so pages are iterated in the
+ * order they were allocated, and allocating or deleting a page reads and
+ * writes a constant number of pages.
+ *
+ * Every write of a page records its free space in a FreeSpaceMap, so that
+ * records can be placed on a page with room without walking the pages.
+ */
 class PageFile : public File {
  public:
 
   /**
    * Creates a new file.
    *
-   * @param filename  Name of the file.
+   * @param filename   Name of the file.
+   * @param page_size  Size in bytes of the pages of the file.
    * @throws  FileExistsException     If the requested file already exists.
+   * @throws  BadPageSizeException    If page_size is not between Page::MIN_SIZE
+   *                                  and Page::MAX_SIZE.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename,
+                       const std::size_t page_size = Page::SIZE);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_fds_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -264,12 +484,14 @@ class PageFile : public File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param page_size   Page size of a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const std::size_t page_size = Page::SIZE);
 
   /**
    * Copy constructor.
@@ -294,7 +516,8 @@ class PageFile : public File {
   ~PageFile();
 
   /**
-   * Allocates a new page in the file.
+   * Allocates a new page in the file, the last deleted page if there is one,
+   * and adds it to the end of the used pages.
    *
    * @return The new page.
    */
@@ -310,6 +533,17 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file into the first pageSize() bytes of
+   * the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read it into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page* page) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -320,12 +554,33 @@ class PageFile : public File {
   void writePage(const PageId page_number, const Page& new_page) override;
 
   /**
-   * Deletes a page from the file.
+   * Deletes a page from the file, unlinking it from the pages before and
+   * after it.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
    */
   void deletePage(const PageId page_number) override;
 
+  /**
+   * Finds a used page with at least the given number of free bytes, as of the
+   * last time the page was written to the file or its free space was updated.
+   *
+   * @param bytes   Number of free bytes needed.
+   * @return  Number of such page, or Page::INVALID_NUMBER if there is none.
+   */
+  PageId findPageWithSpace(const std::size_t bytes);
+
+  /**
+   * Records the free space of a page changed in a buffer pool, so that
+   * findPageWithSpace sees it before the page is written back.
+   *
+   * @param page_number   Number of page.
+   * @param page          Page as it is in the buffer pool.
+   */
+  void updateFreeSpace(const PageId page_number, const Page& page);
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -347,8 +602,8 @@ class PageFile : public File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zeroes, which makes it a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -379,26 +634,86 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk.  No bounds checking is
+   * performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Points space_map_ at the free space map shared by the open PageFile
+   * objects of this file, reading it from the map pages if there is none yet.
+   *
+   * @param create_new  Whether the file has just been created.
+   */
+  void openSpaceMap(const bool create_new);
+
+  /**
+   * Adds map pages at the end of the file until the map covers every page of
+   * the file.  The caller writes the header.
+   *
+   * @param header  Header of the file, updated with the map pages added.
+   */
+  void extendSpaceMap(FileHeader& header);
+
+  /**
+   * Records the free space of a page in the map, in memory and on its map
+   * page.
+   *
+   * @param page_number   Number of page.
+   * @param free_bytes    Free bytes on the page.
+   */
+  void setFreeSpace(const PageId page_number, const std::size_t free_bytes);
+
+  typedef std::map<std::string, std::weak_ptr<FreeSpaceMap> > SpaceMapMap;
+
+  /**
+   * Free space maps of opened files.
+   */
+  static SpaceMapMap open_space_maps_;
+
+  /**
+   * Free space map of this file.
+   */
+  std::shared_ptr<FreeSpaceMap> space_map_;
+
   friend class FileIterator;
 };
 
+/**
+ * @brief File of raw pages, such as an index file, whose contents belong to
+ *        the caller.
+ *
+ * Deleted pages are kept in a free list in the file: the header holds the
+ * first of them and the page header of each the next one, so that both
+ * allocating and deleting a page take constant time.  The page header of a
+ * free page also carries a mark, so that deleting it again is caught; the
+ * list is only walked to confirm a page that carries the mark.
+ */
 class BlobFile : public File {
  public:
 
   /**
    * Creates a new BlobFile.
    *
-   * @param filename  Name of the file.
+   * @param filename   Name of the file.
+   * @param page_size  Size in bytes of the pages of the file.
    * @throws  FileExistsException     If the requested file already exists.
+   * @throws  BadPageSizeException    If page_size is not between Page::MIN_SIZE
+   *                                  and Page::MAX_SIZE.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename,
+                       const std::size_t page_size = Page::SIZE);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_fds_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -412,12 +727,14 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param page_size   Page size of a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const std::size_t page_size = Page::SIZE);
 
   /**
    * Copy constructor.
@@ -442,7 +759,7 @@ class BlobFile : public File {
   ~BlobFile();
 
   /**
-   * Allocates a new page in the file.
+   * Allocates a new page in the file, the last deleted page if there is one.
    *
    * @return The new page.
    */
@@ -458,6 +775,17 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file into the first pageSize() bytes of
+   * the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read it into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page* page) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -468,11 +796,60 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page) override;
 
   /**
-   * Deletes a page from the file.
+   * Deletes a page from the file by adding it to the free list, from which
+   * allocatePage() takes it again.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                already free.
    */
   void deletePage(const PageId page_number) override;
+
+  /**
+   * Returns the number of deleted pages waiting in the free list.
+   *
+   * @return  Number of free pages.
+   */
+  PageId numFreePages() const { return readHeader().num_free_pages; }
+
+  /**
+   * Drops the pages numbered end_page_number and above, empties the free list
+   * and shrinks the file on disk.  Meant for callers that have rewritten
+   * every page they use below end_page_number; the caller must make sure none
+   * of the dropped pages is still in a buffer pool.
+   *
+   * @param end_page_number   Number of the first page to drop.
+   * @throws  FileIOException  If the file cannot be shrunk.
+   */
+  void truncate(const PageId end_page_number);
+
+  /**
+   * Allocates count pages at the end of the file at once, with a single write
+   * of the header.  The pages are empty and numbered consecutively; the caller
+   * hands them out, so they are not written here one by one.
+   *
+   * @param count   Number of pages to allocate.
+   * @return  Number of the first page.
+   */
+  PageId allocateExtent(const PageId count);
+
+ private:
+  /**
+   * Page number a free page keeps in its current page number, with its own
+   * number as the previous page number.
+   */
+  static const PageId FREE_PAGE_MARK = 0xFFFFFFFF;
+
+  /**
+   * Returns true if the page is in the free list.  Only a page carrying the
+   * free page mark is looked for in the list, since the caller's data on a
+   * used page may happen to look like the mark.
+   *
+   * @param page_number   Number of page.
+   * @param header        Header of the file.
+   * @return  True if the page is free.
+   */
+  bool isFreePage(const PageId page_number, const FileHeader& header) const;
 };
 
 }
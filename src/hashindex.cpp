@@ -0,0 +1,410 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include "hashindex.h"
+#include "filescan.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/end_of_file_exception.h"
+
+namespace badgerdb {
+
+// murmur3 finalizer, so that keys differing only in high bits still spread over the low bits
+// that pick the bucket
+static std::uint32_t hashKey(const int key)
+{
+	std::uint32_t h = (std::uint32_t)key;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::HashIndex -- Constructor
+// -----------------------------------------------------------------------------
+
+HashIndex::HashIndex(const std::string & relationName, std::string & outIndexName,
+		BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType, const int pageSize)
+{
+	if(attrType != INTEGER){
+		throw BadIndexInfoException("Hash indexes need an INTEGER attribute");
+	}
+
+	this->bufMgr = bufMgrIn;
+	this->attrByteOffset = attrByteOffset;
+	this->pagesRead = 0;
+
+	std::ostringstream idxStr;
+	idxStr << relationName << '.' << attrByteOffset << ".hash";
+	std::string indexName = idxStr.str();
+	outIndexName = indexName;
+
+	try{
+		// File Exists: read the meta page and the bucket page table
+		file = new BlobFile(indexName, false);
+		bucketOccupancy = HashBucket::capacity(file->pageSize());
+
+		Page *headerPage;
+		headerPageNum = file->getFirstPageNo();
+		bufMgr->readPage(file, headerPageNum, headerPage);
+		HashIndexMetaInfo *metaInfo = (HashIndexMetaInfo *) headerPage;
+		bool matches = strcmp(metaInfo->relationName, relationName.c_str()) == 0
+			&& metaInfo->attrByteOffset == attrByteOffset && metaInfo->attrType == attrType;
+		level = metaInfo->level;
+		nextSplit = metaInfo->nextSplit;
+		numEntries = metaInfo->numEntries;
+		freePageNo = metaInfo->freePageNo;
+		bufMgr->unPinPage(file, headerPageNum, false);
+
+		if(!matches){
+			delete file;
+			throw BadIndexInfoException("Hash index is on another relation or attribute");
+		}
+		readTable();
+
+	}catch(const FileNotFoundException &e){
+		// File Does Not Exist: one empty bucket, then every tuple of the relation
+		file = new BlobFile(indexName, true, pageSize);
+		bucketOccupancy = HashBucket::capacity(file->pageSize());
+		level = 0;
+		nextSplit = 0;
+		numEntries = 0;
+		freePageNo = 0;
+
+		headerPageNum = 0;
+		Page *headerPage;
+		bufMgr->allocPage(file, headerPageNum, headerPage);
+		HashIndexMetaInfo *metaInfo = (HashIndexMetaInfo *) headerPage;
+		strcpy(metaInfo->relationName, relationName.c_str());
+		metaInfo->attrByteOffset = attrByteOffset;
+		metaInfo->attrType = attrType;
+		metaInfo->tablePageNo = 0;
+		bufMgr->unPinPage(file, headerPageNum, true);
+
+		PageId bucketPageNo;
+		Page *bucketPage;
+		newBucketPage(bucketPageNo, bucketPage);
+		bufMgr->unPinPage(file, bucketPageNo, true);
+		bucketPages.push_back(bucketPageNo);
+
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				std::string recordStr = fscan.getRecord();
+				insertEntry(recordStr.c_str() + attrByteOffset, scanRid);
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		writeTable();
+		bufMgr->flushFile(file);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::~HashIndex -- destructor
+// -----------------------------------------------------------------------------
+
+HashIndex::~HashIndex()
+{
+	writeTable();
+	bufMgr->flushFile(file);
+	delete file;
+}
+
+int HashIndex::bucketOf(const int key) const
+{
+	std::uint32_t h = hashKey(key);
+	std::uint32_t bucket = h & ((1u << level) - 1);
+	if((int)bucket < nextSplit){
+		bucket = h & ((2u << level) - 1);
+	}
+	return bucket;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void HashIndex::insertEntry(const void *key, const RecordId rid)
+{
+	addToBucket(bucketOf(*(const int *)key), *(const int *)key, rid);
+	numEntries++;
+
+	if((long long)numEntries * 100 > (long long)HASHFILLPERCENT * (long long)bucketPages.size() * bucketOccupancy){
+		splitBucket();
+	}
+}
+
+void HashIndex::addToBucket(const int bucket, const int key, const RecordId rid)
+{
+	PageId pageNo = bucketPages[bucket];
+	while(true){
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		HashBucket node(page, bucketOccupancy);
+		if(node.numEntries < bucketOccupancy){
+			node.keyArray[node.numEntries] = key;
+			node.ridArray[node.numEntries] = rid;
+			node.numEntries++;
+			bufMgr->unPinPage(file, pageNo, true);
+			return;
+		}
+
+		// Full, go on to the overflow page, adding one at the end of the chain
+		PageId nextPageNo = node.overflowPageNo;
+		bool dirty = false;
+		if(nextPageNo == 0){
+			Page *nextPage;
+			newBucketPage(nextPageNo, nextPage);
+			bufMgr->unPinPage(file, nextPageNo, true);
+			node.overflowPageNo = nextPageNo;
+			dirty = true;
+		}
+		bufMgr->unPinPage(file, pageNo, dirty);
+		pageNo = nextPageNo;
+	}
+}
+
+void HashIndex::newBucketPage(PageId &pageNo, Page *&page)
+{
+	if(freePageNo != 0){
+		pageNo = freePageNo;
+		bufMgr->readPage(file, pageNo, page);
+		freePageNo = HashBucket(page, bucketOccupancy).overflowPageNo;
+	}else{
+		bufMgr->allocPage(file, pageNo, page);
+	}
+	HashBucket node(page, bucketOccupancy);
+	node.numEntries = 0;
+	node.overflowPageNo = 0;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::splitBucket
+// -----------------------------------------------------------------------------
+
+void HashIndex::splitBucket()
+{
+	int bucket = nextSplit;
+
+	// Entries and pages of the bucket being split
+	std::vector<PageId> chain;
+	std::vector<int> keys;
+	std::vector<RecordId> rids;
+	for(PageId pageNo = bucketPages[bucket]; pageNo != 0; ){
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		HashBucket node(page, bucketOccupancy);
+		keys.insert(keys.end(), node.keyArray, node.keyArray + node.numEntries);
+		rids.insert(rids.end(), node.ridArray, node.ridArray + node.numEntries);
+		chain.push_back(pageNo);
+		PageId nextPageNo = node.overflowPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+
+	PageId newPageNo;
+	Page *newPage;
+	newBucketPage(newPageNo, newPage);
+	bufMgr->unPinPage(file, newPageNo, true);
+	bucketPages.push_back(newPageNo);
+
+	nextSplit++;
+	if(nextSplit == (1 << level)){
+		level++;
+		nextSplit = 0;
+	}
+
+	// With one more hash bit the entries either stay or go to the new bucket
+	std::vector<int> stayKeys;
+	std::vector<RecordId> stayRids;
+	for(size_t i = 0; i < keys.size(); i++){
+		if(bucketOf(keys[i]) == bucket){
+			stayKeys.push_back(keys[i]);
+			stayRids.push_back(rids[i]);
+		}else{
+			addToBucket(bucketPages.size() - 1, keys[i], rids[i]);
+		}
+	}
+
+	// Refill the chain from the front; overflow pages left empty go to the free chain
+	size_t next = 0;
+	for(size_t c = 0; c < chain.size(); c++){
+		Page *page;
+		bufMgr->readPage(file, chain[c], page);
+		HashBucket node(page, bucketOccupancy);
+		if(c > 0 && next == stayKeys.size()){
+			node.numEntries = 0;
+			node.overflowPageNo = freePageNo;
+			freePageNo = chain[c];
+		}else{
+			int n = std::min((size_t)bucketOccupancy, stayKeys.size() - next);
+			std::copy(stayKeys.begin() + next, stayKeys.begin() + next + n, node.keyArray);
+			std::copy(stayRids.begin() + next, stayRids.begin() + next + n, node.ridArray);
+			node.numEntries = n;
+			next += n;
+			if(next == stayKeys.size()){
+				node.overflowPageNo = 0;
+			}
+		}
+		bufMgr->unPinPage(file, chain[c], true);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+bool HashIndex::deleteEntry(const void *key, const RecordId rid)
+{
+	int k = *(const int *)key;
+	for(PageId pageNo = bucketPages[bucketOf(k)]; pageNo != 0; ){
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		HashBucket node(page, bucketOccupancy);
+		for(int i = 0; i < node.numEntries; i++){
+			if(node.keyArray[i] == k && node.ridArray[i].page_number == rid.page_number
+				&& node.ridArray[i].slot_number == rid.slot_number){
+				node.numEntries--;
+				node.keyArray[i] = node.keyArray[node.numEntries];
+				node.ridArray[i] = node.ridArray[node.numEntries];
+				bufMgr->unPinPage(file, pageNo, true);
+				numEntries--;
+				return true;
+			}
+		}
+		PageId nextPageNo = node.overflowPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::lookup
+// -----------------------------------------------------------------------------
+
+bool HashIndex::lookup(const void *key, RecordId &outRid)
+{
+	int k = *(const int *)key;
+	for(PageId pageNo = bucketPages[bucketOf(k)]; pageNo != 0; ){
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		pagesRead++;
+		HashBucket node(page, bucketOccupancy);
+		for(int i = 0; i < node.numEntries; i++){
+			if(node.keyArray[i] == k){
+				outRid = node.ridArray[i];
+				bufMgr->unPinPage(file, pageNo, false);
+				return true;
+			}
+		}
+		PageId nextPageNo = node.overflowPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+	return false;
+}
+
+void HashIndex::lookupAll(const void *key, std::vector<RecordId> &outRids)
+{
+	int k = *(const int *)key;
+	for(PageId pageNo = bucketPages[bucketOf(k)]; pageNo != 0; ){
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		pagesRead++;
+		HashBucket node(page, bucketOccupancy);
+		for(int i = 0; i < node.numEntries; i++){
+			if(node.keyArray[i] == k){
+				outRids.push_back(node.ridArray[i]);
+			}
+		}
+		PageId nextPageNo = node.overflowPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::readTable / writeTable
+// -----------------------------------------------------------------------------
+
+void HashIndex::readTable()
+{
+	Page *headerPage;
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	HashIndexMetaInfo *metaInfo = (HashIndexMetaInfo *) headerPage;
+	PageId pageNo = metaInfo->tablePageNo;
+	int numBuckets = metaInfo->numBuckets;
+	bufMgr->unPinPage(file, headerPageNum, false);
+
+	bucketPages.clear();
+	while((int)bucketPages.size() < numBuckets){
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		HashTablePage *table = (HashTablePage *) page;
+		PageId *pageNos = (PageId *)((char *)page + sizeof(HashTablePage));
+		bucketPages.insert(bucketPages.end(), pageNos, pageNos + table->numPageNos);
+		PageId nextPageNo = table->nextPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+}
+
+void HashIndex::writeTable()
+{
+	Page *headerPage;
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	HashIndexMetaInfo *metaInfo = (HashIndexMetaInfo *) headerPage;
+	metaInfo->level = level;
+	metaInfo->nextSplit = nextSplit;
+	metaInfo->numBuckets = bucketPages.size();
+	metaInfo->numEntries = numEntries;
+	metaInfo->freePageNo = freePageNo;
+
+	// Walk the chain from the meta page, keeping the previous page pinned until it is linked
+	const size_t perPage = (file->pageSize() - sizeof(HashTablePage)) / sizeof(PageId);
+	PageId *link = &metaInfo->tablePageNo;
+	PageId prevPageNo = headerPageNum;
+	size_t done = 0;
+	while(done < bucketPages.size()){
+		PageId pageNo = *link;
+		Page *page;
+		if(pageNo == 0){
+			bufMgr->allocPage(file, pageNo, page);
+			((HashTablePage *) page)->nextPageNo = 0;
+			*link = pageNo;
+		}else{
+			bufMgr->readPage(file, pageNo, page);
+		}
+		bufMgr->unPinPage(file, prevPageNo, true);
+
+		HashTablePage *table = (HashTablePage *) page;
+		size_t n = std::min(perPage, bucketPages.size() - done);
+		table->numPageNos = n;
+		memcpy((char *)page + sizeof(HashTablePage), &bucketPages[done], n * sizeof(PageId));
+		done += n;
+
+		link = &table->nextPageNo;
+		prevPageNo = pageNo;
+	}
+	bufMgr->unPinPage(file, prevPageNo, true);
+}
+
+}
@@ -0,0 +1,318 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Percentage of the entry slots of the primary bucket pages a HashIndex fills before it
+ * splits the next bucket.
+ */
+const  int HASHFILLPERCENT = 75;
+
+/**
+ * @brief The meta page, always the first page of a hash index file, is cast to this structure.
+ * The bucket page table follows in a chain of HashTablePage pages, and overflow pages that
+ * splits have emptied are kept in a free chain for later overflows.
+ */
+struct HashIndexMetaInfo{
+  /**
+   * Name of base relation.
+   */
+	char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in pages.
+   */
+	int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+	Datatype attrType;
+
+  /**
+   * Number of hash bits of the buckets not split in the current round.
+   */
+	int level;
+
+  /**
+   * Bucket split next. Buckets below it already use level + 1 hash bits.
+   */
+	int nextSplit;
+
+  /**
+   * Number of buckets, 2^level + nextSplit.
+   */
+	int numBuckets;
+
+  /**
+   * Number of entries in the index.
+   */
+	int numEntries;
+
+  /**
+   * First page of the bucket page table, 0 if none has been written.
+   */
+	PageId tablePageNo;
+
+  /**
+   * First free overflow page, 0 if none.
+   */
+	PageId freePageNo;
+};
+
+/**
+ * @brief One page of the chain holding the primary page number of every bucket, in bucket order.
+ * The page numbers of the page fill the rest of it.
+ */
+struct HashTablePage{
+  /**
+   * Next page of the chain, 0 for the last one.
+   */
+	PageId nextPageNo;
+
+  /**
+   * Number of page numbers in this page.
+   */
+	int numPageNos;
+};
+
+/**
+ * @brief Structure for the primary and overflow pages of a bucket. The entry count and the next
+ * overflow page come first, followed by capacity keys and capacity RecordIds. Entries are kept
+ * unordered; a delete moves the last entry of the page into the hole.
+ */
+struct HashBucket{
+  /**
+   * @param page			Page holding the bucket
+   * @param capacity	Number of entry slots, see HashBucket::capacity()
+   */
+	HashBucket( Page *page, const int capacity )
+		: numEntries( *(int *)page ),
+		  overflowPageNo( *( (PageId *)page + 1 ) ),
+		  keyArray( (int *)page + 2 ),
+		  ridArray( (RecordId *)( keyArray + capacity ) ) {}
+
+	//                                                            count, overflow ptr        key          rid
+	static int capacity( const std::size_t pageSize ){ return ( pageSize - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) ); }
+
+  /**
+   * Number of entries in the page.
+   */
+	int &numEntries;
+
+  /**
+   * Next overflow page of the bucket, 0 if none.
+   */
+	PageId &overflowPageNo;
+
+  /**
+   * Stores keys.
+   */
+	int *keyArray;
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId *ridArray;
+};
+
+/**
+ * @brief HashIndex class. It implements a disk-based linear hash index on a single INTEGER
+ * attribute of a relation, for equality lookups.
+ *
+ * A key goes to bucket hash mod 2^level, or mod 2^(level + 1) if that bucket has already been
+ * split in the current round. Whenever the primary pages are more than HASHFILLPERCENT full the
+ * bucket nextSplit is split into itself and a new bucket at the end, so the address space doubles
+ * one bucket at a time and no insert rewrites more than one bucket. The primary page number of
+ * every bucket is kept in memory while the index is open, so a probe reads the bucket page and
+ * only its overflow pages after that.
+ */
+class HashIndex
+{
+ public:
+
+  /**
+   * HashIndex Constructor.
+	 * Check to see if the corresponding index file exists. If so, open the file.
+	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * The index name is the relation name followed by the attribute offset and ".hash", e.g. "relA.0.hash".
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+   * @param attrType						Datatype of attribute over which index is built
+   * @param pageSize						Page size of a new index file. An existing index keeps its own page size.
+   * @throws  BadIndexInfoException If attrType is not INTEGER, or an existing index file is on another attribute
+   * @throws  BadPageSizeException If a new index file cannot have pages of pageSize bytes
+   */
+	HashIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const int pageSize = Page::SIZE);
+
+  /**
+   * HashIndex Destructor.
+	 * Write the bucket page table and the meta page, flush the index file and close it.
+	 */
+	~HashIndex();
+
+  /**
+	 * Insert a new entry using the pair <value,rid>, splitting the next bucket if the index
+	 * has grown past HASHFILLPERCENT.
+   * @param key			Key to insert, pointer to integer
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+	**/
+	void insertEntry(const void* key, const RecordId rid);
+
+  /**
+	 * Remove the entry <value,rid>. Buckets are not merged again.
+   * @param key			Key of the entry, pointer to integer
+   * @param rid			Record ID of the entry
+   * @return true if the entry was in the index
+	**/
+	bool deleteEntry(const void* key, const RecordId rid);
+
+  /**
+	 * Find an entry with the given key.
+   * @param key			Key to look up, pointer to integer
+   * @param outRid	RecordId of the entry returned in this, if there is one
+   * @return true if the index holds an entry with the key
+	**/
+	bool lookup(const void* key, RecordId &outRid);
+
+  /**
+	 * Find every entry with the given key.
+   * @param key			Key to look up, pointer to integer
+   * @param outRids	RecordIds of the entries appended to this
+	**/
+	void lookupAll(const void* key, std::vector<RecordId> &outRids);
+
+  /**
+	 * Number of buckets.
+	**/
+	int getNumBuckets() const { return bucketPages.size(); }
+
+  /**
+	 * Number of entries in the index.
+	**/
+	int getNumEntries() const { return numEntries; }
+
+  /**
+	 * Number of bucket pages read by lookups so far.
+	**/
+	int getPagesRead() const { return pagesRead; }
+
+ private:
+
+  /**
+   * Bucket of a key under the current level and split pointer.
+   * @param key			Key to hash
+   */
+	int bucketOf(const int key) const;
+
+  /**
+   * Splits bucket nextSplit into itself and a new last bucket, moving the entries whose next
+   * hash bit is set, and advances the split pointer.
+   */
+	void splitBucket();
+
+  /**
+   * Appends an entry to a bucket, at the end of its chain.
+   * @param bucket	Bucket to add to
+   * @param key			Key of the entry
+   * @param rid			Record ID of the entry
+   */
+	void addToBucket(const int bucket, const int key, const RecordId rid);
+
+  /**
+   * Returns an empty page for an overflow page or a new bucket, from the free chain if possible.
+   * The page is pinned.
+   * @param pageNo	Page number of the page returned in this
+   * @param page		Page returned in this
+   */
+	void newBucketPage(PageId &pageNo, Page *&page);
+
+  /**
+   * Reads the bucket page table from its chain of pages into bucketPages.
+   */
+	void readTable();
+
+  /**
+   * Writes the split state to the meta page and bucketPages to the chain of table pages,
+   * reusing the pages already in it.
+   */
+	void writeTable();
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Number of entry slots in a bucket page, depending on the page size of the index file.
+   */
+	int			bucketOccupancy;
+
+  /**
+   * Number of hash bits of the buckets not split in the current round.
+   */
+	int			level;
+
+  /**
+   * Bucket split next.
+   */
+	int			nextSplit;
+
+  /**
+   * Number of entries in the index.
+   */
+	int			numEntries;
+
+  /**
+   * First free overflow page, 0 if none.
+   */
+	PageId	freePageNo;
+
+  /**
+   * Primary page number of every bucket.
+   */
+	std::vector<PageId> bucketPages;
+
+  /**
+   * Number of bucket pages read by lookups so far.
+   */
+	int			pagesRead;
+};
+
+}
@@ -0,0 +1,175 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "heapfetch.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+namespace badgerdb {
+
+// order records by page, then by slot within the page
+static bool ridLess(const RecordId& a, const RecordId& b)
+{
+	if (a.page_number != b.page_number)
+	{
+		return a.page_number < b.page_number;
+	}
+	return a.slot_number < b.slot_number;
+}
+
+HeapFetch::HeapFetch(const std::string &name, BufMgr *bufferMgr)
+{
+  file = new PageFile(name, false);	//dont create new file
+	bufMgr = bufferMgr;
+  curPage = NULL;
+	curPageNum = 0;
+	nextRid = 0;
+	sorted = false;
+	pagesRead = 0;
+}
+
+HeapFetch::~HeapFetch()
+{
+	releasePage();
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void HeapFetch::addRid(const RecordId& rid)
+{
+	rids.push_back(rid);
+}
+
+void HeapFetch::addScan(BTreeIndex *index)
+{
+	RecordId scanRid;
+	try
+	{
+		while(1)
+		{
+			index->scanNext(scanRid);
+			rids.push_back(scanRid);
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index->endScan();
+}
+
+void HeapFetch::scanNext(RecordId& outRid)
+{
+	if (!sorted)
+	{
+		std::sort(rids.begin(), rids.end(), ridLess);
+		sorted = true;
+	}
+
+	if (nextRid >= rids.size())
+	{
+		releasePage();
+		throw EndOfFileException();
+	}
+
+	outRid = rids[nextRid++];
+
+	// neighbours in the sorted list share pages, so only switch when the page changes
+	if (curPage == NULL || curPageNum != outRid.page_number)
+	{
+		releasePage();
+		bufMgr->readPage(file, outRid.page_number, curPage);
+		curPageNum = outRid.page_number;
+		pagesRead++;
+	}
+}
+
+// returns the current record, whose page stays pinned until
+// the fetch moves on to another page
+std::string HeapFetch::getRecord()
+{
+	return curPage->getRecord(rids[nextRid - 1]);
+}
+
+int HeapFetch::getPagesRead() const
+{
+	return pagesRead;
+}
+
+void HeapFetch::releasePage()
+{
+	if (curPage != NULL)
+	{
+		bufMgr->unPinPage(file, curPageNum, false);
+		curPage = NULL;
+	}
+}
+
+PrefetchScan::PrefetchScan(const std::string &name, BufMgr *bufferMgr, BTreeIndex *scanIndex, const int readAhead)
+{
+  file = new PageFile(name, false);	//dont create new file
+	bufMgr = bufferMgr;
+	index = scanIndex;
+	depth = readAhead < 1 ? 1 : readAhead;
+	indexDone = false;
+  curPage = NULL;
+}
+
+PrefetchScan::~PrefetchScan()
+{
+	releasePage();
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void PrefetchScan::scanNext(RecordId& outRid)
+{
+	// top up the window, prefetching the page of every record entering it
+	while (!indexDone && (int)window.size() < depth)
+	{
+		RecordId scanRid;
+		try
+		{
+			index->scanNext(scanRid);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			indexDone = true;
+			break;
+		}
+		window.push_back(scanRid);
+		bufMgr->prefetchPage(file, scanRid.page_number);
+	}
+
+	releasePage();
+	if (window.empty())
+	{
+		throw IndexScanCompletedException();
+	}
+
+	curRid = window.front();
+	window.pop_front();
+	bufMgr->readPage(file, curRid.page_number, curPage);
+	outRid = curRid;
+}
+
+// returns the current record, whose page stays pinned until the next scanNext
+std::string PrefetchScan::getRecord()
+{
+	return curPage->getRecord(curRid);
+}
+
+void PrefetchScan::releasePage()
+{
+	if (curPage != NULL)
+	{
+		bufMgr->unPinPage(file, curRid.page_number, false);
+		curPage = NULL;
+	}
+}
+
+}
@@ -0,0 +1,186 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include "types.h"
+#include "page.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief This class fetches a set of records of a relation in page order.
+ *
+ * RecordIds are collected first, from an index scan or one at a time, and then sorted by
+ * page number so that every heap page holding a result is read once, front to back,
+ * instead of once per record in key order.
+ */
+class HeapFetch
+{
+ public:
+
+  HeapFetch(const std::string &name, BufMgr *bufMgr);
+
+  ~HeapFetch();
+
+  /**
+   * Add a record to fetch. All records have to be added before the first call to scanNext.
+   * @param rid	RecordId of the record
+   */
+  void addRid(const RecordId& rid);
+
+  /**
+   * Add every record returned by a scan already started on the index, then end that scan.
+   * @param index	Index on this relation with a scan in progress
+   * @throws ScanNotInitializedException If no scan has been initialized on the index.
+   */
+  void addScan(BTreeIndex *index);
+
+  //return RecordId of next record, in page order
+  void scanNext(RecordId& outRid);
+
+  //read current record, returning pointer and length
+  std::string getRecord();
+
+  /**
+   * Number of heap pages read by the fetch so far.
+   */
+  int getPagesRead() const;
+
+ private:
+  /**
+   * Release the heap page currently pinned, if any.
+   */
+  void releasePage();
+
+  /**
+   * File whose records are fetched.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read/write pages into/from buffer pool.
+   */
+	BufMgr				*bufMgr;
+
+  /**
+   * Current page being read, NULL if none is pinned.
+   */
+  Page*         curPage;
+
+  /**
+   * Page number of curPage.
+   */
+  PageId        curPageNum;
+
+  /**
+   * Records to fetch, sorted on the first call to scanNext.
+   */
+  std::vector<RecordId> rids;
+
+  /**
+   * Index into rids of the next record to return.
+   */
+  std::size_t   nextRid;
+
+  /**
+   * True once rids has been sorted and fetching has started.
+   */
+  bool          sorted;
+
+  /**
+   * Number of heap pages read so far.
+   */
+  int           pagesRead;
+};
+
+/**
+ * @brief This class fetches the records of an index scan in key order, reading ahead.
+ *
+ * The next depth RecordIds of the scan are kept in a window and the operating system is asked
+ * to read their heap pages as they enter it, so the reads of the window overlap and the page
+ * of a record is usually in the page cache when the consumer gets to it. The prefetches take
+ * no buffer pool frames. BufStats counts prefetch hits and prefetches never read.
+ */
+class PrefetchScan
+{
+ public:
+
+  /**
+   * @param name	Name of the relation the index is on
+   * @param bufMgr	Buffer Manager instance
+   * @param index	Index on this relation with a scan in progress. The caller ends that scan.
+   * @param depth	Number of RecordIds to read ahead of the consumer
+   */
+  PrefetchScan(const std::string &name, BufMgr *bufMgr, BTreeIndex *index, const int depth);
+
+  ~PrefetchScan();
+
+  /**
+   * Return the next record of the index scan. Its page stays pinned until the next call.
+   * @param outRid	RecordId of next record of the scan returned in this
+	 * @throws IndexScanCompletedException If the index scan has no more records.
+   */
+  void scanNext(RecordId& outRid);
+
+  //read current record, returning pointer and length
+  std::string getRecord();
+
+ private:
+  /**
+   * Release the heap page currently pinned, if any.
+   */
+  void releasePage();
+
+  /**
+   * File whose records are fetched.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read/write pages into/from buffer pool.
+   */
+	BufMgr				*bufMgr;
+
+  /**
+   * Index whose scan produces the RecordIds.
+   */
+  BTreeIndex    *index;
+
+  /**
+   * Maximum number of RecordIds in the window.
+   */
+  int           depth;
+
+  /**
+   * RecordIds read from the index but not yet returned, in scan order.
+   */
+  std::deque<RecordId> window;
+
+  /**
+   * True once the index scan has no more entries.
+   */
+  bool          indexDone;
+
+  /**
+   * Current page being read, NULL if none is pinned.
+   */
+  Page*         curPage;
+
+  /**
+   * RecordId last returned by scanNext.
+   */
+  RecordId      curRid;
+};
+
+}
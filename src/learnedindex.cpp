@@ -0,0 +1,284 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "learnedindex.h"
+#include "exceptions/bad_index_info_exception.h"
+
+namespace badgerdb {
+
+// append the bytes of count values to a sidecar image
+template <class T>
+static void appendBytes(std::vector<char> &bytes, const T *values, const size_t count)
+{
+	const char *begin = (const char *)values;
+	bytes.insert(bytes.end(), begin, begin + count * sizeof(T));
+}
+
+// copy count values out of a sidecar image, advancing offset past them
+template <class T>
+static void takeBytes(const std::vector<char> &bytes, size_t &offset, std::vector<T> &values, const size_t count)
+{
+	values.resize(count);
+	if (count > 0)
+	{
+		memcpy(&values[0], &bytes[offset], count * sizeof(T));
+	}
+	offset += count * sizeof(T);
+}
+
+// slope in the middle of the cone of a segment, flat for a segment of a single key
+static double coneSlope(const double slopeLow, const double slopeHigh)
+{
+	return slopeHigh == std::numeric_limits<double>::infinity() ? 0 : (slopeLow + slopeHigh) / 2;
+}
+
+LearnedIndex::LearnedIndex(BTreeIndex *btreeIndex, BufMgr *bufferMgr, const int errorBound)
+{
+	if (btreeIndex->isComposite() || btreeIndex->attributeType != INTEGER)
+	{
+		throw BadIndexInfoException("Learned indexes need a single INTEGER key attribute");
+	}
+
+	index = btreeIndex;
+	bufMgr = bufferMgr;
+	maxError = errorBound < 0 ? 0 : errorBound;
+	numEntries = 0;
+	pagesRead = 0;
+
+	std::string name = sidecarName(index->file->filename());
+	if (File::exists(name))
+	{
+		load(name);
+	}
+	else
+	{
+		build();
+		save(name);
+	}
+
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		segmentKeys.push_back(segments[i].firstKey);
+	}
+}
+
+void LearnedIndex::build()
+{
+	// The model covers the leaves, so inserts still buffered above them go down first
+	index->flushBuffers();
+
+	File *file = index->file;
+	Page *page;
+	PageId headerPageNum = file->getFirstPageNo();
+	bufMgr->readPage(file, headerPageNum, page);
+	bool rootIsLeaf = ((IndexMetaInfo *)page)->rootIsLeaf;
+	bufMgr->unPinPage(file, headerPageNum, false);
+
+	// Leftmost leaf, through the first child of every level
+	PageId pageNo = index->rootPageNum;
+	if (!rootIsLeaf)
+	{
+		std::vector<int> keys;
+		std::vector<PageId> pageNos;
+		int level;
+		do
+		{
+			bufMgr->readPage(file, pageNo, page);
+			NonLeafNodeInt node(page, index->nodeOccupancy);
+			index->getNodeEntries(node, keys, pageNos);
+			level = node.level;
+			bufMgr->unPinPage(file, pageNo, false);
+			pageNo = pageNos[0];
+		} while (level != 1);
+	}
+
+	// Segments are fitted in one pass with a shrinking cone: the slopes keeping every key of the
+	// current segment within maxError of its rank narrow to [slopeLow, slopeHigh], and a key whose
+	// own range of slopes misses that interval starts the next segment
+	double slopeLow = 0;
+	double slopeHigh = std::numeric_limits<double>::infinity();
+	int rank = 0;
+	int prevKey = 0;
+	while (pageNo != 0)
+	{
+		bufMgr->readPage(file, pageNo, page);
+		LeafNodeInt node = index->leafView<int>(page, leafBuffer);
+		int n = 0;
+		while (n < index->leafOccupancy && node.ridArray[n].page_number != 0)
+		{
+			n++;
+		}
+		if (n > 0)
+		{
+			leafRanks.push_back(rank);
+			leafPages.push_back(pageNo);
+		}
+
+		for (int i = 0; i < n; i++, rank++)
+		{
+			// only the first entry of a key is predicted
+			int key = node.keyArray[i];
+			if (rank > 0 && key == prevKey)
+			{
+				continue;
+			}
+			prevKey = key;
+
+			if (!segments.empty())
+			{
+				LearnedSegment &segment = segments.back();
+				double dx = (double)key - segment.firstKey;
+				double low = (rank - maxError - segment.firstRank) / dx;
+				double high = (rank + maxError - segment.firstRank) / dx;
+				if (low <= slopeHigh && high >= slopeLow)
+				{
+					slopeLow = std::max(slopeLow, low);
+					slopeHigh = std::min(slopeHigh, high);
+					continue;
+				}
+				segment.slope = coneSlope(slopeLow, slopeHigh);
+			}
+
+			LearnedSegment segment = {key, rank, 0};
+			segments.push_back(segment);
+			slopeLow = 0;
+			slopeHigh = std::numeric_limits<double>::infinity();
+		}
+
+		PageId nextPageNo = node.rightSibPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+
+	if (!segments.empty())
+	{
+		segments.back().slope = coneSlope(slopeLow, slopeHigh);
+	}
+	numEntries = rank;
+	leafRanks.push_back(numEntries);
+}
+
+void LearnedIndex::save(const std::string &name)
+{
+	LearnedIndexHeader header = {numEntries, (int)segments.size(), (int)leafPages.size(), maxError};
+	std::vector<char> bytes;
+	appendBytes(bytes, &header, 1);
+	appendBytes(bytes, segments.data(), segments.size());
+	appendBytes(bytes, leafRanks.data(), leafRanks.size());
+	appendBytes(bytes, leafPages.data(), leafPages.size());
+
+	BlobFile sidecar(name, true);
+	size_t pageSize = sidecar.pageSize();
+	for (size_t offset = 0; offset < bytes.size(); offset += pageSize)
+	{
+		PageId pageNo;
+		Page *page;
+		bufMgr->allocPage(&sidecar, pageNo, page);
+		memcpy(page, &bytes[offset], std::min(pageSize, bytes.size() - offset));
+		bufMgr->unPinPage(&sidecar, pageNo, true);
+	}
+	bufMgr->flushFile(&sidecar);
+}
+
+void LearnedIndex::load(const std::string &name)
+{
+	BlobFile sidecar(name, false);
+	size_t pageSize = sidecar.pageSize();
+	PageId pageNo = sidecar.getFirstPageNo();
+
+	// the header on the first page gives the size of the rest
+	std::vector<char> bytes;
+	LearnedIndexHeader header;
+	size_t total = 0;
+	do
+	{
+		Page *page;
+		bufMgr->readPage(&sidecar, pageNo, page);
+		if (bytes.empty())
+		{
+			memcpy(&header, page, sizeof(header));
+			total = sizeof(header) + header.numSegments * sizeof(LearnedSegment)
+				+ (header.numLeaves + 1) * sizeof(int) + header.numLeaves * sizeof(PageId);
+		}
+		bytes.insert(bytes.end(), (char *)page, (char *)page + std::min(pageSize, total - bytes.size()));
+		bufMgr->unPinPage(&sidecar, pageNo, false);
+		pageNo++;
+	} while (bytes.size() < total);
+	bufMgr->flushFile(&sidecar);
+
+	numEntries = header.numEntries;
+	maxError = header.maxError;
+	size_t offset = sizeof(header);
+	takeBytes(bytes, offset, segments, header.numSegments);
+	takeBytes(bytes, offset, leafRanks, header.numLeaves + 1);
+	takeBytes(bytes, offset, leafPages, header.numLeaves);
+}
+
+bool LearnedIndex::lookup(const int key, RecordId &outRid)
+{
+	if (segments.empty() || key < segmentKeys[0])
+	{
+		return false;
+	}
+
+	// The first entry of the key is within maxError of the prediction and inside its segment;
+	// one more on each side covers rounding
+	int s = std::upper_bound(segmentKeys.begin(), segmentKeys.end(), key) - segmentKeys.begin() - 1;
+	const LearnedSegment &segment = segments[s];
+	int segmentEnd = s + 1 < (int)segments.size() ? segments[s + 1].firstRank : numEntries;
+	double predicted = segment.firstRank + segment.slope * ((double)key - segment.firstKey);
+	long long rank = (long long)std::floor(std::min(predicted, (double)segmentEnd - 1));
+	rank = std::max(rank, (long long)segment.firstRank);
+	long long low = std::max(rank - maxError - 1, (long long)segment.firstRank);
+	long long high = std::min(rank + maxError + 1, (long long)segmentEnd - 1);
+
+	// Search the leaf holding the predicted rank, then its neighbours on the side the key has to
+	// be while the range spills over
+	int leaf = std::upper_bound(leafRanks.begin(), leafRanks.end(), (int)rank) - leafRanks.begin() - 1;
+	int step = 0;
+	while (true)
+	{
+		int leafStart = leafRanks[leaf];
+		int first = std::max(low, (long long)leafStart) - leafStart;
+		int last = std::min(high, (long long)leafRanks[leaf + 1] - 1) - leafStart;
+
+		Page *page;
+		bufMgr->readPage(index->file, leafPages[leaf], page);
+		pagesRead++;
+		LeafNodeInt node = index->leafView<int>(page, leafBuffer);
+		int pos = std::lower_bound(node.keyArray + first, node.keyArray + last + 1, key) - node.keyArray;
+		bool found = pos <= last && node.keyArray[pos] == key;
+		if (found)
+		{
+			outRid = node.ridArray[pos];
+		}
+		bufMgr->unPinPage(index->file, leafPages[leaf], false);
+
+		if (found)
+		{
+			return true;
+		}
+		if (pos == first && leafStart > low && step <= 0)
+		{
+			step = -1;
+		}
+		else if (pos > last && leafRanks[leaf + 1] <= high && step >= 0)
+		{
+			step = 1;
+		}
+		else
+		{
+			return false;
+		}
+		leaf += step;
+	}
+}
+
+}
@@ -0,0 +1,200 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Default bound, in entries, on how far the rank predicted by a LearnedIndex may be from
+ * the rank of the first entry with the key.
+ */
+const  int LEARNEDMAXERROR = 16;
+
+/**
+ * @brief First page of the sidecar file of a LearnedIndex. The segments follow it, then the
+ * first rank of every leaf and one past the last, then the page number of every leaf.
+ */
+struct LearnedIndexHeader{
+  /**
+   * Number of entries in the leaves of the index.
+   */
+	int numEntries;
+
+  /**
+   * Number of segments of the model.
+   */
+	int numSegments;
+
+  /**
+   * Number of non-empty leaves of the index.
+   */
+	int numLeaves;
+
+  /**
+   * Largest distance between the predicted and the actual rank of a key.
+   */
+	int maxError;
+};
+
+/**
+ * @brief One linear piece of the model of a LearnedIndex. It covers the distinct keys from
+ * firstKey up to the firstKey of the next segment and predicts the rank of the first entry with
+ * key k as firstRank + slope * (k - firstKey).
+ */
+struct LearnedSegment{
+  /**
+   * Smallest key covered by the segment.
+   */
+	int firstKey;
+
+  /**
+   * Rank of the first entry with firstKey, counting entries from the leftmost leaf.
+   */
+	int firstRank;
+
+  /**
+   * Entries per unit of key.
+   */
+	double slope;
+};
+
+/**
+ * @brief This class looks up keys of a read-only INTEGER BTreeIndex without descending the tree.
+ *
+ * A piecewise-linear model fitted over the keys of the leaf chain maps a key to the rank of its
+ * first entry within maxError, and a table of the first rank of every leaf maps that rank to the
+ * leaf and the slot. A lookup reads the predicted leaf and binary searches the slots the error
+ * bound leaves open, moving to a neighbouring leaf only when that range crosses into it, so it
+ * reads one index page where a descent from the root reads one per level.
+ *
+ * The model and the leaf table are kept in a sidecar BlobFile named after the index file with
+ * ".learned" appended. They describe the leaves as they were when the sidecar was built, so the
+ * sidecar has to be removed and built again after entries are inserted into the index.
+ */
+class LearnedIndex
+{
+ public:
+
+  /**
+   * Loads the model of the index from its sidecar file, or fits it over the leaves of the index
+   * and writes the sidecar file if it does not exist yet.
+   * @param index			INTEGER index to look up keys in. It has to outlive this object.
+   * @param bufMgr		Buffer Manager instance
+   * @param maxError	Error bound of a new model, in entries. An existing sidecar keeps its own.
+   * @throws  BadIndexInfoException If the index is not on a single INTEGER attribute
+   */
+  LearnedIndex(BTreeIndex *index, BufMgr *bufMgr, const int maxError = LEARNEDMAXERROR);
+
+  /**
+   * Name of the sidecar file of an index file.
+   * @param indexName	Name of the index file
+   */
+  static std::string sidecarName(const std::string &indexName) { return indexName + ".learned"; }
+
+  /**
+   * Find an entry with the given key.
+   * @param key			Key to look up
+   * @param outRid	RecordId of the entry returned in this, if there is one
+   * @return true if the index holds an entry with the key
+   */
+  bool lookup(const int key, RecordId &outRid);
+
+  /**
+   * Number of segments of the model.
+   */
+  int getNumSegments() const { return segments.size(); }
+
+  /**
+   * Error bound of the model, in entries.
+   */
+  int getMaxError() const { return maxError; }
+
+  /**
+   * Number of index pages read by lookups so far.
+   */
+  int getPagesRead() const { return pagesRead; }
+
+ private:
+  /**
+   * Walks the leaf chain of the index from the leftmost leaf, filling the leaf table, and fits
+   * the segments over the first rank of every distinct key.
+   */
+  void build();
+
+  /**
+   * Writes the header, the segments and the leaf table to a new sidecar file.
+   * @param name	Name of the sidecar file
+   */
+  void save(const std::string &name);
+
+  /**
+   * Reads the header, the segments and the leaf table from the sidecar file.
+   * @param name	Name of the sidecar file
+   */
+  void load(const std::string &name);
+
+  /**
+   * Index whose leaves are read.
+   */
+  BTreeIndex    *index;
+
+  /**
+   * Buffer Manager instance used to read/write pages into/from buffer pool.
+   */
+	BufMgr				*bufMgr;
+
+  /**
+   * Largest distance between the predicted and the actual rank of a key.
+   */
+  int           maxError;
+
+  /**
+   * Number of entries in the leaves of the index.
+   */
+  int           numEntries;
+
+  /**
+   * Segments of the model, in key order.
+   */
+  std::vector<LearnedSegment> segments;
+
+  /**
+   * firstKey of every segment, searched to find the segment of a key.
+   */
+  std::vector<int> segmentKeys;
+
+  /**
+   * Rank of the first entry of every leaf, followed by numEntries.
+   */
+  std::vector<int> leafRanks;
+
+  /**
+   * Page number of every leaf, in key order.
+   */
+  std::vector<PageId> leafPages;
+
+  /**
+   * The leaf being searched, unpacked, when leaves are LEAF_PACKED.
+   */
+  std::vector<char> leafBuffer;
+
+  /**
+   * Number of index pages read by lookups so far.
+   */
+  int           pagesRead;
+};
+
+}
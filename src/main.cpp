@@ -10,9 +10,23 @@
  */
 
 #include <vector>
+#include <map>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "heapfetch.h"
+#include "learnedindex.h"
+#include "hashindex.h"
+#include "deltaindex.h"
+#include "extsort.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
@@ -23,6 +37,12 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_page_size_exception.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -56,6 +76,14 @@ typedef struct tuple {
 	char s[64];
 } RECORD;
 
+// Tuples of the relation used by the composite key tests: (tenant, timestamp) pairs
+
+typedef struct compositeTuple {
+	int tenant;
+	int ts;
+	char s[32];
+} COMPOSITE_RECORD;
+
 PageFile* file1;
 RecordId rid;
 RECORD record1;
@@ -67,14 +95,68 @@ BufMgr * bufMgr = new BufMgr(100);
 // Forward declarations
 // -----------------------------------------------------------------------------
 
-void createRelationForward();
+void createRelationForward(int numRecords = relationSize);
 void createRelationBackward();
 void createRelationOneLeaf();
-void createRelationRandom();
+void createRelationRandom(int numRecords = relationSize, int pageSize = Page::SIZE);
+void createRelationComposite(int numRecords, int numTenants);
 void intTests();
 void smallIntTests(); 
 void smallIndexTests(); 
-int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, int limit = -1);
+int intMultiRangeScan(BTreeIndex *index, const std::vector<ScanRange> &ranges);
+int intKeyScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int compositeScan(BTreeIndex *index, int lowTenant, int lowTs, Operator lowOp, int highTenant, int highTs, Operator highOp);
+int compositePrefixScan(BTreeIndex *index, int tenant);
+int compositeSkipScan(BTreeIndex *index, int lowTs, Operator lowOp, int highTs, Operator highOp, SkipScanMode mode);
+void compositeTests();
+void skipScanReadTests();
+void heapFetchReadTests();
+void prefetchScanTests();
+void prefetchScanBenchmark();
+void bulkBuildTests();
+void bulkBuildBenchmark();
+void externalSortTests();
+void externalSortBenchmark();
+void multiIndexBuildTests();
+void pageSizeTests();
+void nodeLayoutTests();
+void nodeLayoutBenchmark();
+int intLookups(BTreeIndex *index, const std::vector<int> &keys);
+void packedLeafTests();
+int coldScanReads(BTreeIndex *index, int lowVal, int highVal);
+void learnedIndexTests();
+void learnedIndexBenchmark();
+int learnedLookups(LearnedIndex *learned, const std::vector<int> &keys);
+void hashIndexTests();
+void hashIndexBenchmark();
+int hashLookups(HashIndex *index, const std::vector<int> &keys);
+void bufferedNodeTests();
+void bufferedNodeBenchmark();
+void deltaIndexTests();
+void deltaIndexBenchmark();
+int deltaKeyScan(DeltaIndex *delta, int lowVal, Operator lowOp, int highVal, Operator highOp, int limit = -1);
+void appendLeafTests();
+void appendLeafBenchmark();
+void mergeTests();
+void mergeBenchmark();
+void defragmentTests();
+void defragmentBenchmark();
+void extentTests();
+void extentBenchmark();
+void freeListTests();
+void pageFileTests();
+void pageFileBenchmark();
+std::vector<PageId> usedPages(PageFile &file);
+void spaceMapTests();
+void spaceMapBenchmark();
+std::string tupleData(int i);
+void fileIOTests();
+void openCloseFile(const std::string name, const int times);
+void fileIOBenchmark();
+long long fileBytes(const std::string &name);
+void dropFileCache(const std::string &name);
+int prefetchScan(BTreeIndex *index, int lowVal, int highVal, int depth);
 void indexTests();
 void reopenIndex();
 void test1();
@@ -82,6 +164,27 @@ void test2();
 void test3();
 void test4();
 void test5();
+void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
 void errorTests();
 void deleteRelation();
 
@@ -152,6 +255,27 @@ int main(int argc, char **argv)
 	// New Tests
 	test4();
 	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
 	std::cout << "\n>>> All Tests Passed. \n" << std::endl;
 
 	delete bufMgr;
@@ -210,11 +334,241 @@ void test5()
   reopenIndex();
   deleteRelation();
 }
+
+void test6()
+{
+	// Composite (tenant, timestamp) keys, including prefix scans on the tenant
+  std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationComposite" << std::endl;
+	createRelationComposite(relationSize, 8);
+	compositeTests();
+	deleteRelation();
+}
+
+void test7()
+{
+	// Skip scans on a relation with few tenants and many leaves per tenant
+  std::cout << "--------------------" << std::endl;
+	std::cout << "SkipScanReads" << std::endl;
+	createRelationComposite(4 * relationSize, 4);
+	skipScanReadTests();
+	deleteRelation();
+}
+
+void test8()
+{
+	// Fetch the records of a large range when the heap has no correlation with key order
+  std::cout << "--------------------" << std::endl;
+	std::cout << "HeapFetchReads" << std::endl;
+	createRelationRandom(4 * relationSize);
+	heapFetchReadTests();
+	prefetchScanTests();
+	prefetchScanBenchmark();
+	deleteRelation();
+}
+
+void test9()
+{
+	// Sort-based bulk builds on one and several threads, and their build times
+  std::cout << "--------------------" << std::endl;
+	std::cout << "BulkBuild" << std::endl;
+	createRelationRandom(4 * relationSize);
+	bulkBuildTests();
+	deleteRelation();
+	createRelationRandom(20 * relationSize);
+	bulkBuildBenchmark();
+	deleteRelation();
+}
+
+void test10()
+{
+	// Sorting (key, rid) pairs of a relation with a few pages of memory
+  std::cout << "--------------------" << std::endl;
+	std::cout << "ExternalSort" << std::endl;
+	createRelationRandom(4 * relationSize);
+	externalSortTests();
+	deleteRelation();
+	externalSortBenchmark();
+}
+
+void test11()
+{
+	// Three indexes on the same relation built from a single pass over it
+  std::cout << "--------------------" << std::endl;
+	std::cout << "MultiIndexBuild" << std::endl;
+	createRelationComposite(4 * relationSize, 4);
+	multiIndexBuildTests();
+	deleteRelation();
+}
+
+void test12()
+{
+	// Relation and index files with pages smaller than a buffer frame
+  std::cout << "--------------------" << std::endl;
+	std::cout << "PageSize" << std::endl;
+	createRelationRandom(4 * relationSize, 4096);
+	pageSizeTests();
+	deleteRelation();
+}
+
+void test13()
+{
+	// Read-optimized non-leaf nodes, and point lookups in each node layout
+  std::cout << "--------------------" << std::endl;
+	std::cout << "NodeLayout" << std::endl;
+	createRelationRandom(20 * relationSize);
+	nodeLayoutTests();
+	nodeLayoutBenchmark();
+	deleteRelation();
+}
+
+void test14()
+{
+	// Bit-packed leaves on sequential keys, then on keys and RIDs in no order
+  std::cout << "--------------------" << std::endl;
+	std::cout << "PackedLeaves" << std::endl;
+	createRelationForward(20 * relationSize);
+	packedLeafTests();
+	deleteRelation();
+	createRelationRandom(4 * relationSize);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0, Page::SIZE, LEAF_PACKED);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intKeyScan(&index,0,GTE,4 * relationSize,LT), 4 * relationSize)
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+void test15()
+{
+	// Point lookups through a model of the leaves instead of a descent from the root
+  std::cout << "--------------------" << std::endl;
+	std::cout << "LearnedIndex" << std::endl;
+	createRelationRandom(20 * relationSize);
+	learnedIndexTests();
+	learnedIndexBenchmark();
+	deleteRelation();
+}
+
+void test16()
+{
+	// Equality probes on a linear hash index
+  std::cout << "--------------------" << std::endl;
+	std::cout << "HashIndex" << std::endl;
+	createRelationRandom(20 * relationSize);
+	hashIndexTests();
+	hashIndexBenchmark();
+	deleteRelation();
+}
+
+void test17()
+{
+	// Inserts buffered in non-leaf nodes and flushed to the leaves in batches
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Buffered non-leaf nodes" << std::endl;
+	createRelationRandom(20 * relationSize);
+	bufferedNodeTests();
+	bufferedNodeBenchmark();
+	deleteRelation();
+}
+
+void test18()
+{
+	// Inserts collected in memory and moved into the tree in key order
+  std::cout << "--------------------" << std::endl;
+	std::cout << "DeltaIndex" << std::endl;
+	createRelationRandom(20 * relationSize);
+	deltaIndexTests();
+	deltaIndexBenchmark();
+	deleteRelation();
+}
+
+void test19()
+{
+	// Leaves taking inserts in an unsorted tail
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Append leaves" << std::endl;
+	createRelationRandom(20 * relationSize);
+	appendLeafTests();
+	appendLeafBenchmark();
+	deleteRelation();
+}
+
+void test20()
+{
+	// Sorted batches merged into the leaves in one pass
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Merging sorted batches" << std::endl;
+	createRelationRandom(20 * relationSize);
+	mergeTests();
+	mergeBenchmark();
+	deleteRelation();
+}
+
+void test21()
+{
+	// Leaves rewritten into key order after random inserts
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Defragmentation" << std::endl;
+	createRelationRandom(20 * relationSize);
+	defragmentTests();
+	defragmentBenchmark();
+	deleteRelation();
+}
+
+void test22()
+{
+	// Leaves and non-leaf nodes allocated from separate extents
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Extents" << std::endl;
+	createRelationRandom(20 * relationSize);
+	extentTests();
+	extentBenchmark();
+	deleteRelation();
+}
+
+void test23()
+{
+	// Deleted pages of index files allocated again
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Free pages" << std::endl;
+	createRelationRandom(20 * relationSize);
+	freeListTests();
+	deleteRelation();
+}
+
+void test24()
+{
+	// Pages of relation files allocated and deleted in constant time
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Relation file pages" << std::endl;
+	pageFileTests();
+	pageFileBenchmark();
+}
+
+void test25()
+{
+	// Records placed on pages with room through the free space map
+  std::cout << "--------------------" << std::endl;
+	std::cout << "Free space map" << std::endl;
+	spaceMapTests();
+	spaceMapBenchmark();
+}
+
+void test26()
+{
+	// Pages read and written with pread and pwrite
+  std::cout << "--------------------" << std::endl;
+	std::cout << "File I/O" << std::endl;
+	fileIOTests();
+	fileIOBenchmark();
+}
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
 
-void createRelationForward()
+void createRelationForward(int numRecords)
 {
 	std::vector<RecordId> ridVec;
   // destroy any old copies of relation file
@@ -234,7 +588,7 @@ void createRelationForward()
   Page new_page = file1->allocatePage(new_page_number);
 
   // Insert a bunch of tuples into the relation.
-  for(int i = 0; i < relationSize; i++ )
+  for(int i = 0; i < numRecords; i++ )
 	{
     sprintf(record1.s, "%05d string record", i);
     record1.i = i;
@@ -372,7 +726,7 @@ void createRelationOneLeaf()
 	file1->writePage(new_page_number, new_page);
 }
 
-void createRelationRandom()
+void createRelationRandom(int numRecords, int pageSize)
 {
   // destroy any old copies of relation file
 	try
@@ -382,7 +736,7 @@ void createRelationRandom()
 	catch(const FileNotFoundException &e)
 	{
 	}
-  file1 = new PageFile(relationName, true);
+  file1 = new PageFile(relationName, true, pageSize);
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
@@ -391,8 +745,8 @@ void createRelationRandom()
 
   // insert records in random order
 
-  std::vector<int> intvec(relationSize);
-  for( int i = 0; i < relationSize; i++ )
+  std::vector<int> intvec(numRecords);
+  for( int i = 0; i < numRecords; i++ )
   {
     intvec[i] = i;
   }
@@ -400,9 +754,9 @@ void createRelationRandom()
   long pos;
   int val;
 	int i = 0;
-  while( i < relationSize )
+  while( i < numRecords )
   {
-    pos = random() % (relationSize-i);
+    pos = random() % (numRecords-i);
     val = intvec[pos];
     sprintf(record1.s, "%05d string record", val);
     record1.i = val;
@@ -424,8 +778,8 @@ void createRelationRandom()
 			}
 		}
 
-		int temp = intvec[relationSize-1-i];
-		intvec[relationSize-1-i] = intvec[pos];
+		int temp = intvec[numRecords-1-i];
+		intvec[numRecords-1-i] = intvec[pos];
 		intvec[pos] = temp;
 		i++;
   }
@@ -433,6 +787,53 @@ void createRelationRandom()
 	file1->writePage(new_page_number, new_page);
 }
 
+// -----------------------------------------------------------------------------
+// createRelationComposite
+// -----------------------------------------------------------------------------
+
+void createRelationComposite(int numRecords, int numTenants)
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+	COMPOSITE_RECORD record2;
+  memset(record2.s, ' ', sizeof(record2.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Events spread round robin over the tenants, in time order
+  for(int i = 0; i < numRecords; i++ )
+	{
+    sprintf(record2.s, "%05d event", i);
+    record2.tenant = i % numTenants;
+    record2.ts = i / numTenants;
+    std::string new_data(reinterpret_cast<char*>(&record2), sizeof(record2));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
 // -----------------------------------------------------------------------------
 // indexTests
 // -----------------------------------------------------------------------------
@@ -473,10 +874,21 @@ void smallIntTests()
 
 void reopenIndex()
 {
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
-  checkPassFail(intScan(&index,25,GT,40,LT), 14)
-  BTreeIndex index2(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
-  checkPassFail(intScan(&index2,25,GT,40,LT), 14)
+	{
+  	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+  	BTreeIndex index2(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  	checkPassFail(intScan(&index2,25,GT,40,LT), 14)
+	}
+
+	// later tests build their own index on the same attribute
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -494,9 +906,35 @@ void intTests()
 	checkPassFail(intScan(&index,0,GT,1,LT), 0)
 	checkPassFail(intScan(&index,300,GT,400,LT), 99)
 	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+	// Scans with a limit stop early
+	checkPassFail(intScan(&index,3000,GTE,4000,LT,10), 10)
+	checkPassFail(intScan(&index,25,GT,40,LT,100), 14)
+	checkPassFail(intScan(&index,0,GTE,4000,LT,0), 0)
+
+	// Multi-range scans: overlapping ranges, an IN-list and a range past the last key
+	int vals[] = {25, 40, 20, 35, 5, 100, 101, 3000, 4999, 4990, 6000};
+	std::vector<ScanRange> ranges;
+	ranges.push_back({&vals[0], GT, &vals[1], LT});
+	ranges.push_back({&vals[2], GTE, &vals[3], LTE});
+	checkPassFail(intMultiRangeScan(&index, ranges), 20)
+	ranges.clear();
+	for(int i = 4; i < 9; i++)
+	{
+		ranges.push_back({&vals[i], GTE, &vals[i], LTE});
+	}
+	ranges.push_back({&vals[5], GTE, &vals[5], LTE});
+	checkPassFail(intMultiRangeScan(&index, ranges), 5)
+	ranges.push_back({&vals[9], GT, &vals[10], LT});
+	checkPassFail(intMultiRangeScan(&index, ranges), 13)
+
+	// Covering scans answer from the index alone
+	checkPassFail(intKeyScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intKeyScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(intKeyScan(&index,0,GT,1,LT), 0)
 }
 
-int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, int limit)
 {
   RecordId scanRid;
 	Page *curPage;
@@ -505,13 +943,14 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
   if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
   std::cout << lowVal << "," << highVal;
   if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  if( limit >= 0 ) { std::cout << " limit " << limit; }
   std::cout << std::endl;
 
   int numResults = 0;
 	
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+  	index->startScan(&lowVal, lowOp, &highVal, highOp, limit);
 	}
 	catch(const NoSuchKeyFoundException &e)
 	{
@@ -556,6 +995,107 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 	return numResults;
 }
 
+int intMultiRangeScan(BTreeIndex * index, const std::vector<ScanRange> &ranges)
+{
+  RecordId scanRid;
+	Page *curPage;
+  int numResults = 0;
+	int lastKey = 0;
+
+  std::cout << "Multi-range scan over " << ranges.size() << " ranges" << std::endl;
+  index->startMultiRangeScan(ranges);
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			// Entries have to come back in key order
+			if( numResults > 0 && myRec.i <= lastKey )
+			{
+				std::cout << "Multi-range scan out of order at key " << myRec.i << std::endl;
+				exit(1);
+			}
+			lastKey = myRec.i;
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+int intKeyScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+	int key;
+	int lastKey = 0;
+  int numResults = 0;
+	int numDistinct = 0;
+
+  std::cout << "Covering scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			// The key comes from the leaf, the relation is never read
+			index->scanNext(scanRid, &key);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		if( (lowOp == GT && key <= lowVal) || (lowOp == GTE && key < lowVal) ||
+				(highOp == LT && key >= highVal) || (highOp == LTE && key > highVal) ||
+				(numResults > 0 && key < lastKey) )
+		{
+			std::cout << "Covering scan returned bad key " << key << std::endl;
+			exit(1);
+		}
+
+		// Keys arrive sorted, so DISTINCT only has to compare neighbours
+		if( numResults == 0 || key != lastKey )
+		{
+			numDistinct++;
+		}
+		lastKey = key;
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << ", distinct keys: " << numDistinct << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numDistinct;
+}
 
 void intBoundsTest() 
 {
@@ -564,6 +1104,2865 @@ void intBoundsTest()
 	checkPassFail(intScan(&index,-10,GT,10,LT), 14)
 }
 
+// -----------------------------------------------------------------------------
+// compositeTests
+// -----------------------------------------------------------------------------
+
+void compositeTests()
+{
+  std::cout << "Create a B+ Tree index on the (tenant, ts) fields" << std::endl;
+	std::string compositeIndexName;
+	std::vector<KeyAttr> attrs(2);
+	attrs[0].attrByteOffset = offsetof(compositeTuple, tenant);
+	attrs[0].attrType = INTEGER;
+	attrs[1].attrByteOffset = offsetof(compositeTuple, ts);
+	attrs[1].attrType = INTEGER;
+
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attrs);
+		checkPassFail(compositePrefixScan(&index, 3), 625)
+		checkPassFail(compositePrefixScan(&index, 8), 0)
+		checkPassFail(compositeScan(&index, 3, 100, GTE, 3, 199, LTE), 100)
+		checkPassFail(compositeScan(&index, 2, 600, GTE, 3, 10, LT), 35)
+		checkPassFail(compositeScan(&index, -1, 0, GT, 0, 5, LT), 5)
+
+		// Skip scans constrain only the timestamp
+		checkPassFail(compositeSkipScan(&index, 100, GTE, 199, LTE, SKIP_SEEK), 800)
+		checkPassFail(compositeSkipScan(&index, 100, GTE, 199, LTE, SKIP_WALK), 800)
+		checkPassFail(compositeSkipScan(&index, 100, GTE, 199, LTE, SKIP_AUTO), 800)
+		checkPassFail(compositeSkipScan(&index, 620, GT, 700, LT, SKIP_SEEK), 32)
+		checkPassFail(compositeSkipScan(&index, 5, GT, 6, LT, SKIP_SEEK), 0)
+	}
+
+	// Reopening checks the key attributes stored in the meta page
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attrs);
+		checkPassFail(compositePrefixScan(&index, 7), 625)
+	}
+
+	try
+	{
+		File::remove(compositeIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+int compositeScan(BTreeIndex * index, int lowTenant, int lowTs, Operator lowOp, int highTenant, int highTs, Operator highOp)
+{
+	int lowAttrs[] = {lowTenant, lowTs};
+	int highAttrs[] = {highTenant, highTs};
+	CompositeKey lowVal = BTreeIndex::makeCompositeKey(lowAttrs, 2);
+	CompositeKey highVal = BTreeIndex::makeCompositeKey(highAttrs, 2);
+  RecordId scanRid;
+	Page *curPage;
+  int numResults = 0;
+	CompositeKey lastKey = 0;
+
+  std::cout << "Composite scan for (" << lowTenant << "," << lowTs << ") to (" << highTenant << "," << highTs << ")" << std::endl;
+	index->startScan(&lowVal, lowOp, &highVal, highOp);
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			COMPOSITE_RECORD myRec = *(reinterpret_cast<const COMPOSITE_RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			// Keys have to come back in (tenant, ts) order
+			int attrVals[] = {myRec.tenant, myRec.ts};
+			CompositeKey key = BTreeIndex::makeCompositeKey(attrVals, 2);
+			if( numResults > 0 && key <= lastKey )
+			{
+				std::cout << "Composite scan out of order at (" << myRec.tenant << "," << myRec.ts << ")" << std::endl;
+				exit(1);
+			}
+			lastKey = key;
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+
+	return numResults;
+}
+
+int compositeSkipScan(BTreeIndex * index, int lowTs, Operator lowOp, int highTs, Operator highOp, SkipScanMode mode)
+{
+  RecordId scanRid;
+	Page *curPage;
+  int numResults = 0;
+
+  std::cout << "Skip scan for ts ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowTs << "," << highTs;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << " mode " << mode << std::endl;
+	index->startSkipScan(&lowTs, lowOp, &highTs, highOp, mode);
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			COMPOSITE_RECORD myRec = *(reinterpret_cast<const COMPOSITE_RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( (lowOp == GT ? myRec.ts <= lowTs : myRec.ts < lowTs) ||
+					(highOp == LT ? myRec.ts >= highTs : myRec.ts > highTs) )
+			{
+				std::cout << "Skip scan returned ts " << myRec.ts << std::endl;
+				exit(1);
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+
+	return numResults;
+}
+
+int compositePrefixScan(BTreeIndex * index, int tenant)
+{
+  RecordId scanRid;
+	Page *curPage;
+  int numResults = 0;
+
+  std::cout << "Composite prefix scan for tenant " << tenant << std::endl;
+	index->startPrefixScan(&tenant);
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			COMPOSITE_RECORD myRec = *(reinterpret_cast<const COMPOSITE_RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( myRec.tenant != tenant )
+			{
+				std::cout << "Prefix scan returned tenant " << myRec.tenant << std::endl;
+				exit(1);
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// skipScanReadTests
+// -----------------------------------------------------------------------------
+
+void skipScanReadTests()
+{
+	std::string compositeIndexName;
+	std::vector<KeyAttr> attrs(2);
+	attrs[0].attrByteOffset = offsetof(compositeTuple, tenant);
+	attrs[0].attrType = INTEGER;
+	attrs[1].attrByteOffset = offsetof(compositeTuple, ts);
+	attrs[1].attrType = INTEGER;
+
+	// Build the index, then compare cold page reads of each way to answer 100 <= ts < 200
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attrs);
+	}
+
+	int seekReads, walkReads, heapReads;
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attrs);
+		bufMgr->clearBufStats();
+		checkPassFail(compositeSkipScan(&index, 100, GTE, 200, LT, SKIP_SEEK), 400)
+		seekReads = bufMgr->getBufStats().diskreads;
+	}
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attrs);
+		bufMgr->clearBufStats();
+		checkPassFail(compositeSkipScan(&index, 100, GTE, 200, LT, SKIP_WALK), 400)
+		walkReads = bufMgr->getBufStats().diskreads;
+	}
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attrs);
+		checkPassFail(compositeSkipScan(&index, 100, GTE, 200, LT, SKIP_AUTO), 400)
+	}
+	{
+		bufMgr->clearBufStats();
+		FileScan fscan(relationName, bufMgr);
+		int numResults = 0;
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				std::string recordStr = fscan.getRecord();
+				const COMPOSITE_RECORD *myRec = reinterpret_cast<const COMPOSITE_RECORD*>(recordStr.c_str());
+				if( myRec->ts >= 100 && myRec->ts < 200 )
+				{
+					numResults++;
+				}
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		checkPassFail(numResults, 400)
+		heapReads = bufMgr->getBufStats().diskreads;
+	}
+
+	// Record fetches of the index scans go to the same heap pages, so compare the rest
+	std::cout << "Page reads: skip seek " << seekReads << ", leaf walk " << walkReads << ", heap scan " << heapReads << std::endl;
+	if( seekReads >= walkReads )
+	{
+		std::cout << "Skip seek read more pages than the leaf walk" << std::endl;
+		exit(1);
+	}
+
+	try
+	{
+		File::remove(compositeIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+// -----------------------------------------------------------------------------
+// heapFetchReadTests
+// -----------------------------------------------------------------------------
+
+void heapFetchReadTests()
+{
+	// Build the index, then compare cold page reads of fetching 0 <= i < 10000 in key order and in page order
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+
+	int lowVal = 0;
+	int highVal = 10000;
+	int keyOrderReads, pageOrderReads;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		bufMgr->flushFile(file1);
+		bufMgr->clearBufStats();
+
+		RecordId scanRid;
+		Page *curPage;
+		int numResults = 0;
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		try
+		{
+			while(1)
+			{
+				index.scanNext(scanRid);
+				bufMgr->readPage(file1, scanRid.page_number, curPage);
+				bufMgr->unPinPage(file1, scanRid.page_number, false);
+				numResults++;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+		index.endScan();
+		checkPassFail(numResults, 10000)
+		keyOrderReads = bufMgr->getBufStats().diskreads;
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		bufMgr->flushFile(file1);
+		bufMgr->clearBufStats();
+
+		HeapFetch fetch(relationName, bufMgr);
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		fetch.addScan(&index);
+
+		int numResults = 0;
+		int lastPage = 0;
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fetch.scanNext(scanRid);
+				std::string recordStr = fetch.getRecord();
+				const RECORD *myRec = reinterpret_cast<const RECORD*>(recordStr.c_str());
+				if( myRec->i < lowVal || myRec->i >= highVal || (int)scanRid.page_number < lastPage )
+				{
+					std::cout << "Heap fetch returned bad record " << myRec->i << std::endl;
+					exit(1);
+				}
+				lastPage = scanRid.page_number;
+				numResults++;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		checkPassFail(numResults, 10000)
+		pageOrderReads = bufMgr->getBufStats().diskreads;
+		std::cout << "Heap pages read in page order: " << fetch.getPagesRead() << std::endl;
+	}
+
+	std::cout << "Page reads: key order " << keyOrderReads << ", page order " << pageOrderReads << std::endl;
+	if( pageOrderReads >= keyOrderReads )
+	{
+		std::cout << "Fetching in page order read more pages than key order" << std::endl;
+		exit(1);
+	}
+
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+// -----------------------------------------------------------------------------
+// prefetchScanTests
+// -----------------------------------------------------------------------------
+
+void prefetchScanTests()
+{
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+
+	// A short window has its pages used before the clock gets to them
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		bufMgr->flushFile(file1);
+		bufMgr->clearBufStats();
+		checkPassFail(prefetchScan(&index, 0, 10000, 16), 10000)
+
+		BufStats stats = bufMgr->getBufStats();
+		std::cout << "Depth 16: prefetches " << stats.prefetches << ", hits " << stats.prefetchhits << ", wasted " << stats.prefetchwasted << std::endl;
+		if( stats.prefetchhits == 0 || stats.prefetchhits + stats.prefetchwasted > stats.prefetches )
+		{
+			std::cout << "Bad prefetch statistics" << std::endl;
+			exit(1);
+		}
+	}
+
+	// A window wider than the buffer pool takes no frames for its prefetches, so none is evicted unread
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		bufMgr->flushFile(file1);
+		bufMgr->clearBufStats();
+		checkPassFail(prefetchScan(&index, 0, 10000, 400), 10000)
+
+		BufStats stats = bufMgr->getBufStats();
+		std::cout << "Depth 400: prefetches " << stats.prefetches << ", hits " << stats.prefetchhits << ", wasted " << stats.prefetchwasted << std::endl;
+		if( stats.prefetchhits == 0 || stats.prefetchwasted != 0 )
+		{
+			std::cout << "Prefetches beyond the buffer pool were wasted" << std::endl;
+			exit(1);
+		}
+	}
+
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+// -----------------------------------------------------------------------------
+// prefetchScanBenchmark
+// -----------------------------------------------------------------------------
+
+void prefetchScanBenchmark()
+{
+	// A relation of a few large records per page, stored in random key order so that a scan in
+	// key order jumps between pages
+	const std::string name = "relA.scatter";
+	const int numRecords = 8000;
+	std::string indexName;
+	{
+		std::vector<int> keys(numRecords);
+		for(int i = 0; i < numRecords; i++)
+		{
+			keys[i] = i;
+		}
+		for(int i = numRecords - 1; i > 0; i--)
+		{
+			std::swap(keys[i], keys[random() % (i + 1)]);
+		}
+		PageFile file(name, true);
+		for(int i = 0; i < numRecords; i++)
+		{
+			bufMgr->insertRecord(&file, tupleData(keys[i]) + std::string(2000, ' '));
+		}
+		bufMgr->flushFile(&file);
+		BTreeIndex index(name, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+
+	// Cold scans with a window of one record, whose every page read waits for the disk, and with
+	// a deep window whose reads go on in the background while earlier records are consumed
+	const int depths[2] = {1, 64};
+	double seconds[2];
+	BufStats stats[2];
+	for(int d = 0; d < 2; d++)
+	{
+		dropFileCache(name);
+		BTreeIndex index(name, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		bufMgr->clearBufStats();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int lowVal = 0;
+		int highVal = numRecords;
+		int numResults = 0;
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		{
+			PrefetchScan scan(name, bufMgr, &index, depths[d]);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					scan.scanNext(scanRid);
+					std::string recordStr = scan.getRecord();
+					if( reinterpret_cast<const RECORD*>(recordStr.c_str())->i != numResults )
+					{
+						std::cout << "Prefetch scan returned a record out of order" << std::endl;
+						exit(1);
+					}
+					numResults++;
+				}
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+		}
+		index.endScan();
+		seconds[d] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stats[d] = bufMgr->getBufStats();
+		std::cout << "Seconds for a cold scan of " << numRecords << " scattered records, depth " << depths[d] << ": "
+			<< seconds[d] << " (" << stats[d].diskreads << " page reads, " << stats[d].prefetchhits
+			<< " prefetched ahead of the read)" << std::endl;
+		checkPassFail(numResults, numRecords)
+	}
+	File::remove(indexName);
+	File::remove(name);
+
+	// Timings depend on the machine and its page cache; which reads had their advice in time does not.
+	// A window of one record asks for every page right before reading it, a deep one well ahead
+	checkPassFail(stats[0].prefetchhits, 0)
+	checkPassFail((stats[1].prefetchhits * 10 > stats[1].diskreads * 9), true)
+}
+
+int prefetchScan(BTreeIndex * index, int lowVal, int highVal, int depth)
+{
+	int numResults = 0;
+	int lastKey = 0;
+
+	index->startScan(&lowVal, GTE, &highVal, LT);
+	{
+		PrefetchScan scan(relationName, bufMgr, index, depth);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				scan.scanNext(scanRid);
+				std::string recordStr = scan.getRecord();
+				const RECORD *myRec = reinterpret_cast<const RECORD*>(recordStr.c_str());
+
+				// Records have to come back in key order
+				if( myRec->i < lowVal || myRec->i >= highVal || (numResults > 0 && myRec->i <= lastKey) )
+				{
+					std::cout << "Prefetch scan returned bad record " << myRec->i << std::endl;
+					exit(1);
+				}
+				lastKey = myRec->i;
+				numResults++;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+	}
+	index->endScan();
+
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// bulkBuildTests
+// -----------------------------------------------------------------------------
+
+void bulkBuildTests()
+{
+	int threadCounts[] = {1, 3};
+	for(int t = 0; t < 2; t++)
+	{
+		{
+  		std::cout << "Bulk build on " << threadCounts[t] << " threads" << std::endl;
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, threadCounts[t]);
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(intKeyScan(&index,0,GTE,20000,LT), 20000)
+
+			// Inserts into the full leaves of a bulk loaded tree split them
+			for(int i = 0; i < 2000; i++)
+			{
+				int key = (i % 2 == 0) ? 20000 + i : -i;
+				RecordId rid;
+				rid.page_number = 1;
+				rid.slot_number = i;
+				index.insertEntry(&key, rid);
+			}
+			checkPassFail(intKeyScan(&index,20000,GTE,22000,LT), 1000)
+			checkPassFail(intKeyScan(&index,-2000,GT,20000,LT), 21000)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		}
+
+		// Reopening does not rebuild
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, threadCounts[t]);
+			checkPassFail(intKeyScan(&index,-2000,GT,22000,LT), 22000)
+		}
+
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(const FileNotFoundException &e)
+  	{
+  	}
+	}
+}
+
+void bulkBuildBenchmark()
+{
+	// Build the same index by inserting each tuple, then by bulk builds on more and more threads
+	int threadCounts[] = {0, 1, 2, 4, 8};
+	double seconds[5];
+	for(int t = 0; t < 5; t++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, threadCounts[t]);
+			seconds[t] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			checkPassFail(intKeyScan(&index,0,GTE,100000,LT), 100000)
+		}
+
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(const FileNotFoundException &e)
+  	{
+  	}
+	}
+
+	std::cout << "Index build seconds for 100000 tuples (tree printing included):" << std::endl;
+	std::cout << "  inserts: " << seconds[0] << std::endl;
+	for(int t = 1; t < 5; t++)
+	{
+		std::cout << "  bulk, " << threadCounts[t] << " threads: " << seconds[t] << std::endl;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// externalSortTests
+// -----------------------------------------------------------------------------
+
+void externalSortTests()
+{
+	int budgets[] = {MINSORTPAGES, 8, 40};
+	for(int b = 0; b < 3; b++)
+	{
+		ExternalSort<RIDKeyPair<int> > sorter(relationName + ".sort", bufMgr, budgets[b]);
+		{
+			FileScan fscan(relationName, bufMgr);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					fscan.scanNext(scanRid);
+					std::string recordStr = fscan.getRecord();
+					RIDKeyPair<int> entry;
+					entry.set(scanRid, reinterpret_cast<const RECORD*>(recordStr.c_str())->i);
+					sorter.add(entry);
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+		}
+
+		// Keys are 0 .. 19999, so sorted output has each key at its own position
+		int numResults = 0;
+		try
+		{
+			RIDKeyPair<int> entry;
+			while(1)
+			{
+				sorter.scanNext(entry);
+				if( entry.key != numResults )
+				{
+					std::cout << "External sort returned key " << entry.key << " at position " << numResults << std::endl;
+					exit(1);
+				}
+				numResults++;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		std::cout << "Budget " << budgets[b] << " pages: " << sorter.getNumRuns() << " runs, " << sorter.getNumPasses() << " merge passes" << std::endl;
+		checkPassFail(numResults, 4 * relationSize)
+	}
+}
+
+void externalSortBenchmark()
+{
+	// Sort ten times as many entries as the memory budget holds, and the same entries in memory
+	const int budget = 32;
+	const int numEntries = 10 * budget * (int)(sizeof(((RunPage<RIDKeyPair<int> > *)0)->entries) / sizeof(RIDKeyPair<int>));
+	std::vector<RIDKeyPair<int> > entries(numEntries);
+	for(int i = 0; i < numEntries; i++)
+	{
+		RecordId rid;
+		rid.page_number = i / 100 + 1;
+		rid.slot_number = i % 100;
+		entries[i].set(rid, (int)(random() % 1000000));
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<RIDKeyPair<int> > inMemory(entries);
+	std::sort(inMemory.begin(), inMemory.end());
+	double memorySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	bufMgr->clearBufStats();
+	start = std::chrono::steady_clock::now();
+	int numResults = 0;
+	{
+		ExternalSort<RIDKeyPair<int> > sorter(relationName + ".sort", bufMgr, budget);
+		for(int i = 0; i < numEntries; i++)
+		{
+			sorter.add(entries[i]);
+		}
+		try
+		{
+			RIDKeyPair<int> entry;
+			while(1)
+			{
+				sorter.scanNext(entry);
+				if( entry.key != inMemory[numResults].key )
+				{
+					std::cout << "External sort differs from in memory sort at position " << numResults << std::endl;
+					exit(1);
+				}
+				numResults++;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		std::cout << sorter.getNumRuns() << " runs, " << sorter.getNumPasses() << " merge passes" << std::endl;
+	}
+	double externalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	checkPassFail(numResults, numEntries)
+
+	std::cout << "Sort seconds for " << numEntries << " entries with a " << budget << " page budget: external " << externalSeconds
+		<< " (" << bufMgr->getBufStats().diskreads << " page reads), in memory " << memorySeconds << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// multiIndexBuildTests
+// -----------------------------------------------------------------------------
+
+void multiIndexBuildTests()
+{
+	KeyAttr tenant, ts;
+	tenant.attrByteOffset = offsetof(compositeTuple, tenant);
+	tenant.attrType = INTEGER;
+	ts.attrByteOffset = offsetof(compositeTuple, ts);
+	ts.attrType = INTEGER;
+
+	std::vector<std::vector<KeyAttr> > indexKeys(3);
+	indexKeys[0].push_back(tenant);
+	indexKeys[1].push_back(ts);
+	indexKeys[2].push_back(tenant);
+	indexKeys[2].push_back(ts);
+	std::vector<std::string> indexNames;
+
+	// One index at a time reads the relation once per index
+	bufMgr->flushFile(file1);
+	bufMgr->clearBufStats();
+	for(int i = 0; i < 3; i++)
+	{
+		std::string indexName;
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, indexKeys[i], 1);
+		}
+		File::remove(indexName);
+	}
+	int separateReads = bufMgr->getBufStats().diskreads;
+
+	bufMgr->clearBufStats();
+	BTreeIndex::buildIndexes(relationName, bufMgr, indexKeys, indexNames, 2);
+	int singlePassReads = bufMgr->getBufStats().diskreads;
+	std::cout << "Page reads: one pass per index " << separateReads << ", single pass " << singlePassReads << std::endl;
+	if( singlePassReads * 2 >= separateReads )
+	{
+		std::cout << "Building the indexes together did not save relation reads" << std::endl;
+		exit(1);
+	}
+
+	{
+		BTreeIndex index(relationName, indexNames[0], bufMgr, offsetof(compositeTuple, tenant), INTEGER);
+		int tenantVal = 1;
+		checkPassFail(intKeyScan(&index,tenantVal,GTE,tenantVal,LTE), 1)
+	}
+	{
+		BTreeIndex index(relationName, indexNames[1], bufMgr, offsetof(compositeTuple, ts), INTEGER);
+		checkPassFail(intKeyScan(&index,100,GTE,200,LT), 100)
+	}
+	{
+		BTreeIndex index(relationName, indexNames[2], bufMgr, indexKeys[2]);
+		checkPassFail(compositePrefixScan(&index, 1), relationSize)
+		checkPassFail(compositeScan(&index, 1, 100, GTE, 1, 200, LT), 100)
+	}
+
+	// Existing indexes are left alone
+	BTreeIndex::buildIndexes(relationName, bufMgr, indexKeys, indexNames, 2);
+	{
+		BTreeIndex index(relationName, indexNames[1], bufMgr, offsetof(compositeTuple, ts), INTEGER);
+		checkPassFail(intKeyScan(&index,100,GTE,200,LT), 100)
+	}
+
+	for(int i = 0; i < 3; i++)
+	{
+		File::remove(indexNames[i]);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// pageSizeTests
+// -----------------------------------------------------------------------------
+
+void pageSizeTests()
+{
+	checkPassFail((int)file1->pageSize(), 4096)
+
+	// Smaller pages give smaller nodes and deeper trees, built by inserts and by bulk loads; pages up to
+	// Page::MAX_SIZE go into frames of their own size
+	int pageSizes[] = {Page::SIZE, 4096, 1024, 512, 16384, Page::MAX_SIZE};
+	for(int i = 0; i < 6; i++)
+	{
+		std::string indexName;
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, i % 2, pageSizes[i]);
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intKeyScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(intKeyScan(&index,0,GTE,4 * relationSize,LT), 4 * relationSize)
+		}
+
+		// The index file keeps its page size when it is opened again
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, 0, Page::SIZE);
+			checkPassFail(intScan(&index,300,GT,400,LT), 99)
+		}
+		{
+			BlobFile indexFile = BlobFile::open(indexName);
+			checkPassFail((int)indexFile.pageSize(), pageSizes[i])
+		}
+		File::remove(indexName);
+	}
+
+	// Pages have to hold a header and fit in the largest buffer frame
+	int badSizes[] = {Page::MIN_SIZE - 1, Page::MAX_SIZE + 1};
+	for(int i = 0; i < 2; i++)
+	{
+		bool thrown = false;
+		try
+		{
+			std::string indexName;
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, 0, badSizes[i]);
+		}
+		catch(const BadPageSizeException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+		checkPassFail(File::exists(relationName + ".0"), false)
+	}
+
+	// Every frame pool holds as many bytes as 100 frames of Page::SIZE, so the pool of the largest
+	// pages runs out after fewer of them are pinned, while pages of other sizes still get frames
+	{
+		const std::string bigName = "relA.big";
+		const std::string smallName = "relA.small";
+		const int numBig = 100 * Page::SIZE / Page::MAX_SIZE;
+		BlobFile big(bigName, true, Page::MAX_SIZE);
+		BlobFile small(smallName, true, Page::MIN_SIZE);
+		std::vector<PageId> pageNos(numBig);
+		Page *page;
+		for(int i = 0; i < numBig; i++)
+		{
+			bufMgr->allocPage(&big, pageNos[i], page);
+			memset((void *)page, 'a' + i, Page::MAX_SIZE);
+		}
+		bool thrown = false;
+		try
+		{
+			PageId pageNo;
+			bufMgr->allocPage(&big, pageNo, page);
+		}
+		catch(const BufferExceededException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+
+		PageId smallPageNo;
+		bufMgr->allocPage(&small, smallPageNo, page);
+		memset((void *)page, 'z', Page::MIN_SIZE);
+		bufMgr->unPinPage(&small, smallPageNo, true);
+		for(int i = 0; i < numBig; i++)
+		{
+			bufMgr->unPinPage(&big, pageNos[i], true);
+		}
+		bufMgr->flushFile(&big);
+		bufMgr->flushFile(&small);
+
+		// Whole pages were written back, and none ran over another one in its frame
+		checkPassFail(fileBytes(bigName), (long long)(sizeof(FileHeader) + numBig * Page::MAX_SIZE))
+		for(int i = 0; i < numBig; i++)
+		{
+			bufMgr->readPage(&big, pageNos[i], page);
+			checkPassFail((((char *)page)[0] == 'a' + i && ((char *)page)[Page::MAX_SIZE - 1] == 'a' + i), true)
+			bufMgr->unPinPage(&big, pageNos[i], false);
+		}
+		bufMgr->readPage(&small, smallPageNo, page);
+		checkPassFail(((char *)page)[Page::MIN_SIZE - 1], 'z')
+		bufMgr->unPinPage(&small, smallPageNo, false);
+		bufMgr->flushFile(&big);
+		bufMgr->flushFile(&small);
+	}
+	File::remove("relA.big");
+	File::remove("relA.small");
+}
+
+// -----------------------------------------------------------------------------
+// nodeLayoutTests
+// -----------------------------------------------------------------------------
+
+void nodeLayoutTests()
+{
+	// Small pages give a tree with several levels of non-leaf nodes
+	std::vector<int> keys;
+	for(int i = 0; i < 1000; i++)
+	{
+		keys.push_back(random() % (20 * relationSize));
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, 512);
+		checkPassFail(index.getNodeLayout(), LAYOUT_SORTED)
+		checkPassFail(intLookups(&index, keys), 1000)
+
+		index.setNodeLayout(LAYOUT_EYTZINGER);
+		checkPassFail(intLookups(&index, keys), 1000)
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intKeyScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize,LT), 20 * relationSize)
+	}
+
+	// The layout is kept in the meta page
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getNodeLayout(), LAYOUT_EYTZINGER)
+		checkPassFail(intLookups(&index, keys), 1000)
+
+		// Inserts put the nodes back in sorted order
+		int key = 20 * relationSize;
+		RecordId keyRid = {1, 1};
+		index.insertEntry(&key, keyRid);
+		checkPassFail(index.getNodeLayout(), LAYOUT_SORTED)
+		checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize,LTE), 20 * relationSize + 1)
+		checkPassFail(intLookups(&index, keys), 1000)
+	}
+
+	File::remove(intIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// nodeLayoutBenchmark
+// -----------------------------------------------------------------------------
+
+void nodeLayoutBenchmark()
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 20000; i++)
+	{
+		keys.push_back(random() % (20 * relationSize));
+	}
+
+	// Point lookups on the same tree with sorted and with Eytzinger ordered non-leaf nodes
+	int pageSizes[] = {Page::SIZE, 512};
+	for(int p = 0; p < 2; p++)
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, pageSizes[p]);
+		double seconds[2];
+		for(int l = 0; l < 2; l++)
+		{
+			index.setNodeLayout(l == 0 ? LAYOUT_SORTED : LAYOUT_EYTZINGER);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			checkPassFail(intLookups(&index, keys), 20000)
+			seconds[l] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		std::cout << "Seconds for 20000 lookups, " << pageSizes[p] << " byte pages: sorted "
+			<< seconds[0] << ", eytzinger " << seconds[1] << std::endl;
+	}
+	File::remove(intIndexName);
+}
+
+// Looks up each key on its own and returns the number of keys found
+int intLookups(BTreeIndex *index, const std::vector<int> &keys)
+{
+	int found = 0;
+	RecordId scanRid;
+	int scanKey;
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		index->startScan(&keys[i], GTE, &keys[i], LTE);
+		try
+		{
+			index->scanNext(scanRid, &scanKey);
+			if(scanKey == keys[i])
+			{
+				found++;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+		index->endScan();
+	}
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// packedLeafTests
+// -----------------------------------------------------------------------------
+
+void packedLeafTests()
+{
+	// Leaves read by a full scan of indexes built by inserts and by bulk loads, plain then packed
+	int reads[2][2];
+	for(int threads = 0; threads < 2; threads++)
+	{
+		for(int f = 0; f < 2; f++)
+		{
+			{
+				BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, threads, Page::SIZE,
+					f == 0 ? LEAF_PLAIN : LEAF_PACKED);
+				checkPassFail(intScan(&index,25,GT,40,LT), 14)
+				checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+			}
+
+			// The format is kept in the meta page
+			{
+				BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+				reads[threads][f] = coldScanReads(&index, 0, 20 * relationSize);
+			}
+			File::remove(intIndexName);
+		}
+		std::cout << "Index pages read by a full scan, " << (threads == 0 ? "inserts" : "bulk load")
+			<< ": plain " << reads[threads][0] << ", packed " << reads[threads][1] << std::endl;
+		if( reads[threads][1] * 2 > reads[threads][0] )
+		{
+			std::cout << "Packed leaves did not hold twice as many sequential entries" << std::endl;
+			exit(1);
+		}
+	}
+
+	// Only INTEGER keys pack
+	bool thrown = false;
+	try
+	{
+		std::string indexName;
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,d), DOUBLE, 0, Page::SIZE, LEAF_PACKED);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		thrown = true;
+	}
+	checkPassFail(thrown, true)
+}
+
+// Scans every key in [lowVal, highVal) from a cold buffer pool and returns the index pages read
+int coldScanReads(BTreeIndex *index, int lowVal, int highVal)
+{
+	bufMgr->clearBufStats();
+	checkPassFail(intKeyScan(index,lowVal,GTE,highVal,LT), highVal - lowVal)
+	return bufMgr->getBufStats().diskreads;
+}
+
+// -----------------------------------------------------------------------------
+// learnedIndexTests
+// -----------------------------------------------------------------------------
+
+void learnedIndexTests()
+{
+	// The relation keys are dense; squares above them bend the key distribution and every
+	// seventh square gets a second entry
+	std::vector<int> keys;
+	for(int i = 0; i < 20 * relationSize; i++)
+	{
+		keys.push_back(i);
+	}
+	std::vector<int> squares;
+	for(int i = 1; i <= 3000; i++)
+	{
+		squares.push_back(20 * relationSize + i * i);
+	}
+	std::vector<int> missing;
+	missing.push_back(-5);
+	missing.push_back(20 * relationSize);
+	missing.push_back(0x7fffffff);
+	for(int i = 2; i <= 3000; i += 11)
+	{
+		missing.push_back(20 * relationSize + i * i + 1);
+	}
+
+	for(int f = 0; f < 2; f++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, Page::SIZE,
+				f == 0 ? LEAF_PLAIN : LEAF_PACKED);
+			for(size_t i = 0; i < squares.size(); i++)
+			{
+				RecordId rid = {1, (SlotId)(i % 100 + 1)};
+				index.insertEntry(&squares[i], rid);
+				if(i % 7 == 0)
+				{
+					index.insertEntry(&squares[i], rid);
+				}
+			}
+
+			LearnedIndex learned(&index, bufMgr);
+			checkPassFail(learned.getMaxError(), LEARNEDMAXERROR)
+			if(learned.getNumSegments() < 2)
+			{
+				std::cout << "Squares did not start new segments" << std::endl;
+				exit(1);
+			}
+			checkPassFail(learnedLookups(&learned, keys), 20 * relationSize)
+			checkPassFail(learnedLookups(&learned, squares), 3000)
+			checkPassFail(learnedLookups(&learned, missing), 0)
+
+			// Same entries as a descent finds
+			RecordId learnedRid;
+			RecordId scanRid;
+			bool same = true;
+			for(int key = 0; key < 20 * relationSize; key += 97)
+			{
+				learned.lookup(key, learnedRid);
+				index.startScan(&key, GTE, &key, LTE);
+				index.scanNext(scanRid);
+				index.endScan();
+				same = same && learnedRid.page_number == scanRid.page_number && learnedRid.slot_number == scanRid.slot_number;
+			}
+			checkPassFail(same, true)
+		}
+
+		// The model is read back from the sidecar file, with the error bound it was built with
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			LearnedIndex learned(&index, bufMgr, 1000);
+			checkPassFail(learned.getMaxError(), LEARNEDMAXERROR)
+			checkPassFail(learnedLookups(&learned, squares), 3000)
+			checkPassFail(learnedLookups(&learned, missing), 0)
+			checkPassFail(learnedLookups(&learned, keys), 20 * relationSize)
+		}
+		File::remove(LearnedIndex::sidecarName(intIndexName));
+		File::remove(intIndexName);
+	}
+
+	// Only single INTEGER keys are modelled
+	std::vector<KeyAttr> keyAttrs(2);
+	keyAttrs[0].attrByteOffset = keyAttrs[1].attrByteOffset = offsetof(tuple,i);
+	keyAttrs[0].attrType = keyAttrs[1].attrType = INTEGER;
+	std::string compositeIndexName;
+	bool thrown = false;
+	try
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, keyAttrs, 1);
+		LearnedIndex learned(&index, bufMgr);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		thrown = true;
+	}
+	checkPassFail(thrown, true)
+	checkPassFail(File::exists(LearnedIndex::sidecarName(compositeIndexName)), false)
+	File::remove(compositeIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// learnedIndexBenchmark
+// -----------------------------------------------------------------------------
+
+void learnedIndexBenchmark()
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 20000; i++)
+	{
+		keys.push_back(random() % (20 * relationSize));
+	}
+
+	// Point lookups by descent and through the model, on the same tree
+	int pageSizes[] = {Page::SIZE, 512};
+	for(int p = 0; p < 2; p++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, pageSizes[p]);
+			LearnedIndex learned(&index, bufMgr);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			checkPassFail(intLookups(&index, keys), 20000)
+			double descent = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			start = std::chrono::steady_clock::now();
+			checkPassFail(learnedLookups(&learned, keys), 20000)
+			double model = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::cout << "Seconds for 20000 lookups, " << pageSizes[p] << " byte pages: descent " << descent
+				<< ", learned " << model << " (" << learned.getNumSegments() << " segments, "
+				<< (double)learned.getPagesRead() / keys.size() << " pages per lookup)" << std::endl;
+			if(learned.getPagesRead() > (int)keys.size() * 11 / 10)
+			{
+				std::cout << "Learned lookups read more than one leaf" << std::endl;
+				exit(1);
+			}
+		}
+		File::remove(LearnedIndex::sidecarName(intIndexName));
+		File::remove(intIndexName);
+	}
+}
+
+// Looks up each key through the model and returns the number of keys found
+int learnedLookups(LearnedIndex *learned, const std::vector<int> &keys)
+{
+	int found = 0;
+	RecordId rid;
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		if(learned->lookup(keys[i], rid))
+		{
+			found++;
+		}
+	}
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// hashIndexTests
+// -----------------------------------------------------------------------------
+
+void hashIndexTests()
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 20 * relationSize; i++)
+	{
+		keys.push_back(i);
+	}
+	std::vector<int> missing;
+	for(int i = 1; i <= 1000; i++)
+	{
+		missing.push_back(-i);
+		missing.push_back(20 * relationSize + i * 7919);
+	}
+
+	std::string hashIndexName;
+	{
+		HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getNumEntries(), 20 * relationSize)
+		checkPassFail(hashLookups(&index, keys), 20 * relationSize)
+		checkPassFail(hashLookups(&index, missing), 0)
+
+		// Buckets are split as the index grows, keeping them about HASHFILLPERCENT full
+		int bucketsNeeded = 20 * relationSize / HashBucket::capacity(Page::SIZE);
+		checkPassFail((index.getNumBuckets() > bucketsNeeded && index.getNumBuckets() < 2 * bucketsNeeded), true)
+
+		// Same records as the B+ tree
+		BTreeIndex btree(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1);
+		RecordId hashRid;
+		RecordId scanRid;
+		bool same = true;
+		for(int key = 0; key < 20 * relationSize; key += 97)
+		{
+			index.lookup(&key, hashRid);
+			btree.startScan(&key, GTE, &key, LTE);
+			btree.scanNext(scanRid);
+			btree.endScan();
+			same = same && hashRid.page_number == scanRid.page_number && hashRid.slot_number == scanRid.slot_number;
+		}
+		checkPassFail(same, true)
+
+		// Duplicates, then deletes
+		int key = 42;
+		RecordId extraRids[3] = {{1, 101}, {2, 102}, {3, 103}};
+		for(int i = 0; i < 3; i++)
+		{
+			index.insertEntry(&key, extraRids[i]);
+		}
+		std::vector<RecordId> rids;
+		index.lookupAll(&key, rids);
+		checkPassFail(rids.size(), 4)
+		checkPassFail(index.deleteEntry(&key, extraRids[1]), true)
+		checkPassFail(index.deleteEntry(&key, extraRids[1]), false)
+		rids.clear();
+		index.lookupAll(&key, rids);
+		checkPassFail(rids.size(), 3)
+		// Key 42 keeps two of its entries
+		for(int i = 0; i < 20 * relationSize; i += 2)
+		{
+			index.lookup(&i, hashRid);
+			index.deleteEntry(&i, hashRid);
+		}
+		checkPassFail(index.getNumEntries(), 10 * relationSize + 2)
+	}
+	File::remove(intIndexName);
+
+	// The buckets and split state are kept in the index file
+	{
+		std::string reopenedName;
+		HashIndex index(relationName, reopenedName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail((reopenedName == hashIndexName), true)
+		checkPassFail(index.getNumEntries(), 10 * relationSize + 2)
+		checkPassFail(hashLookups(&index, keys), 10 * relationSize + 1)
+		checkPassFail(hashLookups(&index, missing), 0)
+		for(int i = 0; i < 20 * relationSize; i += 2)
+		{
+			RecordId rid = {1, 1};
+			index.insertEntry(&i, rid);
+		}
+		checkPassFail(hashLookups(&index, keys), 20 * relationSize)
+	}
+	File::remove(hashIndexName);
+
+	// Only INTEGER keys hash
+	bool thrown = false;
+	try
+	{
+		std::string indexName;
+		HashIndex index(relationName, indexName, bufMgr, offsetof(tuple,d), DOUBLE);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		thrown = true;
+	}
+	checkPassFail(thrown, true)
+}
+
+// -----------------------------------------------------------------------------
+// hashIndexBenchmark
+// -----------------------------------------------------------------------------
+
+void hashIndexBenchmark()
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 20000; i++)
+	{
+		keys.push_back(random() % (20 * relationSize));
+	}
+
+	// Point probes on a hash index and on a B+ tree over the same attribute
+	int pageSizes[] = {Page::SIZE, 512};
+	for(int p = 0; p < 2; p++)
+	{
+		std::string hashIndexName;
+		{
+			BTreeIndex btree(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, pageSizes[p]);
+			HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER, pageSizes[p]);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			checkPassFail(intLookups(&btree, keys), 20000)
+			double descent = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			start = std::chrono::steady_clock::now();
+			checkPassFail(hashLookups(&index, keys), 20000)
+			double probe = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::cout << "Seconds for 20000 lookups, " << pageSizes[p] << " byte pages: btree " << descent
+				<< ", hash " << probe << " (" << index.getNumBuckets() << " buckets, "
+				<< (double)index.getPagesRead() / keys.size() << " pages per lookup)" << std::endl;
+			if(index.getPagesRead() > (int)keys.size() * 12 / 10)
+			{
+				std::cout << "Hash probes read too many overflow pages" << std::endl;
+				exit(1);
+			}
+		}
+		File::remove(hashIndexName);
+		File::remove(intIndexName);
+	}
+}
+
+// Probes each key on its own and returns the number of keys found
+int hashLookups(HashIndex *index, const std::vector<int> &keys)
+{
+	int found = 0;
+	RecordId rid;
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		if(index->lookup(&keys[i], rid))
+		{
+			found++;
+		}
+	}
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// bufferedNodeTests
+// -----------------------------------------------------------------------------
+
+void bufferedNodeTests()
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 1000; i++)
+	{
+		keys.push_back(random() % (20 * relationSize));
+	}
+	int vals[] = {100, 200, 5000, 5100};
+	std::vector<ScanRange> ranges;
+	ranges.push_back({&vals[0], GTE, &vals[1], LT});
+	ranges.push_back({&vals[2], GTE, &vals[3], LTE});
+
+	// Built by inserts, most entries are still in the buffers, so scans have to merge them
+	int pageSizes[] = {Page::SIZE, 512};
+	for(int p = 0; p < 2; p++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0, pageSizes[p],
+				LEAF_PLAIN, NONLEAF_BUFFERED);
+			checkPassFail(index.getNonLeafFormat(), NONLEAF_BUFFERED)
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT,10), 10)
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize,LT), 20 * relationSize)
+			checkPassFail(intMultiRangeScan(&index, ranges), 201)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+
+		// The format and the buffers are kept in the index file
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(index.getNonLeafFormat(), NONLEAF_BUFFERED)
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize,LT), 20 * relationSize)
+			checkPassFail(intLookups(&index, keys), 1000)
+
+			index.flushBuffers();
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize,LT), 20 * relationSize)
+			checkPassFail(intMultiRangeScan(&index, ranges), 201)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+		File::remove(intIndexName);
+	}
+
+	// Bulk loads leave the buffers empty, later inserts fill them
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, 512,
+			LEAF_PLAIN, NONLEAF_BUFFERED);
+		RecordId keyRid = {1, 1};
+		for(int key = 20 * relationSize; key < 21 * relationSize; key++)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intKeyScan(&index,0,GTE,21 * relationSize,LT), 21 * relationSize)
+		checkPassFail(intKeyScan(&index,20 * relationSize - 10,GTE,20 * relationSize + 10,LT), 20)
+		checkPassFail(intScan(&index,0,GTE,21 * relationSize,LT,0), 0)
+	}
+	File::remove(intIndexName);
+
+	// Only INTEGER keys are buffered
+	bool thrown = false;
+	try
+	{
+		std::string indexName;
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,d), DOUBLE, 0, Page::SIZE,
+			LEAF_PLAIN, NONLEAF_BUFFERED);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		thrown = true;
+	}
+	checkPassFail(thrown, true)
+}
+
+// -----------------------------------------------------------------------------
+// bufferedNodeBenchmark
+// -----------------------------------------------------------------------------
+
+void bufferedNodeBenchmark()
+{
+	// Distinct keys above the relation in random order
+	const int numInserts = 400000;
+	std::vector<int> keys(numInserts);
+	for(int i = 0; i < numInserts; i++)
+	{
+		keys[i] = 20 * relationSize + i;
+	}
+	for(int i = numInserts - 1; i > 0; i--)
+	{
+		std::swap(keys[i], keys[random() % (i + 1)]);
+	}
+
+	// Random inserts until the tree is about ten times larger than the buffer pool, with plain
+	// and with buffered non-leaf nodes; buffered inserts end with every buffer flushed
+	int io[2];
+	for(int f = 0; f < 2; f++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bufMgr->clearBufStats();
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, Page::SIZE,
+				LEAF_PLAIN, f == 0 ? NONLEAF_PLAIN : NONLEAF_BUFFERED);
+			RecordId keyRid = {1, 1};
+			for(int i = 0; i < numInserts; i++)
+			{
+				index.insertEntry(&keys[i], keyRid);
+			}
+			index.flushBuffers();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		BufStats stats = bufMgr->getBufStats();
+		io[f] = stats.diskreads + stats.diskwrites;
+		std::cout << "Seconds for " << numInserts << " random inserts, " << (f == 0 ? "plain" : "buffered")
+			<< " non-leaf nodes: " << seconds << " (" << stats.diskreads << " page reads, "
+			<< stats.diskwrites << " page writes)" << std::endl;
+
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize + numInserts,LT), 20 * relationSize + numInserts)
+		}
+		File::remove(intIndexName);
+	}
+	if( io[1] * 10 > io[0] )
+	{
+		std::cout << "Buffered non-leaf nodes did not save nine in ten page reads and writes" << std::endl;
+		exit(1);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// deltaIndexTests
+// -----------------------------------------------------------------------------
+
+void deltaIndexTests()
+{
+	RecordId keyRid = {1, 1};
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1);
+		DeltaIndex delta(&index, 1000);
+
+		// Entries in the memtable only, below and above the keys of the tree
+		for(int key = -1; key >= -500; key--)
+		{
+			delta.insertEntry(&key, keyRid);
+		}
+		for(int key = 21 * relationSize; key < 21 * relationSize + 400; key++)
+		{
+			delta.insertEntry(&key, keyRid);
+		}
+		checkPassFail(delta.getNumBuffered(), 900)
+		checkPassFail(delta.getNumFlushes(), 0)
+		checkPassFail(deltaKeyScan(&delta,-500,GTE,21 * relationSize + 400,LT), 20 * relationSize + 900)
+		checkPassFail(deltaKeyScan(&delta,-10,GT,10,LT), 19)
+		checkPassFail(deltaKeyScan(&delta,21 * relationSize,GTE,21 * relationSize + 10,LTE), 11)
+		checkPassFail(deltaKeyScan(&delta,-500,GTE,100,LT,50), 50)
+		checkPassFail(intKeyScan(&index,-500,GTE,21 * relationSize + 400,LT), 20 * relationSize)
+
+		// A flush waits for the end of a running scan
+		int low = 0;
+		int high = 100;
+		delta.startScan(&low, GTE, &high, LT);
+		for(int key = 21 * relationSize + 400; key < 21 * relationSize + 600; key++)
+		{
+			delta.insertEntry(&key, keyRid);
+		}
+		checkPassFail(delta.getNumBuffered(), 1100)
+		delta.endScan();
+		checkPassFail(delta.getNumBuffered(), 0)
+		checkPassFail(delta.getNumFlushes(), 1)
+		checkPassFail(intKeyScan(&index,-500,GTE,21 * relationSize + 600,LT), 20 * relationSize + 1100)
+
+		// The rest is flushed when the DeltaIndex goes away
+		for(int key = 22 * relationSize; key < 22 * relationSize + 10; key++)
+		{
+			delta.insertEntry(&key, keyRid);
+		}
+		checkPassFail(deltaKeyScan(&delta,-500,GTE,22 * relationSize + 10,LT), 20 * relationSize + 1110)
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intKeyScan(&index,-500,GTE,22 * relationSize + 10,LT), 20 * relationSize + 1110)
+	}
+	File::remove(intIndexName);
+
+	// Only INTEGER indexes take a delta tier
+	bool thrown = false;
+	std::string doubleIndexName;
+	{
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, 1);
+		try
+		{
+			DeltaIndex delta(&index);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+	}
+	File::remove(doubleIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// deltaIndexBenchmark
+// -----------------------------------------------------------------------------
+
+void deltaIndexBenchmark()
+{
+	// Distinct keys above the relation in random order
+	const int numInserts = 400000;
+	std::vector<int> keys(numInserts);
+	for(int i = 0; i < numInserts; i++)
+	{
+		keys[i] = 20 * relationSize + i;
+	}
+	for(int i = numInserts - 1; i > 0; i--)
+	{
+		std::swap(keys[i], keys[random() % (i + 1)]);
+	}
+
+	// Random inserts until the tree is about ten times larger than the buffer pool: straight into
+	// the tree, in sorted batches of DELTAFLUSHTHRESHOLD inserted one by one, and through a
+	// DeltaIndex whose flushes merge the same batches
+	const char *modes[3] = {"direct", "sorted batches inserted one by one", "through a memtable"};
+	int io[3];
+	double seconds[3];
+	for(int d = 0; d < 3; d++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bufMgr->clearBufStats();
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1);
+			RecordId keyRid = {1, 1};
+			if(d == 0)
+			{
+				for(int i = 0; i < numInserts; i++)
+				{
+					index.insertEntry(&keys[i], keyRid);
+				}
+			}
+			else if(d == 1)
+			{
+				std::vector<int> batch;
+				for(int i = 0; i < numInserts; i += DELTAFLUSHTHRESHOLD)
+				{
+					batch.assign(keys.begin() + i, keys.begin() + std::min(i + DELTAFLUSHTHRESHOLD, numInserts));
+					std::sort(batch.begin(), batch.end());
+					for(size_t j = 0; j < batch.size(); j++)
+					{
+						index.insertEntry(&batch[j], keyRid);
+					}
+				}
+			}
+			else
+			{
+				DeltaIndex delta(&index);
+				for(int i = 0; i < numInserts; i++)
+				{
+					delta.insertEntry(&keys[i], keyRid);
+				}
+			}
+		}
+		seconds[d] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		BufStats stats = bufMgr->getBufStats();
+		io[d] = stats.diskreads + stats.diskwrites;
+		std::cout << "Seconds for " << numInserts << " random inserts, " << modes[d] << ": " << seconds[d]
+			<< " (" << (int)(numInserts / seconds[d]) << " inserts per second, " << stats.diskreads << " page reads, "
+			<< stats.diskwrites << " page writes)" << std::endl;
+
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize + numInserts,LT), 20 * relationSize + numInserts)
+		}
+		File::remove(intIndexName);
+	}
+	if( io[2] * 10 > io[0] )
+	{
+		std::cout << "The memtable did not save nine in ten page reads and writes" << std::endl;
+		exit(1);
+	}
+
+	// Merging a batch writes full leaves once, where inserting it key by key splits them; the
+	// timings above are only printed, the page reads and writes decide
+	checkPassFail((io[2] < io[1]), true)
+}
+
+// Scans the delta tier and the tree together and returns the number of entries, checking their order
+int deltaKeyScan(DeltaIndex *delta, int lowVal, Operator lowOp, int highVal, Operator highOp, int limit)
+{
+	RecordId scanRid;
+	int key;
+	int lastKey = 0;
+	int numResults = 0;
+
+	delta->startScan(&lowVal, lowOp, &highVal, highOp, limit);
+	while(1)
+	{
+		try
+		{
+			delta->scanNext(scanRid, &key);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		if( (lowOp == GT && key <= lowVal) || (lowOp == GTE && key < lowVal) ||
+				(highOp == LT && key >= highVal) || (highOp == LTE && key > highVal) ||
+				(numResults > 0 && key < lastKey) )
+		{
+			std::cout << "Delta scan returned bad key " << key << std::endl;
+			exit(1);
+		}
+		lastKey = key;
+		numResults++;
+	}
+	delta->endScan();
+
+	std::cout << "Delta scan for [" << lowVal << "," << highVal << "]: " << numResults << " results" << std::endl;
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// appendLeafTests
+// -----------------------------------------------------------------------------
+
+void appendLeafTests()
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 1000; i++)
+	{
+		keys.push_back(random() % (20 * relationSize));
+	}
+
+	// Built by inserts in random order, so leaves are read with unsorted tails
+	int pageSizes[] = {Page::SIZE, 512};
+	for(int p = 0; p < 2; p++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0, pageSizes[p], LEAF_APPEND);
+			checkPassFail(index.getLeafFormat(), LEAF_APPEND)
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize,LT), 20 * relationSize)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+
+		// The format and the tails are kept in the index file
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(index.getLeafFormat(), LEAF_APPEND)
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize,LT), 20 * relationSize)
+
+			// Keys below the others fill the tail of the first leaf past its size
+			RecordId keyRid = {1, 1};
+			for(int key = -1; key >= -2 * LEAFTAILSIZE; key--)
+			{
+				index.insertEntry(&key, keyRid);
+			}
+			checkPassFail(intKeyScan(&index,-2 * LEAFTAILSIZE,GTE,0,LT), 2 * LEAFTAILSIZE)
+			checkPassFail(intKeyScan(&index,-5,GTE,5,LT), 10)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+		File::remove(intIndexName);
+	}
+
+	// Bulk loads leave no tails, later inserts start them
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, Page::SIZE, LEAF_APPEND);
+		RecordId keyRid = {1, 1};
+		for(int key = 21 * relationSize - 1; key >= 20 * relationSize; key--)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intKeyScan(&index,0,GTE,21 * relationSize,LT), 21 * relationSize)
+		checkPassFail(intKeyScan(&index,20 * relationSize - 10,GTE,20 * relationSize + 10,LT), 20)
+	}
+	File::remove(intIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// appendLeafBenchmark
+// -----------------------------------------------------------------------------
+
+void appendLeafBenchmark()
+{
+	// Distinct keys above the relation in random order
+	const int numInserts = 200000;
+	std::vector<int> keys(numInserts);
+	for(int i = 0; i < numInserts; i++)
+	{
+		keys[i] = 20 * relationSize + i;
+	}
+	for(int i = numInserts - 1; i > 0; i--)
+	{
+		std::swap(keys[i], keys[random() % (i + 1)]);
+	}
+
+	// Random inserts into plain leaves, which shift the entries after the new one, and into
+	// append leaves, which shift entries only when they merge a tail
+	long long moved[2];
+	LeafFormat formats[] = {LEAF_PLAIN, LEAF_APPEND};
+	for(int f = 0; f < 2; f++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, Page::SIZE, formats[f]);
+			RecordId keyRid = {1, 1};
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numInserts; i++)
+			{
+				index.insertEntry(&keys[i], keyRid);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			moved[f] = index.getLeafBytesMoved();
+			std::cout << "Seconds for " << numInserts << " random inserts, " << (f == 0 ? "plain" : "append")
+				<< " leaves: " << seconds << " (" << moved[f] / 1048576.0 << " MB of entries moved)" << std::endl;
+			checkPassFail(intKeyScan(&index,0,GTE,20 * relationSize + numInserts,LT), 20 * relationSize + numInserts)
+		}
+		File::remove(intIndexName);
+	}
+	if( moved[1] * 4 > moved[0] )
+	{
+		std::cout << "Append leaves did not move a quarter of the bytes plain leaves move" << std::endl;
+		exit(1);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// mergeTests
+// -----------------------------------------------------------------------------
+
+void mergeTests()
+{
+	const int numKeys = 20 * relationSize;
+	std::vector<int> keys;
+	for(int i = 0; i < 1000; i++)
+	{
+		keys.push_back(random() % (3 * numKeys));
+	}
+
+	int pageSizes[] = {Page::SIZE, Page::SIZE, 512, 512};
+	LeafFormat leafFormats[] = {LEAF_PLAIN, LEAF_PACKED, LEAF_APPEND, LEAF_PLAIN};
+	NonLeafFormat nonLeafFormats[] = {NONLEAF_PLAIN, NONLEAF_PLAIN, NONLEAF_PLAIN, NONLEAF_BUFFERED};
+	for(int c = 0; c < 4; c++)
+	{
+		std::vector<int> batch;
+		std::vector<RecordId> rids;
+		RecordId keyRid = {1, 1};
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1, pageSizes[c],
+				leafFormats[c], nonLeafFormats[c]);
+
+			// Inserts still buffered above the leaves go down before the merge
+			for(int key = -1001; key >= -2000; key--)
+			{
+				index.insertEntry(&key, keyRid);
+			}
+
+			// Even keys above the largest one are appended as new leaves at the right edge
+			for(int key = numKeys; key < 3 * numKeys; key += 2)
+			{
+				batch.push_back(key);
+			}
+			rids.assign(batch.size(), keyRid);
+			index.mergeSortedEntries(&batch[0], &rids[0], batch.size());
+			checkPassFail(intKeyScan(&index,-2000,GTE,3 * numKeys,LT), 2 * numKeys + 1000)
+			checkPassFail(intScan(&index,numKeys - 5,GTE,numKeys + 5,LT), 8)
+
+			// Odd keys go between them, into every leaf of the right part
+			batch.clear();
+			for(int key = numKeys + 1; key < 3 * numKeys; key += 2)
+			{
+				batch.push_back(key);
+			}
+			rids.assign(batch.size(), keyRid);
+			index.mergeSortedEntries(&batch[0], &rids[0], batch.size());
+			checkPassFail(intKeyScan(&index,-2000,GTE,3 * numKeys,LT), 3 * numKeys + 1000)
+			checkPassFail(intScan(&index,numKeys - 5,GTE,numKeys + 5,LT), 10)
+			checkPassFail(intLookups(&index, keys), 1000)
+			checkPassFail(index.getNodeLayout(), LAYOUT_SORTED)
+		}
+
+		// The merged leaves and the rebuilt levels are in the index file
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(index.getLeafFormat(), leafFormats[c])
+			checkPassFail(intKeyScan(&index,-2000,GTE,3 * numKeys,LT), 3 * numKeys + 1000)
+			checkPassFail(intLookups(&index, keys), 1000)
+
+			// A batch out of key order is sorted first, and keys below the smallest one go into the
+			// first leaf; the rebuilt nodes keep the layout, and the tree still takes single inserts
+			// afterwards
+			index.setNodeLayout(LAYOUT_EYTZINGER);
+			batch.clear();
+			for(int key = -1; key >= -1000; key--)
+			{
+				batch.push_back(key);
+			}
+			rids.assign(batch.size(), keyRid);
+			index.mergeSortedEntries(&batch[0], &rids[0], batch.size());
+			checkPassFail(index.getNodeLayout(), LAYOUT_EYTZINGER)
+			checkPassFail(intKeyScan(&index,-1005,GTE,5,LT), 1010)
+			checkPassFail(intLookups(&index, keys), 1000)
+			int key = 3 * numKeys;
+			index.insertEntry(&key, keyRid);
+			checkPassFail(intKeyScan(&index,-2000,GTE,3 * numKeys,LTE), 3 * numKeys + 2001)
+			checkPassFail(intKeyScan(&index,-1005,GTE,5,LT), 1010)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+		File::remove(intIndexName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// mergeBenchmark
+// -----------------------------------------------------------------------------
+
+void mergeBenchmark()
+{
+	// A sorted batch of odd keys going between the even keys of an index built from the relation and
+	// a merged batch of even keys, inserted one by one and merged. Both sweep the leaves once, so
+	// the page reads and writes are about the same; the merge saves a descent and a shift per key,
+	// and the shifts are counted in the leaf bytes moved
+	const int numKeys = 20 * relationSize;
+	const int numInserts = 200000;
+	std::vector<int> evenKeys;
+	std::vector<int> oddKeys;
+	for(int i = 0; i < numInserts; i++)
+	{
+		evenKeys.push_back(numKeys + 2 * i);
+		oddKeys.push_back(numKeys + 2 * i + 1);
+	}
+	std::vector<RecordId> rids(numInserts);
+	for(int i = 0; i < numInserts; i++)
+	{
+		rids[i].page_number = 1 + i / 100;
+		rids[i].slot_number = 1 + i % 100;
+	}
+
+	double seconds[2];
+	long long bytesMoved[2];
+	for(int m = 0; m < 2; m++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1);
+			index.mergeSortedEntries(&evenKeys[0], &rids[0], numInserts);
+
+			bufMgr->clearBufStats();
+			long long movedBefore = index.getLeafBytesMoved();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if(m == 0)
+			{
+				for(int i = 0; i < numInserts; i++)
+				{
+					index.insertEntry(&oddKeys[i], rids[i]);
+				}
+			}
+			else
+			{
+				index.mergeSortedEntries(&oddKeys[0], &rids[0], numInserts);
+			}
+			seconds[m] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			bytesMoved[m] = index.getLeafBytesMoved() - movedBefore;
+			BufStats stats = bufMgr->getBufStats();
+			std::cout << "Seconds for " << numInserts << " sorted inserts, " << (m == 0 ? "one by one" : "merged")
+				<< ": " << seconds[m] << " (" << stats.diskreads << " page reads, " << stats.diskwrites << " page writes, "
+				<< bytesMoved[m] << " leaf bytes moved)" << std::endl;
+			checkPassFail(intKeyScan(&index,0,GTE,numKeys + 2 * numInserts,LT), numKeys + 2 * numInserts)
+		}
+		File::remove(intIndexName);
+	}
+	checkPassFail((bytesMoved[0] > 0), true)
+	checkPassFail(bytesMoved[1], 0)
+}
+
+// -----------------------------------------------------------------------------
+// defragmentTests
+// -----------------------------------------------------------------------------
+
+void defragmentTests()
+{
+	const int numKeys = 20 * relationSize;
+	std::vector<int> keys;
+	for(int i = 0; i < 1000; i++)
+	{
+		keys.push_back(random() % numKeys);
+	}
+
+	int pageSizes[] = {Page::SIZE, Page::SIZE, 512, 512};
+	LeafFormat leafFormats[] = {LEAF_PLAIN, LEAF_PACKED, LEAF_APPEND, LEAF_PLAIN};
+	NonLeafFormat nonLeafFormats[] = {NONLEAF_PLAIN, NONLEAF_PLAIN, NONLEAF_PLAIN, NONLEAF_BUFFERED};
+	for(int c = 0; c < 4; c++)
+	{
+		// Built by inserts in random order, so the leaves are spread over the file
+		long long fragmentedBytes;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0, pageSizes[c],
+				leafFormats[c], nonLeafFormats[c]);
+			checkPassFail(intKeyScan(&index,0,GTE,numKeys,LT), numKeys)
+			checkPassFail((index.getLeafJumps() > 0), true)
+		}
+		fragmentedBytes = fileBytes(intIndexName);
+
+		// Full leaves in key order take fewer pages, and scans go from each to the next page
+		long long fullBytes;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			int low = 100;
+			int high = 200;
+			index.setNodeLayout(LAYOUT_EYTZINGER);
+			index.startScan(&low, GTE, &high, LT);
+			index.defragment();
+			checkPassFail(index.getNodeLayout(), LAYOUT_EYTZINGER)
+			checkPassFail(intKeyScan(&index,0,GTE,numKeys,LT), numKeys)
+			checkPassFail(index.getLeafJumps(), 0)
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+		fullBytes = fileBytes(intIndexName);
+		checkPassFail((fullBytes < fragmentedBytes), true)
+
+		// Half full leaves take about twice the pages; the index still takes inserts afterwards
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(index.getLeafFormat(), leafFormats[c])
+			checkPassFail(intKeyScan(&index,0,GTE,numKeys,LT), numKeys)
+			checkPassFail(index.getLeafJumps(), 0)
+			index.defragment(50);
+			checkPassFail((fileBytes(intIndexName) > fullBytes * 3 / 2), true)
+			checkPassFail(intKeyScan(&index,0,GTE,numKeys,LT), numKeys)
+			checkPassFail(index.getLeafJumps(), 0)
+
+			RecordId keyRid = {1, 1};
+			for(int key = -1; key >= -1000; key--)
+			{
+				index.insertEntry(&key, keyRid);
+			}
+			checkPassFail(intKeyScan(&index,-1000,GTE,numKeys,LT), numKeys + 1000)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(intKeyScan(&index,-1000,GTE,numKeys,LT), numKeys + 1000)
+			checkPassFail(intLookups(&index, keys), 1000)
+		}
+		File::remove(intIndexName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// defragmentBenchmark
+// -----------------------------------------------------------------------------
+
+void defragmentBenchmark()
+{
+	// Distinct keys above the relation in random order
+	const int numKeys = 20 * relationSize;
+	const int numInserts = 200000;
+	std::vector<int> keys(numInserts);
+	for(int i = 0; i < numInserts; i++)
+	{
+		keys[i] = numKeys + i;
+	}
+	for(int i = numInserts - 1; i > 0; i--)
+	{
+		std::swap(keys[i], keys[random() % (i + 1)]);
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1);
+		RecordId keyRid = {1, 1};
+		for(int i = 0; i < numInserts; i++)
+		{
+			index.insertEntry(&keys[i], keyRid);
+		}
+	}
+
+	// Full scans with the index file out of the page cache, before and after defragmenting it
+	int jumps[2];
+	for(int d = 0; d < 2; d++)
+	{
+		dropFileCache(intIndexName);
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			checkPassFail(intKeyScan(&index,0,GTE,numKeys + numInserts,LT), numKeys + numInserts)
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			jumps[d] = index.getLeafJumps();
+			std::cout << "Seconds for a cold scan of " << numKeys + numInserts << " entries, " << (d == 0 ? "fragmented" : "defragmented")
+				<< ": " << seconds << " (" << jumps[d] << " jumps between leaves, " << fileBytes(intIndexName) / 1024 << " KB file)" << std::endl;
+			if(d == 0)
+			{
+				index.defragment();
+			}
+		}
+	}
+	File::remove(intIndexName);
+	if( jumps[0] == 0 || jumps[1] != 0 )
+	{
+		std::cout << "Defragmenting did not put the leaves in key order" << std::endl;
+		exit(1);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// extentTests
+// -----------------------------------------------------------------------------
+
+void extentTests()
+{
+	const int numKeys = 20 * relationSize;
+	std::vector<int> keys;
+	for(int i = 0; i < 1000; i++)
+	{
+		keys.push_back(random() % (2 * numKeys));
+	}
+
+	// Ascending inserts into an empty index fill one leaf after the other
+	RecordId keyRid = {1, 1};
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFERREDBUILD, 512);
+		checkPassFail(index.getExtentPages(), EXTENTPAGES)
+		for(int key = 0; key < numKeys; key++)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intKeyScan(&index,0,GTE,numKeys,LT), numKeys)
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	}
+	checkPassFail((fileBytes(intIndexName) % (512 * EXTENTPAGES) != 0), true)
+
+	// The extents and their positions are in the meta page; pages reserved before are used up
+	// first after extents are turned off
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getExtentPages(), EXTENTPAGES)
+		for(int key = numKeys; key < 3 * numKeys / 2; key++)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		index.setExtentPages(1);
+		checkPassFail(index.getExtentPages(), 1)
+		for(int key = 3 * numKeys / 2; key < 2 * numKeys; key++)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intKeyScan(&index,0,GTE,2 * numKeys,LT), 2 * numKeys)
+		checkPassFail(intLookups(&index, keys), 1000)
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getExtentPages(), 1)
+		checkPassFail(intKeyScan(&index,0,GTE,2 * numKeys,LT), 2 * numKeys)
+		checkPassFail(intLookups(&index, keys), 1000)
+
+		// Defragmenting drops what is left of the extents with the pages after the tree
+		index.setExtentPages(EXTENTPAGES);
+		index.defragment(50);
+		int jumps = index.getLeafJumps();
+		checkPassFail(intKeyScan(&index,0,GTE,2 * numKeys,LT), 2 * numKeys)
+		checkPassFail(index.getLeafJumps() - jumps, 0)
+		for(int key = -1; key >= -1000; key--)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intKeyScan(&index,-1000,GTE,2 * numKeys,LT), 2 * numKeys + 1000)
+		checkPassFail(intLookups(&index, keys), 1000)
+	}
+	File::remove(intIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// extentBenchmark
+// -----------------------------------------------------------------------------
+
+void extentBenchmark()
+{
+	// Ascending inserts split the last leaf again and again; allocated page by page, every split of
+	// a non-leaf node puts a page between two leaves
+	const int numInserts = 200000;
+	int jumps[2];
+	int extents[] = {1, EXTENTPAGES};
+	for(int e = 0; e < 2; e++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFERREDBUILD, 512);
+			index.setExtentPages(extents[e]);
+			RecordId keyRid = {1, 1};
+			for(int key = 0; key < numInserts; key++)
+			{
+				index.insertEntry(&key, keyRid);
+			}
+		}
+		dropFileCache(intIndexName);
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			checkPassFail(intKeyScan(&index,0,GTE,numInserts,LT), numInserts)
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			jumps[e] = index.getLeafJumps();
+			std::cout << "Seconds for a cold scan of " << numInserts << " ascending inserts, " << extents[e] << " page extents: "
+				<< seconds << " (" << jumps[e] << " jumps between leaves)" << std::endl;
+		}
+		File::remove(intIndexName);
+	}
+	if( jumps[1] * 10 > jumps[0] )
+	{
+		std::cout << "Extents did not save nine in ten jumps between leaves" << std::endl;
+		exit(1);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// freeListTests
+// -----------------------------------------------------------------------------
+
+void freeListTests()
+{
+	const std::string blobName = "relA.blob";
+	std::vector<PageId> pageNos(10);
+	{
+		BlobFile blob(blobName, true);
+		for(int i = 0; i < 10; i++)
+		{
+			Page *page;
+			bufMgr->allocPage(&blob, pageNos[i], page);
+			*(int *)page = i;
+			bufMgr->unPinPage(&blob, pageNos[i], true);
+		}
+		bufMgr->flushFile(&blob);
+
+		// Pages in the buffer pool or only on disk go to the free list, pinned ones do not
+		Page *page;
+		bufMgr->readPage(&blob, pageNos[3], page);
+		bool thrown = false;
+		try
+		{
+			bufMgr->disposePage(&blob, pageNos[3]);
+		}
+		catch(const PagePinnedException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+		bufMgr->unPinPage(&blob, pageNos[3], false);
+		bufMgr->disposePage(&blob, pageNos[3]);
+		bufMgr->disposePage(&blob, pageNos[5]);
+		bufMgr->disposePage(&blob, pageNos[7]);
+		checkPassFail(blob.numFreePages(), 3)
+
+		thrown = false;
+		try
+		{
+			bufMgr->disposePage(&blob, pageNos[9] + 1);
+		}
+		catch(const InvalidPageException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+
+		// A free page deleted again would be handed out twice
+		thrown = false;
+		try
+		{
+			bufMgr->disposePage(&blob, pageNos[5]);
+		}
+		catch(const InvalidPageException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+		checkPassFail(blob.numFreePages(), 3)
+
+		// A used page whose data looks like a free page is still deleted
+		bufMgr->readPage(&blob, pageNos[8], page);
+		*(PageId *)((char *)page + offsetof(PageHeader, current_page_number)) = 0xFFFFFFFF;
+		*(PageId *)((char *)page + offsetof(PageHeader, prev_page_number)) = pageNos[8];
+		bufMgr->unPinPage(&blob, pageNos[8], true);
+		bufMgr->disposePage(&blob, pageNos[8]);
+		checkPassFail(blob.numFreePages(), 4)
+		PageId pageNo;
+		bufMgr->allocPage(&blob, pageNo, page);
+		checkPassFail(pageNo, pageNos[8])
+		bufMgr->unPinPage(&blob, pageNo, true);
+		bufMgr->flushFile(&blob);
+	}
+
+	// The free list is in the file; pages come back last deleted first and empty, and the file
+	// only grows once the list is empty
+	long long bytes = fileBytes(blobName);
+	{
+		BlobFile blob(blobName, false);
+		checkPassFail(blob.numFreePages(), 3)
+		PageId expected[] = {pageNos[7], pageNos[5], pageNos[3], pageNos[9] + 1};
+		Page emptyPage;
+		for(int i = 0; i < 4; i++)
+		{
+			PageId pageNo;
+			Page *page;
+			bufMgr->allocPage(&blob, pageNo, page);
+			checkPassFail(pageNo, expected[i])
+			checkPassFail(memcmp(page, &emptyPage, Page::SIZE), 0)
+			bufMgr->unPinPage(&blob, pageNo, true);
+		}
+		checkPassFail(blob.numFreePages(), 0)
+		Page *page;
+		bufMgr->readPage(&blob, pageNos[4], page);
+		checkPassFail(*(int *)page, 4)
+		bufMgr->unPinPage(&blob, pageNos[4], false);
+		bufMgr->flushFile(&blob);
+	}
+	checkPassFail(fileBytes(blobName), bytes + (long long)Page::SIZE)
+	File::remove(blobName);
+
+	// A merge rebuilds the half full non-leaf nodes of a tree built by inserts into full ones and
+	// hands the pages left over back to the file; splits of non-leaf nodes take them again
+	const int numKeys = 20 * relationSize;
+	RecordId keyRid = {1, 1};
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0, 512);
+		int key = numKeys;
+		index.mergeSortedEntries(&key, &keyRid, 1);
+		PageId freed = BlobFile(intIndexName, false).numFreePages();
+		checkPassFail((freed > 0), true)
+		checkPassFail(intKeyScan(&index,0,GTE,numKeys,LTE), numKeys + 1)
+
+		for(key = numKeys + 1; key < 2 * numKeys; key++)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail((BlobFile(intIndexName, false).numFreePages() < freed), true)
+		checkPassFail(intKeyScan(&index,0,GTE,2 * numKeys,LT), 2 * numKeys)
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intKeyScan(&index,0,GTE,2 * numKeys,LT), 2 * numKeys)
+	}
+	File::remove(intIndexName);
+}
+
+void pageFileTests()
+{
+	const std::string name = "relA.pages";
+	std::vector<PageId> pageNos(10);
+	{
+		PageFile file(name, true);
+		for(int i = 0; i < 10; i++)
+		{
+			Page page = file.allocatePage(pageNos[i]);
+			sprintf(record1.s, "%05d string record", i);
+			record1.i = i;
+			record1.d = (double)i;
+			page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+			file.writePage(pageNos[i], page);
+		}
+		checkPassFail((usedPages(file) == pageNos), true)
+
+		// The first, a middle and the last page
+		file.deletePage(pageNos[0]);
+		file.deletePage(pageNos[5]);
+		file.deletePage(pageNos[9]);
+		std::vector<PageId> expected;
+		for(int i = 1; i < 9; i++)
+		{
+			if(i != 5)
+			{
+				expected.push_back(pageNos[i]);
+			}
+		}
+		checkPassFail((usedPages(file) == expected), true)
+
+		bool thrown = false;
+		try
+		{
+			file.deletePage(pageNos[5]);
+		}
+		catch(const InvalidPageException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+		thrown = false;
+		try
+		{
+			file.deletePage(pageNos[9] + 1);
+		}
+		catch(const InvalidPageException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+
+		// Deleted pages come back last deleted first and go after the last used page
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, pageNos[9])
+		expected.push_back(pageNo);
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, pageNos[5])
+		expected.push_back(pageNo);
+		checkPassFail((usedPages(file) == expected), true)
+	}
+
+	// The links survive reopening the file, and records on the pages kept are untouched
+	{
+		PageFile file(name, false);
+		std::vector<PageId> pages = usedPages(file);
+		checkPassFail(pages.size(), 9u)
+		checkPassFail(pages.front(), pageNos[1])
+		checkPassFail(pages.back(), pageNos[5])
+		Page page = file.readPage(pageNos[4]);
+		std::string recordStr = page.getRecord({pageNos[4], 1});
+		checkPassFail(((const RECORD *)recordStr.c_str())->i, 4)
+
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, pageNos[0])
+		file.deletePage(pageNos[1]);
+		file.deletePage(pageNos[5]);
+		pages = usedPages(file);
+		checkPassFail(pages.size(), 8u)
+		checkPassFail(pages.front(), pageNos[2])
+		checkPassFail(pages.back(), pageNos[0])
+	}
+	File::remove(name);
+}
+
+void pageFileBenchmark()
+{
+	// Allocating and deleting a page reads and writes a few headers, so the second half of the
+	// pages costs what the first half does, where walking the used list made it grow with the file
+	const std::string name = "relA.pages";
+	const int numPages = 8000;
+	std::vector<PageId> pageNos(numPages);
+	{
+		PageFile file(name, true, 1024);
+		double seconds[2];
+		std::uint64_t io[2];
+		for(int half = 0; half < 2; half++)
+		{
+			std::uint64_t ioBefore = file.numReads() + file.numWrites();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = half * numPages / 2; i < (half + 1) * numPages / 2; i++)
+			{
+				file.allocatePage(pageNos[i]);
+			}
+			seconds[half] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			io[half] = file.numReads() + file.numWrites() - ioBefore;
+		}
+		std::cout << "Allocate " << numPages / 2 << " pages: first half " << seconds[0] << "s, " << io[0]
+			<< " reads and writes, second half " << seconds[1] << "s, " << io[1] << " reads and writes" << std::endl;
+		checkPassFail((io[0] <= (std::uint64_t)numPages / 2 * 8), true)
+		checkPassFail((io[1] <= io[0] + 8), true)
+
+		// Deleting the pages at the end of the used list costs what deleting those at its head does
+		for(int half = 0; half < 2; half++)
+		{
+			std::uint64_t ioBefore = file.numReads() + file.numWrites();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numPages / 4; i++)
+			{
+				file.deletePage(half == 0 ? pageNos[i] : pageNos[numPages - 1 - i]);
+			}
+			seconds[half] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			io[half] = file.numReads() + file.numWrites() - ioBefore;
+		}
+		std::cout << "Delete " << numPages / 4 << " pages: head " << seconds[0] << "s, " << io[0]
+			<< " reads and writes, tail " << seconds[1] << "s, " << io[1] << " reads and writes" << std::endl;
+		checkPassFail((io[0] <= (std::uint64_t)numPages / 4 * 8), true)
+		checkPassFail((io[1] <= io[0] + 8), true)
+		checkPassFail(usedPages(file).size(), (size_t)numPages / 2)
+	}
+	File::remove(name);
+}
+
+// Page numbers of the used pages of a file, in the order it iterates them
+std::vector<PageId> usedPages(PageFile &file)
+{
+	std::vector<PageId> pageNos;
+	for(FileIterator iter = file.begin(); iter != file.end(); ++iter)
+	{
+		pageNos.push_back((*iter).page_number());
+	}
+	return pageNos;
+}
+
+void spaceMapTests()
+{
+	const std::string name = "relA.pages";
+	std::vector<RecordId> rids(relationSize);
+	size_t numPages;
+	long long bytes;
+	{
+		PageFile file(name, true);
+		checkPassFail(file.findPageWithSpace(1), Page::INVALID_NUMBER)
+		for(int i = 0; i < relationSize; i++)
+		{
+			rids[i] = bufMgr->insertRecord(&file, tupleData(i));
+		}
+		bufMgr->flushFile(&file);
+
+		// Records fill a page before the next one is allocated
+		const size_t perPage = (file.pageSize() - sizeof(PageHeader)) / (sizeof(RECORD) + sizeof(PageSlot));
+		numPages = usedPages(file).size();
+		checkPassFail((numPages <= relationSize / (perPage - 1) + 1), true)
+		checkPassFail((file.findPageWithSpace(file.pageSize()) == Page::INVALID_NUMBER), true)
+		bytes = fileBytes(name);
+
+		// Records deleted on every page leave holes that inserts fill instead of new pages
+		for(int i = 0; i < relationSize; i += 2)
+		{
+			bufMgr->deleteRecord(&file, rids[i]);
+		}
+		checkPassFail((file.findPageWithSpace(sizeof(RECORD)) != Page::INVALID_NUMBER), true)
+		for(int i = 0; i < relationSize; i += 2)
+		{
+			rids[i] = bufMgr->insertRecord(&file, tupleData(i));
+		}
+		bufMgr->flushFile(&file);
+		checkPassFail(usedPages(file).size(), numPages)
+
+		bool thrown = false;
+		try
+		{
+			bufMgr->insertRecord(&file, std::string(file.pageSize(), 'x'));
+		}
+		catch(const InsufficientSpaceException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+	}
+	checkPassFail(fileBytes(name), bytes)
+
+	// The map is read back from its pages when the file is opened again
+	{
+		PageFile file(name, false);
+		for(int i = 1; i < relationSize; i += 2)
+		{
+			bufMgr->deleteRecord(&file, rids[i]);
+		}
+		for(int i = 1; i < relationSize; i += 2)
+		{
+			rids[i] = bufMgr->insertRecord(&file, tupleData(i));
+		}
+		bufMgr->flushFile(&file);
+		checkPassFail(usedPages(file).size(), numPages)
+		for(int i = 0; i < relationSize; i += relationSize / 10)
+		{
+			std::string recordStr = file.readPage(rids[i].page_number).getRecord(rids[i]);
+			checkPassFail(((const RECORD *)recordStr.c_str())->i, i)
+		}
+
+		// Deleted pages have no room until they are allocated again
+		PageId pageNo = usedPages(file).back();
+		file.deletePage(pageNo);
+		checkPassFail((file.findPageWithSpace(sizeof(RECORD)) == pageNo), false)
+		std::string pageRecord(file.pageSize() - sizeof(PageHeader) - sizeof(PageSlot), 'x');
+		checkPassFail(bufMgr->insertRecord(&file, pageRecord).page_number, pageNo)
+		bufMgr->flushFile(&file);
+	}
+	checkPassFail(fileBytes(name), bytes)
+	File::remove(name);
+
+	// Random inserts and deletes on one page keep every record intact; slots appended after a delete
+	// moved record data used to read the bytes left behind as a used slot
+	{
+		Page page;
+		std::map<SlotId, std::string> onPage;
+		std::vector<RecordId> live;
+		for(int trial = 0; trial < 5000; trial++)
+		{
+			std::string record(1 + random() % 300, 'a' + trial % 26);
+			if(!live.empty() && (random() % 2 == 0 || !page.hasSpaceForRecord(record)))
+			{
+				size_t victim = random() % live.size();
+				page.deleteRecord(live[victim]);
+				onPage.erase(live[victim].slot_number);
+				live[victim] = live.back();
+				live.pop_back();
+				continue;
+			}
+			RecordId rid = page.insertRecord(record);
+			live.push_back(rid);
+			onPage[rid.slot_number] = record;
+		}
+		bool intact = true;
+		for(size_t i = 0; i < live.size(); i++)
+		{
+			intact = intact && page.getRecord(live[i]) == onPage[live[i].slot_number];
+		}
+		checkPassFail(intact, true)
+	}
+
+	// Deleting every other record of a file of records of many sizes and inserting as many again
+	// fills the holes without adding pages
+	{
+		BufMgr churnMgr(50);
+		PageFile file(name, true);
+		const int numRecords = 20000;
+		std::vector<RecordId> churnRids(numRecords);
+		for(int i = 0; i < numRecords; i++)
+		{
+			churnRids[i] = churnMgr.insertRecord(&file, std::string(100 + (i * 37) % 300, 'a' + i % 26));
+		}
+		for(int i = 0; i < numRecords; i += 2)
+		{
+			churnMgr.deleteRecord(&file, churnRids[i]);
+		}
+		churnMgr.flushFile(&file);
+		const size_t pagesBefore = usedPages(file).size();
+		for(int i = 0; i < numRecords; i += 2)
+		{
+			churnRids[i] = churnMgr.insertRecord(&file, std::string(100 + (i * 37) % 300, 'A' + i % 26));
+		}
+		churnMgr.flushFile(&file);
+		checkPassFail(usedPages(file).size(), pagesBefore)
+		for(int i = 0; i < numRecords; i += numRecords / 10 + 1)
+		{
+			std::string expected(100 + (i * 37) % 300, (i % 2 == 0 ? 'A' : 'a') + i % 26);
+			checkPassFail((file.readPage(churnRids[i].page_number).getRecord(churnRids[i]) == expected), true)
+		}
+	}
+	File::remove(name);
+
+	// Records inserted through the map land on pages other code has changed in the buffer pool
+	// and not written back; the write-back keeps both
+	{
+		PageFile file(name, true);
+		const RecordId first = bufMgr->insertRecord(&file, tupleData(0));
+		Page* page;
+		std::vector<RecordId> byHand;
+		bufMgr->readPage(&file, first.page_number, page);
+		for(int i = 1; i <= 3; i++)
+		{
+			byHand.push_back(page->insertRecord(tupleData(i)));
+		}
+		bufMgr->unPinPage(&file, first.page_number, true);
+		const RecordId next = bufMgr->insertRecord(&file, tupleData(4));
+		checkPassFail(next.page_number, first.page_number)
+
+		// A page filled by hand is skipped even though the map still has room on it
+		bufMgr->readPage(&file, first.page_number, page);
+		std::vector<RecordId> filler;
+		while(page->hasSpaceForRecord(tupleData(5)))
+		{
+			filler.push_back(page->insertRecord(tupleData(5)));
+		}
+		bufMgr->unPinPage(&file, first.page_number, true);
+		checkPassFail(file.findPageWithSpace(sizeof(RECORD) + sizeof(PageSlot)), first.page_number)
+		const RecordId other = bufMgr->insertRecord(&file, tupleData(6));
+		checkPassFail((other.page_number != first.page_number), true)
+		bufMgr->flushFile(&file);
+
+		const Page onDisk = file.readPage(first.page_number);
+		checkPassFail(((const RECORD *)onDisk.getRecord(first).c_str())->i, 0)
+		for(int i = 0; i < 3; i++)
+		{
+			checkPassFail(((const RECORD *)onDisk.getRecord(byHand[i]).c_str())->i, i + 1)
+		}
+		checkPassFail(((const RECORD *)onDisk.getRecord(next).c_str())->i, 4)
+		checkPassFail(((const RECORD *)file.readPage(other.page_number).getRecord(other).c_str())->i, 6)
+
+		// Deleting through the buffer pool keeps the records changed by hand too
+		bufMgr->deleteRecord(&file, next);
+		bufMgr->flushFile(&file);
+		checkPassFail((file.readPage(first.page_number).getRecord(byHand[2]) == tupleData(3)), true)
+	}
+	File::remove(name);
+}
+
+void spaceMapBenchmark()
+{
+	// Rounds of deleting half of the records and inserting as many again; without the map inserts
+	// go to the last page or a new one, as createRelationForward does, and the file keeps growing
+	const std::string name = "relA.pages";
+	const int rounds = 5;
+	long long fileSize[2];
+	for(int withMap = 0; withMap < 2; withMap++)
+	{
+		{
+			PageFile file(name, true);
+			std::vector<RecordId> rids(relationSize);
+			PageId lastPageNo = Page::INVALID_NUMBER;
+			Page* page;
+			for(int round = 0; round <= rounds; round++)
+			{
+				for(int i = round % 2; i < relationSize; i += (round == 0 ? 1 : 2))
+				{
+					std::string record = tupleData(i);
+					if(withMap)
+					{
+						rids[i] = bufMgr->insertRecord(&file, record);
+						continue;
+					}
+					if(lastPageNo != Page::INVALID_NUMBER)
+					{
+						bufMgr->readPage(&file, lastPageNo, page);
+						if(!page->hasSpaceForRecord(record))
+						{
+							bufMgr->unPinPage(&file, lastPageNo, false);
+							lastPageNo = Page::INVALID_NUMBER;
+						}
+					}
+					if(lastPageNo == Page::INVALID_NUMBER)
+					{
+						bufMgr->allocPage(&file, lastPageNo, page);
+					}
+					rids[i] = page->insertRecord(record);
+					bufMgr->unPinPage(&file, lastPageNo, true);
+				}
+				if(round < rounds)
+				{
+					for(int i = (round + 1) % 2; i < relationSize; i += 2)
+					{
+						bufMgr->deleteRecord(&file, rids[i]);
+					}
+				}
+			}
+			bufMgr->flushFile(&file);
+		}
+		fileSize[withMap] = fileBytes(name);
+		File::remove(name);
+	}
+	std::cout << "File after " << rounds << " rounds of churn: " << fileSize[0] << " bytes appending, "
+		<< fileSize[1] << " bytes with the free space map" << std::endl;
+	checkPassFail((fileSize[1] * 2 < fileSize[0]), true)
+}
+
+// Record of tuple i of the test relations
+std::string tupleData(int i)
+{
+	memset(record1.s, ' ', sizeof(record1.s));
+	sprintf(record1.s, "%05d string record", i);
+	record1.i = i;
+	record1.d = (double)i;
+	return std::string(reinterpret_cast<char*>(&record1), sizeof(record1));
+}
+
+void fileIOTests()
+{
+	// A file that cannot be opened throws and is not left registered as open
+	const std::string dirName = "relA.dir";
+	mkdir(dirName.c_str(), 0777);
+	bool thrown = false;
+	try
+	{
+		BlobFile blob(dirName, false);
+	}
+	catch(const FileIOException &e)
+	{
+		thrown = true;
+	}
+	checkPassFail(thrown, true)
+	checkPassFail(File::isOpen(dirName), false)
+	rmdir(dirName.c_str());
+
+	// A write the system refuses throws, here past the largest file the process may write
+	const std::string blobName = "relA.blob";
+	{
+		BlobFile blob(blobName, true);
+		PageId pageNo;
+		Page page = blob.allocatePage(pageNo);
+		struct rlimit limit;
+		getrlimit(RLIMIT_FSIZE, &limit);
+		struct rlimit small = limit;
+		small.rlim_cur = fileBytes(blobName);
+		void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+		setrlimit(RLIMIT_FSIZE, &small);
+		thrown = false;
+		try
+		{
+			blob.writePage(pageNo + 10, page);
+		}
+		catch(const FileIOException &e)
+		{
+			thrown = (e.error() == EFBIG);
+		}
+		setrlimit(RLIMIT_FSIZE, &limit);
+		signal(SIGXFSZ, handler);
+		checkPassFail(thrown, true)
+	}
+	File::remove(blobName);
+
+	// Threads opening and closing the same file share its descriptor and free space map
+	const std::string pagesName = "relA.pages";
+	{
+		PageFile file(pagesName, true, 1024);
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		std::vector<std::thread> workers;
+		for(int t = 0; t < 4; t++)
+		{
+			workers.push_back(std::thread(openCloseFile, pagesName, 2000));
+		}
+		for(size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+		checkPassFail(File::isOpen(pagesName), true)
+		checkPassFail(usedPages(file).size(), 1u)
+	}
+	checkPassFail(File::isOpen(pagesName), false)
+	File::remove(pagesName);
+}
+
+// Opens and closes an existing PageFile the given number of times
+void openCloseFile(const std::string name, const int times)
+{
+	for(int i = 0; i < times; i++)
+	{
+		PageFile file(name, false);
+		file.getFirstPageNo();
+	}
+}
+
+void fileIOBenchmark()
+{
+	// The same page writes and random page reads as the old stream backend did them, through a
+	// std::fstream seeking before every read and write and flushing after every write, and through
+	// a BlobFile, whose pread and pwrite calls take the position along. Small pages, where the
+	// calls and not the copying dominate; the best of a few rounds of each
+	const std::string streamName = "relA.stream";
+	const std::string blobName = "relA.blob";
+	const int pageSize = 512;
+	const int numPages = 4000;
+	const int numReads = 4 * numPages;
+	const int rounds = 3;
+	std::vector<PageId> readOrder(numReads);
+	srand(7);
+	for(int i = 0; i < numReads; i++)
+	{
+		readOrder[i] = rand() % numPages;
+	}
+	Page page;
+	double seconds[2][2] = {{1e9, 1e9}, {1e9, 1e9}};
+	long long checksum[2] = {0, 0};
+	for(int round = 0; round < rounds; round++)
+	{
+		{
+			std::fstream stream(streamName, std::fstream::in | std::fstream::out | std::fstream::binary | std::fstream::trunc);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numPages; i++)
+			{
+				*(int *)&page = i;
+				stream.seekp((std::streamoff)i * pageSize, std::ios::beg);
+				stream.write((const char *)&page, pageSize);
+				stream.flush();
+			}
+			seconds[0][0] = std::min(seconds[0][0], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			checksum[0] = 0;
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numReads; i++)
+			{
+				Page readPage;
+				stream.seekg((std::streamoff)readOrder[i] * pageSize, std::ios::beg);
+				stream.read((char *)&readPage, pageSize);
+				page = readPage;
+				checksum[0] += *(int *)&page;
+			}
+			seconds[0][1] = std::min(seconds[0][1], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		std::remove(streamName.c_str());
+		{
+			BlobFile blob(blobName, true, pageSize);
+			PageId firstPageNo = blob.allocateExtent(numPages);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numPages; i++)
+			{
+				*(int *)&page = i;
+				blob.writePage(firstPageNo + i, page);
+			}
+			seconds[1][0] = std::min(seconds[1][0], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			checksum[1] = 0;
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numReads; i++)
+			{
+				page = blob.readPage(firstPageNo + readOrder[i]);
+				checksum[1] += *(int *)&page;
+			}
+			seconds[1][1] = std::min(seconds[1][1], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		File::remove(blobName);
+	}
+
+	std::cout << "Write " << numPages << " pages: fstream " << seconds[0][0] << "s, pwrite "
+		<< seconds[1][0] << "s" << std::endl;
+	std::cout << "Read " << numReads << " random pages: fstream " << seconds[0][1] << "s, pread "
+		<< seconds[1][1] << "s" << std::endl;
+	checkPassFail(checksum[1], checksum[0])
+	checkPassFail((seconds[1][1] < seconds[0][1]), true)
+	checkPassFail((seconds[1][0] + seconds[1][1] < seconds[0][0] + seconds[0][1]), true)
+}
+
+// Size of a file on disk
+long long fileBytes(const std::string &name)
+{
+	std::ifstream file(name, std::ios::binary | std::ios::ate);
+	return file.tellg();
+}
+
+// Writes the file out and drops it from the page cache, so that the next reads go to the disk
+void dropFileCache(const std::string &name)
+{
+	int fd = open(name.c_str(), O_RDONLY);
+	if(fd >= 0)
+	{
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
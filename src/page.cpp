@@ -29,6 +29,7 @@ void Page::initialize() {
   header_.num_free_slots = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
+  header_.prev_page_number = INVALID_NUMBER;
   //data_.assign(DATA_SIZE, char());
 	memset(data_, '\0', DATA_SIZE);
 }
@@ -46,7 +47,7 @@ RecordId Page::insertRecord(const std::string& record_data) {
 std::string Page::getRecord(const RecordId& record_id) const {
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-	std::string retStr = std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
+	std::string retStr = std::string(data_ + slot.item_offset, slot.item_length);
 
 	return retStr;
 }
@@ -99,11 +100,15 @@ void Page::deleteRecord(const RecordId& record_id,
   }
   // If we have data to move, shift it to the right.
   if (move_bytes > 0) {
-    const std::string& data_to_move = std::string(data_, DATA_SIZE).substr(move_offset, move_bytes);
+    const std::string& data_to_move = std::string(data_ + move_offset, move_bytes);
 
 		for(std::uint16_t i = 0; i < move_bytes; i++)
 			data_[i + move_offset + slot->item_length] = data_to_move[i];
 
+    // The bytes the data moved out of are free space now, which the slot
+    // array may grow into.
+    memset(&data_[move_offset], '\0', slot->item_length);
+
     //data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
   }
   header_.free_space_upper_bound += slot->item_length;
@@ -170,6 +175,12 @@ SlotId Page::getAvailableSlot() {
     ++header_.num_slots;
     ++header_.num_free_slots;
     header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+
+    // The slot takes bytes of free space, which may still hold old data.
+    PageSlot* slot = getSlot(slot_number);
+    slot->used = false;
+    slot->item_offset = 0;
+    slot->item_length = 0;
   }
   assert(slot_number != INVALID_SLOT);
   return slot_number;
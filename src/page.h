@@ -15,13 +15,21 @@
 //#include <gtest/gtest.h>
 #include "types.h"
 
+/**
+ * Size in bytes of the largest page a file can use.  Set it at build time
+ * (make MAXPAGESIZE=16384) to make Page objects smaller.
+ */
+#ifndef BADGERDB_MAX_PAGE_SIZE
+#define BADGERDB_MAX_PAGE_SIZE 65536
+#endif
+
 namespace badgerdb {
 
 /**
  * @brief Header metadata in a page.
  *
  * Header metadata in each page which tracks where space has been used and
- * contains a pointer to the next page in the file.
+ * contains pointers to the next and the previous page in the file.
  */
 struct PageHeader {
   /**
@@ -58,6 +66,12 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * Number of the previous used page in the file, so that a page can leave the
+   * list of used pages without a walk to it.
+   */
+  PageId prev_page_number;
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -68,7 +82,8 @@ struct PageHeader {
     return num_slots == rhs.num_slots &&
         num_free_slots == rhs.num_free_slots &&
         current_page_number == rhs.current_page_number &&
-        next_page_number == rhs.next_page_number;
+        next_page_number == rhs.next_page_number &&
+        prev_page_number == rhs.prev_page_number;
   }
 };
 
@@ -108,15 +123,27 @@ class PageIterator;
 class Page {
  public:
   /**
-   * Page size in bytes.  If this is changed, database files created with a
-   * different page size value will be unreadable by the resulting binaries.
+   * Page size of new files unless they ask for another one.
    */
   static const std::size_t SIZE = 8192;
 
+  /**
+   * Size in bytes of a Page object, and so the largest page size a file can be
+   * created with.  Every file chooses its own page size when it is created;
+   * only the first pageSize() bytes of a Page are read from and written to
+   * that file, and a buffer frame holds only those bytes.
+   */
+  static const std::size_t MAX_SIZE = BADGERDB_MAX_PAGE_SIZE;
+
+  /**
+   * Smallest page size a file can be created with.
+   */
+  static const std::size_t MIN_SIZE = 512;
+
   /**
    * Size of page free space area in bytes.
    */
-  static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
+  static const std::size_t DATA_SIZE = MAX_SIZE - sizeof(PageHeader);
 
   /**
    * Number of page indicating that it's invalid.
@@ -343,5 +370,9 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(Page::SIZE >= Page::MIN_SIZE && Page::SIZE <= Page::MAX_SIZE,
+              "Default page size must be a page size files can use.");
+static_assert(Page::DATA_SIZE <= 0xFFFF,
+              "Offsets of records on a page must fit in 16 bits.");
 
 }